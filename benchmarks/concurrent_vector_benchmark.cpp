@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <deque>
 #include <iostream>
 #include <random>
@@ -16,6 +17,7 @@
 #include "tbb/concurrent_vector.h"
 #endif // !BENCHMARK_WITHOUT_TBB
 
+#include <dispenso/concurrent_object_arena.h>
 #include <dispenso/concurrent_vector.h>
 #include <dispenso/parallel_for.h>
 
@@ -185,6 +187,26 @@ void BM_dispenso_iterate(benchmark::State& state) {
   iterateImpl(state, []() { return dispenso::ConcurrentVector<int>(); });
 }
 
+void BM_dispenso_iterate_spans(benchmark::State& state) {
+  dispenso::ConcurrentVector<int> values;
+  for (size_t i = 0; i < kLength; ++i) {
+    values.push_back(i);
+  }
+  int64_t sum;
+  for (auto UNUSED_VAR : state) {
+    sum = 0;
+    values.forEachSpan([&sum](const int* b, const int* e) {
+      int64_t local = 0;
+      for (const int* p = b; p != e; ++p) {
+        local += *p;
+      }
+      sum += local;
+    });
+  }
+
+  checkIotaSum(sum);
+}
+
 template <typename T>
 struct ReverseWrapper {
   T& iterable;
@@ -403,6 +425,20 @@ void BM_dispenso_parallel(benchmark::State& state) {
       [](dispenso::ConcurrentVector<int>& c, int i) { c.push_back(i); });
 }
 
+void BM_dispenso_parallel_appender(benchmark::State& state) {
+  using Vec = dispenso::ConcurrentVector<int>;
+  for (auto UNUSED_VAR : state) {
+    Vec values;
+    std::deque<Vec::Appender> appenders;
+    dispenso::parallel_for(
+        appenders,
+        [&values]() { return Vec::Appender(values); },
+        size_t{0},
+        kLength,
+        [](Vec::Appender& appender, size_t i) { appender.push_back(static_cast<int>(i)); });
+  }
+}
+
 void BM_std_parallel_reserve(benchmark::State& state) {
   std::mutex mtx;
   parallelImpl(
@@ -634,6 +670,47 @@ void BM_dispenso_parallel_grow_by_100(benchmark::State& state) {
       });
 }
 
+// ConcurrentObjectArena cannot be cleared, so a fresh arena is grown each iteration.
+void parallelArenaGrowBy(size_t growBy, benchmark::State& state) {
+  constexpr size_t kArenaBufferSize = 4096;
+  int64_t sum = 0;
+
+  for (auto UNUSED_VAR : state) {
+    dispenso::ConcurrentObjectArena<int> values(kArenaBufferSize);
+    dispenso::parallel_for(
+        dispenso::makeChunkedRange(0, kLength, dispenso::ParForChunking::kStatic),
+        [&values, growBy](size_t i, size_t end) {
+          while (i < end) {
+            size_t n = std::min(growBy, end - i);
+            size_t p = values.grow_by(n);
+            for (size_t j = 0; j < n; ++j) {
+              values[p + j] = static_cast<int>(i + j);
+            }
+            i += n;
+          }
+        });
+
+    sum = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+      sum += values[i];
+    }
+  }
+
+  checkIotaSum(sum);
+}
+
+void BM_arena_parallel_grow_by_10(benchmark::State& state) {
+  parallelArenaGrowBy(10, state);
+}
+
+void BM_arena_parallel_grow_by_100(benchmark::State& state) {
+  parallelArenaGrowBy(100, state);
+}
+
+void BM_arena_parallel_grow_by_max(benchmark::State& state) {
+  parallelArenaGrowBy(kLength, state);
+}
+
 template <typename ContainerInit, typename ContainerPush>
 void parallelImplGrowByMax(
     benchmark::State& state,
@@ -735,6 +812,7 @@ BENCHMARK(BM_deque_iterate);
 BENCHMARK(BM_tbb_iterate);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_iterate);
+BENCHMARK(BM_dispenso_iterate_spans);
 
 BENCHMARK(BM_std_iterate_reverse);
 BENCHMARK(BM_deque_iterate_reverse);
@@ -770,6 +848,7 @@ BENCHMARK(BM_deque_parallel);
 BENCHMARK(BM_tbb_parallel);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_parallel);
+BENCHMARK(BM_dispenso_parallel_appender);
 
 BENCHMARK(BM_std_parallel_reserve);
 #if !defined(BENCHMARK_WITHOUT_TBB)
@@ -790,6 +869,7 @@ BENCHMARK(BM_deque_parallel_grow_by_10);
 BENCHMARK(BM_tbb_parallel_grow_by_10);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_parallel_grow_by_10);
+BENCHMARK(BM_arena_parallel_grow_by_10);
 
 BENCHMARK(BM_std_parallel_grow_by_100);
 BENCHMARK(BM_deque_parallel_grow_by_100);
@@ -797,6 +877,7 @@ BENCHMARK(BM_deque_parallel_grow_by_100);
 BENCHMARK(BM_tbb_parallel_grow_by_100);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_parallel_grow_by_100);
+BENCHMARK(BM_arena_parallel_grow_by_100);
 
 BENCHMARK(BM_std_parallel_grow_by_max);
 BENCHMARK(BM_deque_parallel_grow_by_max);
@@ -804,5 +885,6 @@ BENCHMARK(BM_deque_parallel_grow_by_max);
 BENCHMARK(BM_tbb_parallel_grow_by_max);
 #endif // !BENCHMARK_WITHOUT_TBB
 BENCHMARK(BM_dispenso_parallel_grow_by_max);
+BENCHMARK(BM_arena_parallel_grow_by_max);
 
 BENCHMARK_MAIN();
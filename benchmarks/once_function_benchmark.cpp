@@ -5,7 +5,6 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <cstring>
 #include <deque>
 #include <functional>
 
@@ -13,6 +12,7 @@
 
 #include "benchmark_common.h"
 
+constexpr size_t kTinySize = 8;
 constexpr size_t kSmallSize = 24;
 constexpr size_t kMediumSize = 120;
 constexpr size_t kLargeSize = 248;
@@ -59,14 +59,6 @@ struct Foo {
     benchmark::ClobberMemory();
   }
 
-  Foo(Foo<kSize>&& f) {
-    std::memcpy(buf, f.buf, kSize);
-  }
-
-  Foo(const Foo<kSize>& f) {
-    std::memcpy(buf, f.buf, kSize);
-  }
-
   void operator()() {
     benchmark::DoNotOptimize(++buf[0]);
   }
@@ -90,6 +82,27 @@ void BM_move_once_function(benchmark::State& state) {
   runMoveLoop<dispenso::OnceFunction>(state, Foo<kSize>());
 }
 
+// Mirror a task's trip through a thread pool: construct, move into the queue, move out, and run.
+template <typename ExeType, typename Func>
+void runHandoffLoop(benchmark::State& state, Func f) {
+  for (auto UNUSED_VAR : state) {
+    ExeType t(f);
+    ExeType queued(std::move(t));
+    ExeType o(std::move(queued));
+    o();
+  }
+}
+
+template <size_t kSize>
+void BM_handoff_std_function(benchmark::State& state) {
+  runHandoffLoop<std::function<void()>>(state, Foo<kSize>());
+}
+
+template <size_t kSize>
+void BM_handoff_once_function(benchmark::State& state) {
+  runHandoffLoop<dispenso::OnceFunction>(state, Foo<kSize>());
+}
+
 constexpr int kMediumLoopLen = 200;
 
 template <size_t kSize>
@@ -125,6 +138,9 @@ void BM_queue_once_function(benchmark::State& state) {
   }
 }
 
+BENCHMARK_TEMPLATE(BM_move_std_function, kTinySize);
+BENCHMARK_TEMPLATE(BM_move_once_function, kTinySize);
+
 BENCHMARK_TEMPLATE(BM_move_std_function, kSmallSize);
 BENCHMARK_TEMPLATE(BM_move_once_function, kSmallSize);
 
@@ -137,6 +153,19 @@ BENCHMARK_TEMPLATE(BM_move_once_function, kLargeSize);
 BENCHMARK_TEMPLATE(BM_move_std_function, kExtraLargeSize);
 BENCHMARK_TEMPLATE(BM_move_once_function, kExtraLargeSize);
 
+BENCHMARK_TEMPLATE(BM_handoff_std_function, kTinySize);
+BENCHMARK_TEMPLATE(BM_handoff_once_function, kTinySize);
+
+BENCHMARK_TEMPLATE(BM_handoff_std_function, kSmallSize);
+BENCHMARK_TEMPLATE(BM_handoff_once_function, kSmallSize);
+
+BENCHMARK_TEMPLATE(BM_handoff_std_function, kMediumSize);
+BENCHMARK_TEMPLATE(BM_handoff_once_function, kMediumSize);
+
+BENCHMARK_TEMPLATE(BM_queue_inline_function, kTinySize);
+BENCHMARK_TEMPLATE(BM_queue_std_function, kTinySize);
+BENCHMARK_TEMPLATE(BM_queue_once_function, kTinySize);
+
 BENCHMARK_TEMPLATE(BM_queue_inline_function, kSmallSize);
 BENCHMARK_TEMPLATE(BM_queue_std_function, kSmallSize);
 BENCHMARK_TEMPLATE(BM_queue_once_function, kSmallSize);
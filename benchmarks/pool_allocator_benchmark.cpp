@@ -118,6 +118,15 @@ void BM_pool_allocator_threaded(benchmark::State& state) {
       [&allocator](char* buf) { allocator.dealloc(buf); });
 }
 
+template <size_t kSize, size_t kThreads>
+void BM_pool_allocator_cached_threaded(benchmark::State& state) {
+  dispenso::PoolAllocator allocator(kSize, (1 << 20), ::malloc, ::free, 64);
+  runThreaded<kThreads>(
+      state,
+      [&allocator]() { return allocator.alloc(); },
+      [&allocator](char* buf) { allocator.dealloc(buf); });
+}
+
 BENCHMARK_TEMPLATE(BM_mallocfree, kSmallSize)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE(BM_pool_allocator, kSmallSize)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE(BM_nl_pool_allocator, kSmallSize)->Range(1 << 13, 1 << 15);
@@ -141,29 +150,38 @@ BENCHMARK_TEMPLATE(BM_nl_pool_allocator_arena, kLargeSize)->Range(1 << 13, 1 <<
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kSmallSize, 2)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kSmallSize, 2)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kSmallSize, 2)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kMediumSize, 2)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kMediumSize, 2)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kMediumSize, 2)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kLargeSize, 2)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kLargeSize, 2)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kLargeSize, 2)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kSmallSize, 8)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kSmallSize, 8)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kSmallSize, 8)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kMediumSize, 8)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kMediumSize, 8)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kMediumSize, 8)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kLargeSize, 8)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kLargeSize, 8)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kLargeSize, 8)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kSmallSize, 16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kSmallSize, 16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kSmallSize, 16)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kMediumSize, 16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kMediumSize, 16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kMediumSize, 16)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_TEMPLATE2(BM_mallocfree_threaded, kLargeSize, 16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE2(BM_pool_allocator_threaded, kLargeSize, 16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE2(BM_pool_allocator_cached_threaded, kLargeSize, 16)->Range(1 << 13, 1 << 15);
 
 BENCHMARK_MAIN();
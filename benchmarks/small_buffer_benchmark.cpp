@@ -12,6 +12,7 @@
 constexpr size_t kSmallSize = 32;
 constexpr size_t kMediumSize = 128;
 constexpr size_t kLargeSize = 256;
+constexpr size_t kHugeSize = 4096;
 
 template <typename Alloc, typename Free>
 void run(benchmark::State& state, Alloc alloc, Free dealloc) {
@@ -49,6 +50,9 @@ BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kMediumSize)->Range(1 << 13, 1 <<
 BENCHMARK_TEMPLATE(BM_newdelete, kLargeSize)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kLargeSize)->Range(1 << 13, 1 << 15);
 
+BENCHMARK_TEMPLATE(BM_newdelete, kHugeSize)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kHugeSize)->Range(1 << 13, 1 << 15);
+
 BENCHMARK_TEMPLATE(BM_newdelete, kSmallSize)->Threads(16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kSmallSize)->Threads(16)->Range(1 << 13, 1 << 15);
 
@@ -58,4 +62,7 @@ BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kMediumSize)->Threads(16)->Range(1
 BENCHMARK_TEMPLATE(BM_newdelete, kLargeSize)->Threads(16)->Range(1 << 13, 1 << 15);
 BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kLargeSize)->Threads(16)->Range(1 << 13, 1 << 15);
 
+BENCHMARK_TEMPLATE(BM_newdelete, kHugeSize)->Threads(16)->Range(1 << 13, 1 << 15);
+BENCHMARK_TEMPLATE(BM_small_buffer_allocator, kHugeSize)->Threads(16)->Range(1 << 13, 1 << 15);
+
 BENCHMARK_MAIN();
@@ -8,6 +8,9 @@
 #include <dispenso/timed_task.h>
 
 #include <deque>
+#include <random>
+#include <string>
+#include <thread>
 
 #include <dispenso/completion_event.h>
 #include <dispenso/schedulable.h>
@@ -300,6 +303,89 @@ void BM_dispenso_mixed(benchmark::State& state) {
   doStats(items[0].times, state);
 }
 
+// Many pending, mostly-cancelled timeouts.  The scheduler is first filled with 1M pending timers
+// well in the future, and then we measure the cost of scheduling and cancelling further timeouts on
+// top of those.
+template <dispenso::TimedTaskQueueType kQueueType>
+void BM_dispenso_pending_timers(benchmark::State& state) {
+  constexpr size_t kNumPending = 1000000;
+  constexpr size_t kNumChurn = 100000;
+
+  dispenso::TimedTaskSchedulerOptions options;
+  options.queueType = kQueueType;
+  dispenso::TimedTaskScheduler sched(dispenso::ThreadPriority::kNormal, options);
+
+  std::mt19937 rng(17);
+  std::uniform_real_distribution<double> timeout(10.0, 70.0);
+  auto noop = []() { return true; };
+
+  std::vector<dispenso::TimedTask> pending;
+  pending.reserve(kNumPending);
+  double now = dispenso::getTime();
+  for (size_t i = 0; i < kNumPending; ++i) {
+    pending.push_back(sched.schedule(dispenso::kImmediateInvoker, noop, now + timeout(rng)));
+  }
+
+  std::vector<dispenso::TimedTask> churn;
+  churn.reserve(kNumChurn);
+  for (auto UNUSED_VAR : state) {
+    now = dispenso::getTime();
+    for (size_t i = 0; i < kNumChurn; ++i) {
+      churn.push_back(sched.schedule(dispenso::kImmediateInvoker, noop, now + timeout(rng)));
+    }
+    // Destroying the tasks cancels them.
+    churn.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * kNumChurn);
+}
+
+// Each benchmark thread schedules short one-shot timers and waits for all of them to fire; with
+// more than one shard, producers are spread across shards by thread.  Lateness is reported overall
+// and per shard.
+void BM_dispenso_sharded_producers(benchmark::State& state) {
+  constexpr size_t kTimersPerIter = 1000;
+  static std::unique_ptr<dispenso::ShardedTimedTaskScheduler> sched;
+  if (state.thread_index() == 0) {
+    sched = std::make_unique<dispenso::ShardedTimedTaskScheduler>(
+        static_cast<size_t>(state.range(0)));
+  }
+  std::atomic<size_t> fired(0);
+  size_t expected = 0;
+  for (auto UNUSED_VAR : state) {
+    double now = dispenso::getTime();
+    for (size_t i = 0; i < kTimersPerIter; ++i) {
+      sched
+          ->schedule(
+              dispenso::kImmediateInvoker,
+              [&fired]() {
+                fired.fetch_add(1, std::memory_order_release);
+                return true;
+              },
+              now + 1e-4 * static_cast<double>(i % 10))
+          .detach();
+    }
+    // The timers are detached, so fired must outlive them; wait for every one before moving on.
+    expected += kTimersPerIter;
+    while (fired.load(std::memory_order_acquire) < expected) {
+      std::this_thread::yield();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kTimersPerIter);
+  state.counters["fired"] = static_cast<double>(fired.load(std::memory_order_acquire));
+  if (state.thread_index() == 0) {
+    auto stats = sched->stats();
+    state.counters["jitter_us"] = stats.jitter * 1e6;
+    state.counters["max_late_us"] = stats.maxLateness * 1e6;
+    for (size_t i = 0; i < sched->numShards(); ++i) {
+      auto shardStats = sched->stats(i);
+      std::string shard = "_s" + std::to_string(i);
+      state.counters["jitter_us" + shard] = shardStats.jitter * 1e6;
+      state.counters["max_late_us" + shard] = shardStats.maxLateness * 1e6;
+    }
+    sched.reset();
+  }
+}
+
 BENCHMARK_TEMPLATE2(BM_dispenso, 2, false)->UseManualTime();
 BENCHMARK_TEMPLATE2(BM_dispenso, 4, false)->UseManualTime();
 BENCHMARK_TEMPLATE2(BM_dispenso, 6, false)->UseManualTime();
@@ -310,6 +396,16 @@ BENCHMARK_TEMPLATE2(BM_dispenso, 6, true)->UseManualTime();
 BENCHMARK_TEMPLATE(BM_dispenso_mixed, false)->UseManualTime();
 BENCHMARK_TEMPLATE(BM_dispenso_mixed, true)->UseManualTime();
 
+BENCHMARK_TEMPLATE(BM_dispenso_pending_timers, dispenso::TimedTaskQueueType::kHeap)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_dispenso_pending_timers, dispenso::TimedTaskQueueType::kTimingWheel)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(BM_dispenso_sharded_producers)->Arg(1)->Threads(4)->UseRealTime();
+BENCHMARK(BM_dispenso_sharded_producers)->Arg(4)->Threads(4)->UseRealTime();
+
 #if !defined(BENCHMARK_WITHOUT_FOLLY)
 BENCHMARK_TEMPLATE2(BM_folly, 2, false)->UseManualTime();
 BENCHMARK_TEMPLATE2(BM_folly, 4, false)->UseManualTime();
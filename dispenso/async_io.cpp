@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/async_io.h>
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <system_error>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define DISPENSO_HAS_IO_URING
+#endif // has io_uring.h
+#endif // linux
+
+#if defined(DISPENSO_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <dispenso/detail/completion_event_impl.h>
+#endif // DISPENSO_HAS_IO_URING
+
+namespace dispenso {
+namespace detail {
+namespace {
+size_t toIoResult(ssize_t res, int err) {
+  if (res >= 0) {
+    return static_cast<size_t>(res);
+  }
+#if defined(__cpp_exceptions)
+  throw std::system_error(err, std::generic_category());
+#else
+  (void)err;
+  return io::kIoError;
+#endif // __cpp_exceptions
+}
+} // namespace
+
+Future<size_t> readAsyncFallback(int fd, uint64_t offset, void* data, size_t size) {
+  return Future<size_t>(
+      [fd, offset, data, size]() {
+        ssize_t res;
+        do {
+          res = ::pread(fd, data, size, static_cast<off_t>(offset));
+        } while (res < 0 && errno == EINTR);
+        return toIoResult(res, errno);
+      },
+      kNewThreadInvoker,
+      std::launch::async,
+      kNotDeferred);
+}
+
+Future<size_t> writeAsyncFallback(int fd, uint64_t offset, const void* data, size_t size) {
+  return Future<size_t>(
+      [fd, offset, data, size]() {
+        ssize_t res;
+        do {
+          res = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        } while (res < 0 && errno == EINTR);
+        return toIoResult(res, errno);
+      },
+      kNewThreadInvoker,
+      std::launch::async,
+      kNotDeferred);
+}
+
+#if defined(DISPENSO_HAS_IO_URING)
+namespace {
+
+constexpr unsigned kQueueDepth = 256;
+
+struct IoRequest {
+  CompletionEventImpl done{0};
+  int result = 0;
+  struct iovec iov;
+  OnceFunction complete;
+};
+
+// A minimal io_uring driven directly through syscalls.  Submissions are serialized by a mutex and
+// submitted immediately, so the submission queue never holds more than one entry.  A single reaper
+// thread polls the ring for completions, and completes the corresponding Futures.  The reaper also
+// polls an eventfd, through which the destructor wakes it to shut down.
+class IoUring {
+ public:
+  static IoUring& instance() {
+    static IoUring ring;
+    return ring;
+  }
+
+  bool valid() const {
+    return ringFd_ >= 0;
+  }
+
+  // Returns false if the request could not be submitted, in which case the caller should fall back
+  // to the blocking path.
+  bool submit(uint8_t opcode, int fd, uint64_t offset, IoRequest* req) {
+    if (inFlight_.fetch_add(1, std::memory_order_acq_rel) >= cqEntries_) {
+      // Don't risk overflowing the completion queue.
+      inFlight_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (!push(opcode, fd, offset, reinterpret_cast<uint64_t>(&req->iov), 1, req)) {
+      inFlight_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  ~IoUring() {
+    if (!valid()) {
+      return;
+    }
+    // Wake the reaper, which exits once all requests in flight have completed.  This needs no
+    // submission, so it can't be held up by a ring that refuses new entries.
+    stopping_.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t res;
+    do {
+      res = ::write(wakeFd_, &one, sizeof(one));
+    } while (res < 0 && errno == EINTR);
+    reaper_.join();
+    ::close(wakeFd_);
+    munmap(sqes_, sqesBytes_);
+    if (cqRing_ != sqRing_) {
+      munmap(cqRing_, cqBytes_);
+    }
+    munmap(sqRing_, sqBytes_);
+    ::close(ringFd_);
+  }
+
+ private:
+  IoUring() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ringFd = static_cast<int>(syscall(__NR_io_uring_setup, kQueueDepth, &params));
+    if (ringFd < 0) {
+      return;
+    }
+
+    sqBytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqBytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+      sqBytes_ = cqBytes_ = std::max(sqBytes_, cqBytes_);
+    }
+    sqesBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+
+    constexpr int kProt = PROT_READ | PROT_WRITE;
+    constexpr int kFlags = MAP_SHARED | MAP_POPULATE;
+    void* sq = mmap(nullptr, sqBytes_, kProt, kFlags, ringFd, IORING_OFF_SQ_RING);
+    void* cq = singleMmap ? sq : mmap(nullptr, cqBytes_, kProt, kFlags, ringFd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(nullptr, sqesBytes_, kProt, kFlags, ringFd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+      if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesBytes_);
+      }
+      if (cq != MAP_FAILED && cq != sq) {
+        munmap(cq, cqBytes_);
+      }
+      if (sq != MAP_FAILED) {
+        munmap(sq, sqBytes_);
+      }
+      ::close(ringFd);
+      return;
+    }
+
+    sqRing_ = static_cast<char*>(sq);
+    cqRing_ = static_cast<char*>(cq);
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sqHead_ = reinterpret_cast<std::atomic<unsigned>*>(sqRing_ + params.sq_off.head);
+    sqTail_ = reinterpret_cast<std::atomic<unsigned>*>(sqRing_ + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sqRing_ + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sqRing_ + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+
+    cqHead_ = reinterpret_cast<std::atomic<unsigned>*>(cqRing_ + params.cq_off.head);
+    cqTail_ = reinterpret_cast<std::atomic<unsigned>*>(cqRing_ + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cqRing_ + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cqRing_ + params.cq_off.cqes);
+    cqEntries_ = params.cq_entries;
+
+    wakeFd_ = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+      munmap(sqes, sqesBytes_);
+      if (cq != sq) {
+        munmap(cq, cqBytes_);
+      }
+      munmap(sq, sqBytes_);
+      ::close(ringFd);
+      return;
+    }
+
+    ringFd_ = ringFd;
+    reaper_ = std::thread([this]() { reapLoop(); });
+  }
+
+  bool push(uint8_t opcode, int fd, uint64_t offset, uint64_t addr, uint32_t len, IoRequest* req) {
+    std::lock_guard<std::mutex> lk(sqMutex_);
+    unsigned tail = sqTail_->load(std::memory_order_relaxed);
+    if (tail - sqHead_->load(std::memory_order_acquire) >= sqEntries_) {
+      return false;
+    }
+    unsigned index = tail & sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->user_data = reinterpret_cast<uint64_t>(req);
+    sqArray_[index] = index;
+    sqTail_->store(tail + 1, std::memory_order_release);
+
+    long ret;
+    do {
+      ret = syscall(__NR_io_uring_enter, ringFd_, 1, 0, 0, nullptr, 0);
+    } while (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+    if (ret < 1) {
+      // The kernel did not consume the entry; retract it.
+      sqTail_->store(tail, std::memory_order_release);
+      return false;
+    }
+    return true;
+  }
+
+  void reapLoop() {
+    while (true) {
+      unsigned head = cqHead_->load(std::memory_order_relaxed);
+      unsigned tail = cqTail_->load(std::memory_order_acquire);
+      if (head == tail) {
+        // Keep reaping after shutdown is requested until every submitted request has completed, so
+        // that no Future is left waiting.
+        bool stopping = stopping_.load(std::memory_order_acquire);
+        if (stopping && inFlight_.load(std::memory_order_acquire) == 0) {
+          return;
+        }
+        // The eventfd is never drained, so stop polling it once it has fired.
+        pollfd fds[2] = {{ringFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+        ::poll(fds, stopping ? 1 : 2, -1);
+        continue;
+      }
+      for (; head != tail; ++head) {
+        io_uring_cqe* cqe = &cqes_[head & cqMask_];
+        auto* req = reinterpret_cast<IoRequest*>(cqe->user_data);
+        int res = cqe->res;
+        cqHead_->store(head + 1, std::memory_order_release);
+        inFlight_.fetch_sub(1, std::memory_order_acq_rel);
+        // Once notified, a waiter may run the intercepted function inline and drop the last
+        // reference to req, so req must not be touched after notify.
+        OnceFunction complete = std::move(req->complete);
+        req->result = res;
+        req->done.notify(1);
+        complete();
+      }
+    }
+  }
+
+  int ringFd_ = -1;
+  int wakeFd_ = -1;
+  std::atomic<bool> stopping_{false};
+
+  std::mutex sqMutex_;
+  char* sqRing_ = nullptr;
+  size_t sqBytes_ = 0;
+  std::atomic<unsigned>* sqHead_ = nullptr;
+  std::atomic<unsigned>* sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned* sqArray_ = nullptr;
+  unsigned sqEntries_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqesBytes_ = 0;
+
+  char* cqRing_ = nullptr;
+  size_t cqBytes_ = 0;
+  std::atomic<unsigned>* cqHead_ = nullptr;
+  std::atomic<unsigned>* cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned cqEntries_ = 0;
+
+  alignas(kCacheLineSize) std::atomic<unsigned> inFlight_{0};
+
+  std::thread reaper_;
+};
+
+Future<size_t> submitIo(uint8_t opcode, int fd, uint64_t offset, void* data, size_t size) {
+  auto req = std::make_shared<IoRequest>();
+  req->iov.iov_base = data;
+  req->iov.iov_len = size;
+
+  // If the Future is waited on before the completion is reaped, this functor runs inline and must
+  // wait for the completion itself.
+  InterceptionInvoker interceptor;
+  Future<size_t> future(
+      [req]() {
+        req->done.wait(1);
+        return toIoResult(req->result, -req->result);
+      },
+      interceptor,
+      kNotAsync,
+      kNotDeferred);
+  req->complete = std::move(interceptor.savedOffFn);
+
+  if (!IoUring::instance().submit(opcode, fd, offset, req.get())) {
+    // Nothing will complete this request.  Mark it failed so that the intercepted function does not
+    // block, and run it to release its reference to the Future.
+    OnceFunction complete = std::move(req->complete);
+    req->result = -EAGAIN;
+    req->done.notify(1);
+    complete();
+    if (opcode == IORING_OP_READV) {
+      return readAsyncFallback(fd, offset, data, size);
+    }
+    return writeAsyncFallback(fd, offset, data, size);
+  }
+  return future;
+}
+
+} // namespace
+#endif // DISPENSO_HAS_IO_URING
+} // namespace detail
+
+namespace io {
+
+Future<size_t> readAsync(int fd, uint64_t offset, void* data, size_t size) {
+#if defined(DISPENSO_HAS_IO_URING)
+  if (usingIoUring()) {
+    return detail::submitIo(IORING_OP_READV, fd, offset, data, size);
+  }
+#endif // DISPENSO_HAS_IO_URING
+  return detail::readAsyncFallback(fd, offset, data, size);
+}
+
+Future<size_t> writeAsync(int fd, uint64_t offset, const void* data, size_t size) {
+#if defined(DISPENSO_HAS_IO_URING)
+  if (usingIoUring()) {
+    return detail::submitIo(IORING_OP_WRITEV, fd, offset, const_cast<void*>(data), size);
+  }
+#endif // DISPENSO_HAS_IO_URING
+  return detail::writeAsyncFallback(fd, offset, data, size);
+}
+
+bool usingIoUring() {
+#if defined(DISPENSO_HAS_IO_URING)
+  return detail::IoUring::instance().valid();
+#else
+  return false;
+#endif // DISPENSO_HAS_IO_URING
+}
+
+} // namespace io
+} // namespace dispenso
+
+#endif // !_WIN32
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file async_io.h
+ * Asynchronous positional file reads and writes that return Futures.  On Linux these are submitted
+ * to an io_uring, and completions are reaped by a single dedicated thread, so that pool threads do
+ * not block on I/O.  When io_uring is unavailable (older kernels, seccomp restrictions, or
+ * non-Linux platforms), each operation falls back to a blocking <code>pread</code>/
+ * <code>pwrite</code> executed on a new thread.
+ *
+ * These functions are not available on Windows.
+ **/
+
+#pragma once
+
+#if !defined(_WIN32)
+
+#include <cstdint>
+#include <limits>
+
+#include <dispenso/future.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace io {
+
+/**
+ * The value produced by a failed operation's Future when exceptions are disabled.  When exceptions
+ * are enabled, <code>get()</code> instead throws <code>std::system_error</code>.
+ **/
+constexpr size_t kIoError = std::numeric_limits<size_t>::max();
+
+/**
+ * Read from a file descriptor at an offset, asynchronously.
+ *
+ * @param fd The file descriptor to read from.  It must remain open until the returned Future is
+ * ready.
+ * @param offset The byte offset in the file at which to begin reading.
+ * @param data The destination buffer.  It must remain valid until the returned Future is ready.
+ * @param size The maximum number of bytes to read.
+ *
+ * @return A Future holding the number of bytes read, which may be less than <code>size</code>
+ * (for example at end of file), exactly as with <code>pread</code>.
+ **/
+DISPENSO_DLL_ACCESS Future<size_t> readAsync(int fd, uint64_t offset, void* data, size_t size);
+
+/**
+ * Write to a file descriptor at an offset, asynchronously.
+ *
+ * @param fd The file descriptor to write to.  It must remain open until the returned Future is
+ * ready.
+ * @param offset The byte offset in the file at which to begin writing.
+ * @param data The source buffer.  It must remain valid until the returned Future is ready.
+ * @param size The number of bytes to write.
+ *
+ * @return A Future holding the number of bytes written, which may be less than
+ * <code>size</code>, exactly as with <code>pwrite</code>.
+ **/
+DISPENSO_DLL_ACCESS Future<size_t>
+writeAsync(int fd, uint64_t offset, const void* data, size_t size);
+
+/**
+ * Determine whether asynchronous I/O is being serviced by io_uring.
+ *
+ * @return true if io_uring is in use, false if operations fall back to blocking calls on new
+ * threads.
+ **/
+DISPENSO_DLL_ACCESS bool usingIoUring();
+
+} // namespace io
+
+namespace detail {
+// The fallback paths, exposed for testing.
+DISPENSO_DLL_ACCESS Future<size_t>
+readAsyncFallback(int fd, uint64_t offset, void* data, size_t size);
+DISPENSO_DLL_ACCESS Future<size_t>
+writeAsyncFallback(int fd, uint64_t offset, const void* data, size_t size);
+} // namespace detail
+} // namespace dispenso
+
+#endif // !_WIN32
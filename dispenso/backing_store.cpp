@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/backing_store.h>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+namespace dispenso {
+
+#if defined(__linux__)
+
+namespace {
+// From linux/mempolicy.h, which is not always installed.
+constexpr int kMpolPreferred = 1;
+
+size_t pageSize() {
+  static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+size_t roundUp(size_t bytes, size_t granularity) {
+  return (bytes + granularity - 1) & ~(granularity - 1);
+}
+
+size_t mappedBytes(size_t bytes, BackingStoreOptions options) {
+  return roundUp(bytes, options.hugePages ? kHugePageSize : pageSize());
+}
+
+void bindToCurrentNode(void* ptr, size_t bytes) {
+#if defined(SYS_mbind)
+  uint32_t node = currentNumaNode();
+  constexpr size_t kBitsPerWord = 8 * sizeof(unsigned long);
+  unsigned long mask[4] = {};
+  if (node >= 4 * kBitsPerWord) {
+    return;
+  }
+  mask[node / kBitsPerWord] = 1UL << (node % kBitsPerWord);
+  // Best effort; on failure, the default first-touch placement applies.
+  (void)::syscall(SYS_mbind, ptr, bytes, kMpolPreferred, mask, 4 * kBitsPerWord + 1, 0);
+#else
+  (void)ptr;
+  (void)bytes;
+#endif // SYS_mbind
+}
+} // namespace
+
+void* backingStoreAlloc(size_t bytes, size_t alignment, BackingStoreOptions options) {
+  if (!options.hugePages && !options.numaLocal) {
+    return detail::alignedMalloc(bytes, alignment);
+  }
+
+  size_t length = mappedBytes(bytes, options);
+  size_t align = std::max(alignment, options.hugePages ? kHugePageSize : pageSize());
+  // Over-map so that an aligned range of the right length can be carved out, then unmap the rest.
+  size_t slop = align > pageSize() ? align : 0;
+  void* mapped =
+      ::mmap(nullptr, length + slop, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+  char* base = reinterpret_cast<char*>(mapped);
+  char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(base), align));
+  if (aligned > base) {
+    ::munmap(base, static_cast<size_t>(aligned - base));
+  }
+  char* end = base + length + slop;
+  if (aligned + length < end) {
+    ::munmap(aligned + length, static_cast<size_t>(end - (aligned + length)));
+  }
+
+#if defined(MADV_HUGEPAGE)
+  if (options.hugePages) {
+    ::madvise(aligned, length, MADV_HUGEPAGE);
+  }
+#endif // MADV_HUGEPAGE
+  if (options.numaLocal) {
+    bindToCurrentNode(aligned, length);
+  }
+  return aligned;
+}
+
+void backingStoreFree(void* ptr, size_t bytes, BackingStoreOptions options) {
+  if (!options.hugePages && !options.numaLocal) {
+    detail::alignedFree(ptr);
+    return;
+  }
+  if (ptr) {
+    ::munmap(ptr, mappedBytes(bytes, options));
+  }
+}
+
+uint32_t currentNumaNode() {
+#if defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return node;
+  }
+#endif // SYS_getcpu
+  return 0;
+}
+
+#else
+
+void* backingStoreAlloc(size_t bytes, size_t alignment, BackingStoreOptions) {
+  return detail::alignedMalloc(bytes, alignment);
+}
+
+void backingStoreFree(void* ptr, size_t, BackingStoreOptions) {
+  detail::alignedFree(ptr);
+}
+
+uint32_t currentNumaNode() {
+  return 0;
+}
+
+#endif // __linux__
+
+} // namespace dispenso
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file backing_store.h
+ * Functions for obtaining large blocks of memory directly from the operating system, optionally
+ * backed by transparent huge pages and placed on the calling thread's NUMA node.  These are
+ * intended to back slab-based allocators such as PoolAllocator.
+ **/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * Placement policies for memory obtained via backingStoreAlloc.  The default options use
+ * alignedMalloc.  Options that are not supported on the current platform are ignored.
+ **/
+struct BackingStoreOptions {
+  /**
+   * Map memory in whole, aligned huge pages (2MB on x86-64 and aarch64) and ask the kernel to back
+   * it with transparent huge pages.  Sizes are rounded up to a multiple of the huge page size.
+   **/
+  bool hugePages = false;
+  /**
+   * Prefer placing memory on the NUMA node of the allocating thread, rather than on the node of the
+   * thread that first touches each page.
+   **/
+  bool numaLocal = false;
+};
+
+/**
+ * The size of huge pages used when BackingStoreOptions::hugePages is set.
+ **/
+constexpr size_t kHugePageSize = size_t{1} << 21;
+
+/**
+ * Allocate a block of memory.
+ *
+ * @param bytes The size of the block.
+ * @param alignment The required alignment, a power of two.
+ * @param options The placement policy.
+ * @return The block, or nullptr if memory could not be obtained.
+ **/
+DISPENSO_DLL_ACCESS void* backingStoreAlloc(size_t bytes, size_t alignment, BackingStoreOptions options);
+
+/**
+ * Free a block obtained from backingStoreAlloc.
+ *
+ * @param ptr The block.
+ * @param bytes The size the block was allocated with.
+ * @param options The options the block was allocated with.
+ **/
+DISPENSO_DLL_ACCESS void backingStoreFree(void* ptr, size_t bytes, BackingStoreOptions options);
+
+/**
+ * Get the NUMA node the calling thread is currently running on.
+ *
+ * @return The node index, or zero if it cannot be determined.
+ **/
+DISPENSO_DLL_ACCESS uint32_t currentNumaNode();
+
+} // namespace dispenso
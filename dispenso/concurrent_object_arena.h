@@ -12,13 +12,14 @@
 
 #pragma once
 
+#include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
 
 #include <atomic>
 #include <cassert>
+#include <climits>
+#include <cstdint>
 #include <cstring>
-#include <mutex>
-#include <vector>
 
 namespace detail {
 
@@ -42,15 +43,21 @@ namespace dispenso {
  * arrays, with additional bookkeeping. The size of arrays is always power of
  * two (to optimize indexed access)
  * <pre>
- *  buffers  |<────     bufferSize      ───>|
- *    ┌─┐    ┌──────────────────────────────┐
- *    │*├───>│                              │
- *    ├─┤    ├──────────────────────────────┤
- *    │*├───>│                              │
- *    ├─┤    ├──────────────────────────────┤
- *    │*├───>│                              │
- *    └─┘    └──────────────────────────────┘
+ *  segments   buffers  |<────     bufferSize      ───>|
+ *    ┌─┐      ┌─┐      ┌──────────────────────────────┐
+ *    │*├─────>│*├─────>│                              │
+ *    ├─┤      ├─┤      ├──────────────────────────────┤
+ *    │*├──┐   │*├─────>│                              │
+ *    ├─┤  │   └─┘      └──────────────────────────────┘
+ *    │ │  │   ┌─┐      ┌──────────────────────────────┐
+ *    └─┘  └──>│*├─────>│                              │
+ *             ├─┤      └──────────────────────────────┘
+ *             │ │
+ *             └─┘
  *</pre>
+ * Buffer pointers live in a two-level directory: a fixed array of segments, each twice the size of
+ * the last, so that the directory never needs to be copied or locked as the arena grows.  Segments
+ * and buffers are installed with compare-and-swap.
  **/
 template <class T, class Index = size_t, size_t alignment = dispenso::kCacheLineSize>
 struct ConcurrentObjectArena {
@@ -68,12 +75,11 @@ struct ConcurrentObjectArena {
         kBufferSize(Index{1} << kLog2BuffSize),
         kMask((Index{1} << kLog2BuffSize) - 1),
         pos_(0),
-        allocatedSize_(0),
-        buffers_(nullptr),
-        buffersSize_(0),
-        buffersPos_(0) {
-    allocateBuffer();
-    allocatedSize_.store(kBufferSize, std::memory_order_relaxed);
+        numBuffers_(0) {
+    clearSegments();
+    ensureSegment(0);
+    firstSegment_ = segments_[0].load(std::memory_order_relaxed);
+    ensureBuffers(0, 0);
   }
 
   /**
@@ -84,21 +90,17 @@ struct ConcurrentObjectArena {
         kBufferSize(other.kBufferSize),
         kMask(other.kMask),
         pos_(other.pos_.load(std::memory_order_relaxed)),
-        allocatedSize_(other.allocatedSize_.load(std::memory_order_relaxed)),
-        buffersSize_(other.buffersSize_),
-        buffersPos_(other.buffersPos_) {
-    T** otherBuffers = other.buffers_.load(std::memory_order_acquire);
-    T** newBuffers = new T*[buffersSize_];
-    for (Index i = 0; i < buffersSize_; ++i) {
-      void* ptr = detail::alignedMalloc(kBufferSize * sizeof(T), alignment);
-#if defined(__cpp_exceptions)
-      if (ptr == nullptr)
-        throw std::bad_alloc();
-#endif // __cpp_exceptions
-      std::memcpy(ptr, otherBuffers[i], kBufferSize * sizeof(T));
-      newBuffers[i] = static_cast<T*>(ptr);
+        numBuffers_(other.numBuffers_.load(std::memory_order_relaxed)) {
+    clearSegments();
+    ensureSegment(0);
+    firstSegment_ = segments_[0].load(std::memory_order_relaxed);
+    const Index numBuffs = numBuffers_.load(std::memory_order_relaxed);
+    for (Index i = 0; i < numBuffs; ++i) {
+      T* buf = allocateBuffer();
+      std::memcpy(buf, other.getBuffer(i), kBufferSize * sizeof(T));
+      ensureSegment(segmentOf(i));
+      bufferSlot(i).store(buf, std::memory_order_relaxed);
     }
-    buffers_.store(newBuffers, std::memory_order_release);
   }
 
   /**
@@ -109,23 +111,24 @@ struct ConcurrentObjectArena {
         kBufferSize(0),
         kMask(0),
         pos_(0),
-        allocatedSize_(0),
-        buffers_(nullptr),
-        buffersSize_(0),
-        buffersPos_(0) {
+        numBuffers_(0),
+        firstSegment_(nullptr) {
+    clearSegments();
     swap(*this, other);
   }
 
   ~ConcurrentObjectArena() {
-    T** buffers = buffers_.load(std::memory_order_acquire);
-
-    for (Index i = 0; i < buffersPos_; i++)
-      detail::alignedFree(buffers[i]);
-
-    delete[] buffers;
-
-    for (T** p : deleteLater_)
-      delete[] p;
+    for (uint32_t s = 0; s < kMaxSegments; ++s) {
+      std::atomic<T*>* segment = segments_[s].load(std::memory_order_acquire);
+      if (segment == nullptr)
+        break;
+      for (Index i = 0; i < segmentSize(s); ++i) {
+        T* buf = segment[i].load(std::memory_order_relaxed);
+        if (buf != nullptr)
+          detail::alignedFree(buf);
+      }
+      delete[] segment;
+    }
   }
 
   /**
@@ -150,33 +153,20 @@ struct ConcurrentObjectArena {
    * Grow a container
    *
    * This function is thread safe and never invalidates pointers or
-   * references to the rest of the elements. It is lock-free if new elements
-   * can be placed in current buffer. It locks if it allocates a new buffer.
+   * references to the rest of the elements. It is lock-free: the range is claimed with a single
+   * atomic add, and any buffers it needs are installed with compare-and-swap.  Threads racing to
+   * install the same buffer may each allocate one, with all but one freeing theirs.
    * @param delta New size of the container will be <code>delta<\code> elements bigger.
    * @return index of the first element of the allocated group.
    **/
   Index grow_by(const Index delta) {
-    Index newPos;
-    Index oldPos = pos_.load(std::memory_order_relaxed);
-
-    do {
-      Index curSize = allocatedSize_.load(std::memory_order_acquire);
-
-      if (oldPos + delta >= curSize) {
-        const std::lock_guard<std::mutex> guard(resizeMutex_);
-        curSize = allocatedSize_.load(std::memory_order_relaxed);
-        while (oldPos + delta >= curSize) {
-          allocateBuffer();
-          allocatedSize_.store(curSize + kBufferSize, std::memory_order_release);
-          curSize = curSize + kBufferSize;
-        }
-      }
-
-      newPos = oldPos + delta;
-    } while (!std::atomic_compare_exchange_weak_explicit(
-        &pos_, &oldPos, newPos, std::memory_order_release, std::memory_order_relaxed));
+    const Index oldPos = pos_.fetch_add(delta, std::memory_order_relaxed);
+    const Index newPos = oldPos + delta;
 
-    constructObjects(oldPos, oldPos + delta);
+    const Index lastBuffer = newPos >> kLog2BuffSize;
+    if (lastBuffer >= numBuffers_.load(std::memory_order_acquire))
+      ensureBuffers(oldPos >> kLog2BuffSize, lastBuffer);
+    constructObjects(oldPos, newPos);
 
     return oldPos;
   }
@@ -193,7 +183,7 @@ struct ConcurrentObjectArena {
     const Index bufIndex = index >> kLog2BuffSize;
     const Index i = index & kMask;
 
-    return buffers_.load(std::memory_order_acquire)[bufIndex][i];
+    return bufferAt(bufIndex)[i];
   }
 
   /**
@@ -223,7 +213,7 @@ struct ConcurrentObjectArena {
    * @return The current capacity. Note that elements can be appended concurrently
    **/
   Index capacity() const {
-    return allocatedSize_.load(std::memory_order_relaxed);
+    return numBuffers() * kBufferSize;
   }
 
   /**
@@ -231,7 +221,7 @@ struct ConcurrentObjectArena {
    * @return The current number of buffers. Note that buffers can be appended concurrently
    **/
   Index numBuffers() const {
-    return buffersPos_;
+    return numBuffers_.load(std::memory_order_relaxed);
   }
 
   /**
@@ -240,7 +230,7 @@ struct ConcurrentObjectArena {
    * @return The pointer to the buffer.
    **/
   const T* getBuffer(const Index index) const {
-    return buffers_.load(std::memory_order_acquire)[index];
+    return bufferAt(index);
   }
 
   /**
@@ -249,7 +239,7 @@ struct ConcurrentObjectArena {
    * @return The pointer to the buffer.
    **/
   T* getBuffer(const Index index) {
-    return buffers_.load(std::memory_order_acquire)[index];
+    return bufferAt(index);
   }
 
   /**
@@ -285,44 +275,100 @@ struct ConcurrentObjectArena {
     rhs.pos_.store(lhs.pos_.load(std::memory_order_relaxed), std::memory_order_relaxed);
     lhs.pos_.store(rhs_pos, std::memory_order_relaxed);
 
-    const Index rhs_allocatedSize = rhs.allocatedSize_.load(std::memory_order_relaxed);
-    rhs.allocatedSize_.store(
-        lhs.allocatedSize_.load(std::memory_order_relaxed), std::memory_order_relaxed);
-    lhs.allocatedSize_.store(rhs_allocatedSize, std::memory_order_relaxed);
+    const Index rhs_numBuffers = rhs.numBuffers_.load(std::memory_order_relaxed);
+    rhs.numBuffers_.store(
+        lhs.numBuffers_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    lhs.numBuffers_.store(rhs_numBuffers, std::memory_order_relaxed);
 
-    T** const rhs_buffers = rhs.buffers_.load(std::memory_order_acquire);
-    rhs.buffers_.store(lhs.buffers_.load(std::memory_order_acquire), std::memory_order_release);
-    lhs.buffers_.store(rhs_buffers, std::memory_order_release);
-
-    swap(lhs.buffersSize_, rhs.buffersSize_);
-    swap(lhs.buffersPos_, rhs.buffersPos_);
-    swap(lhs.deleteLater_, rhs.deleteLater_);
+    for (uint32_t s = 0; s < kMaxSegments; ++s) {
+      std::atomic<T*>* const rhs_segment = rhs.segments_[s].load(std::memory_order_acquire);
+      rhs.segments_[s].store(
+          lhs.segments_[s].load(std::memory_order_acquire), std::memory_order_release);
+      lhs.segments_[s].store(rhs_segment, std::memory_order_release);
+    }
+    swap(lhs.firstSegment_, rhs.firstSegment_);
   }
 
  private:
-  void allocateBuffer() {
+  // Segment s holds kFirstSegmentSize << s buffer pointers.  Buffer b lives in the segment given
+  // by the high bit of b + kFirstSegmentSize.  The first segment is allocated up front, so that
+  // indexing into the first kFirstSegmentSize buffers is just a shift and mask.
+  static constexpr uint32_t kLog2FirstSegmentSize = 9;
+  static constexpr Index kFirstSegmentSize = Index{1} << kLog2FirstSegmentSize;
+  static constexpr uint32_t kMaxSegments = sizeof(Index) * CHAR_BIT - kLog2FirstSegmentSize;
+
+  static Index segmentSize(uint32_t segment) {
+    return kFirstSegmentSize << segment;
+  }
+
+  static uint32_t segmentOf(Index bufIndex) {
+    return detail::log2(static_cast<uint64_t>(bufIndex + kFirstSegmentSize)) -
+        kLog2FirstSegmentSize;
+  }
+
+  // The slot for a buffer whose segment is already installed.
+  std::atomic<T*>& bufferSlot(Index bufIndex) const {
+    const uint32_t s = segmentOf(bufIndex);
+    std::atomic<T*>* segment = segments_[s].load(std::memory_order_acquire);
+    return segment[bufIndex + kFirstSegmentSize - segmentSize(s)];
+  }
+
+  T* bufferAt(Index bufIndex) const {
+    if (bufIndex < kFirstSegmentSize)
+      return firstSegment_[bufIndex].load(std::memory_order_acquire);
+    return bufferSlot(bufIndex).load(std::memory_order_acquire);
+  }
+
+  void clearSegments() {
+    for (auto& segment : segments_) {
+      segment.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  T* allocateBuffer() {
     void* ptr = detail::alignedMalloc(kBufferSize * sizeof(T), alignment);
 #if defined(__cpp_exceptions)
     if (ptr == nullptr)
       throw std::bad_alloc();
 #endif // __cpp_exceptions
+    return static_cast<T*>(ptr);
+  }
 
-    if (buffersPos_ < buffersSize_) {
-      buffers_.load(std::memory_order_acquire)[buffersPos_++] = static_cast<T*>(ptr);
-    } else {
-      const Index oldBuffersSize = buffersSize_;
-      T** oldBuffers = buffers_.load(std::memory_order_acquire);
-
-      buffersSize_ = oldBuffersSize == 0 ? 2 : oldBuffersSize * 2;
-      T** newBuffers = new T*[buffersSize_];
+  void ensureSegment(uint32_t s) {
+    if (segments_[s].load(std::memory_order_acquire) != nullptr)
+      return;
+    const Index size = segmentSize(s);
+    std::atomic<T*>* segment = new std::atomic<T*>[size];
+    for (Index i = 0; i < size; ++i)
+      segment[i].store(nullptr, std::memory_order_relaxed);
+    std::atomic<T*>* expected = nullptr;
+    if (!segments_[s].compare_exchange_strong(
+            expected, segment, std::memory_order_acq_rel, std::memory_order_acquire))
+      delete[] segment;
+  }
 
-      if (oldBuffers != nullptr) {
-        std::memcpy(newBuffers, oldBuffers, sizeof(T*) * oldBuffersSize);
-        deleteLater_.push_back(oldBuffers);
-      }
+  // Install any missing buffers in [firstBuffer, lastBuffer].
+  void ensureBuffers(const Index firstBuffer, const Index lastBuffer) {
+    for (Index b = firstBuffer; b <= lastBuffer; ++b) {
+      ensureSegment(segmentOf(b));
+      std::atomic<T*>& slot = bufferSlot(b);
+      if (slot.load(std::memory_order_acquire) != nullptr)
+        continue;
+      T* buf = allocateBuffer();
+      T* expected = nullptr;
+      if (!slot.compare_exchange_strong(
+              expected, buf, std::memory_order_acq_rel, std::memory_order_acquire))
+        detail::alignedFree(buf);
+    }
 
-      newBuffers[buffersPos_++] = static_cast<T*>(ptr);
-      buffers_.store(newBuffers, std::memory_order_release);
+    // Advance numBuffers_ past every installed buffer.  Whichever thread installs the lowest
+    // missing buffer carries it past any installed above.
+    Index numBuffs = numBuffers_.load(std::memory_order_acquire);
+    while (segments_[segmentOf(numBuffs)].load(std::memory_order_acquire) != nullptr &&
+           bufferSlot(numBuffs).load(std::memory_order_acquire) != nullptr) {
+      if (numBuffers_.compare_exchange_weak(
+              numBuffs, numBuffs + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        ++numBuffs;
     }
   }
 
@@ -332,7 +378,7 @@ struct ConcurrentObjectArena {
 
     Index bufStart = beginIndex & kMask;
     for (Index b = startBuffer; b <= endBuffer; ++b) {
-      T* buf = buffers_.load(std::memory_order_acquire)[b];
+      T* buf = bufferAt(b);
       const Index bufEnd = b == endBuffer ? (endIndex & kMask) : kBufferSize;
       for (Index i = bufStart; i < bufEnd; ++i)
         new (buf + i) T();
@@ -346,19 +392,18 @@ struct ConcurrentObjectArena {
   //                ──┬──
   //                  └─number of 1s is log2BuffSize
   //
-  std::mutex resizeMutex_;
-
   Index kLog2BuffSize;
   Index kBufferSize;
   Index kMask;
 
   std::atomic<Index> pos_;
-  std::atomic<Index> allocatedSize_;
+  // The number of buffers installed.  Every buffer below numBuffers_ is installed, though buffers
+  // above it may be too.
+  std::atomic<Index> numBuffers_;
 
-  std::atomic<T**> buffers_;
-  Index buffersSize_;
-  Index buffersPos_;
-  std::vector<T**> deleteLater_;
+  std::atomic<std::atomic<T*>*> segments_[kMaxSegments];
+  // segments_[0], which never changes once allocated.
+  std::atomic<T*>* firstSegment_;
 };
 
 } // namespace dispenso
@@ -36,7 +36,9 @@
  * (depending on the operation).  ConcurrentVector's iteration and random access is on-par with
  * std::deque (libstdc++), sometimes a bit faster, sometimes a bit slower, but .push_back() is about
  * an order of magnitude slower for serial use (note that by using one of the .grow_by() variants
- * could make this on-par for serial code, if applicable, see the "alternative" benchmarks).
+ * could make this on-par for serial code, if applicable, see the "alternative" benchmarks).  When
+ * many threads append, a per-thread ConcurrentVector::Appender amortizes the cost of growth over a
+ * block of elements.
  *
  * Most notably, in the parallel growth benchmarks, (on Clang 8, Linux, 32-core Threadripper
  * 2990WX), ConcurrentVector is between about 5x and 20x faster than std::vector + std::mutex, and
@@ -49,8 +51,10 @@
 #include <cassert>
 #include <climits>
 #include <cstring>
+#include <functional>
 #include <initializer_list>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 #include <dispenso/detail/math.h>
@@ -795,6 +799,64 @@ class ConcurrentVector {
     return operator[](index);
   }
 
+  /**
+   * Visit a range of the vector as contiguous spans, one per underlying buffer the range touches.
+   * Loops over raw pointers avoid the bucket boundary checks of iterators, and so are amenable to
+   * auto-vectorization.  Concurrency safe.
+   * @param start The index of the first element to visit.
+   * @param end One past the index of the last element to visit.
+   * @param f A functor with signature void(T* spanBegin, T* spanEnd), called once per span in
+   * order.
+   *
+   * @note As with iterators, it is the users responsibility to avoid racing on the elements.
+   **/
+  template <typename F>
+  void forEachSpan(size_type start, size_type end, F&& f) {
+    while (start < end) {
+      auto binfo = bucketAndSubIndex(start);
+      size_type len = std::min(binfo.bucketCapacity - binfo.bucketIndex, end - start);
+      T* span = buffers_[binfo.bucket].load(std::memory_order_relaxed) + binfo.bucketIndex;
+      f(span, span + len);
+      start += len;
+    }
+  }
+
+  /**
+   * Visit a range of the vector as contiguous spans, one per underlying buffer the range touches.
+   * Concurrency safe.
+   * @param start The index of the first element to visit.
+   * @param end One past the index of the last element to visit.
+   * @param f A functor with signature void(const T* spanBegin, const T* spanEnd), called once per
+   * span in order.
+   **/
+  template <typename F>
+  void forEachSpan(size_type start, size_type end, F&& f) const {
+    const_cast<ConcurrentVector*>(this)->forEachSpan(
+        start, end, [&f](const T* b, const T* e) { f(b, e); });
+  }
+
+  /**
+   * Visit the whole vector as contiguous spans, one per underlying buffer.  Concurrency safe, and
+   * elements appended concurrently with this call may or may not be visited.
+   * @param f A functor with signature void(T* spanBegin, T* spanEnd), called once per span in
+   * order.
+   **/
+  template <typename F>
+  void forEachSpan(F&& f) {
+    forEachSpan(0, size_.load(std::memory_order_relaxed), std::forward<F>(f));
+  }
+
+  /**
+   * Visit the whole vector as contiguous spans, one per underlying buffer.  Concurrency safe, and
+   * elements appended concurrently with this call may or may not be visited.
+   * @param f A functor with signature void(const T* spanBegin, const T* spanEnd), called once per
+   * span in order.
+   **/
+  template <typename F>
+  void forEachSpan(F&& f) const {
+    forEachSpan(0, size_.load(std::memory_order_relaxed), std::forward<F>(f));
+  }
+
   /**
    * Get an iterator to the start of the vector.  Concurrency safe.
    * @return An iterator to the start of the vector.
@@ -993,6 +1055,188 @@ class ConcurrentVector {
     buffers_ = std::move(oth.buffers_);
   }
 
+  /**
+   * A handle for appending to a ConcurrentVector from a single thread.  Rather than growing the
+   * shared size once per element as push_back does, an Appender reserves a block of slots at a time
+   * and fills it locally, so that appending costs one atomic operation per block.  Each thread
+   * should use its own Appender, e.g. via the per-thread states of parallel_for.
+   *
+   * Reserved slots count toward the vector's size() before they are filled.  The vector must not be
+   * read past the filled elements, nor destroyed, until every Appender on it has been flushed or
+   * destroyed.
+   *
+   * <b>Padding:</b> on flush (including on destruction), the unused tail of the current block is
+   * handed back if no other thread has grown the vector since it was reserved.  Otherwise the tail
+   * lies between other threads' elements and cannot be removed, so it is filled with padding
+   * elements: copies of the padding value passed at construction, or default constructed elements
+   * if none was given.  The vector may therefore contain padding elements interleaved with the
+   * appended ones, and readers must be able to tell them apart (e.g. a null pointer or a sentinel
+   * value).  flush() reports the index range it padded.  Padding is at most blockSize - 1 elements
+   * per flush.
+   **/
+  class Appender {
+   public:
+    /**
+     * Create an Appender which pads with default constructed elements.  T must be default
+     * constructible; otherwise supply a padding value.
+     * @param vec The vector to append to.
+     * @param blockSize The number of slots to reserve at a time.
+     **/
+    explicit Appender(ConcurrentVector& vec, size_type blockSize = 64)
+        : vec_(&vec),
+          blockSize_(std::max<size_type>(blockSize, 1)),
+          pad_(defaultPadding(std::is_default_constructible<T>())) {
+      static_assert(
+          std::is_default_constructible<T>::value,
+          "Appender requires a padding value for types without a default constructor");
+    }
+
+    /**
+     * Create an Appender which pads with copies of <code>padding</code>.
+     * @param vec The vector to append to.
+     * @param blockSize The number of slots to reserve at a time.
+     * @param padding The value used to fill block tails that can't be handed back on flush.
+     **/
+    Appender(ConcurrentVector& vec, size_type blockSize, const T& padding)
+        : vec_(&vec),
+          blockSize_(std::max<size_type>(blockSize, 1)),
+          pad_([padding](T* b, T* e) {
+            for (; b != e; ++b) {
+              new (b) T(padding);
+            }
+          }) {}
+
+    Appender(Appender&& other)
+        : vec_(other.vec_),
+          blockSize_(other.blockSize_),
+          pad_(other.pad_),
+          next_(other.next_),
+          spanEnd_(other.spanEnd_),
+          spanEndIndex_(other.spanEndIndex_),
+          blockEnd_(other.blockEnd_) {
+      other.reset();
+    }
+
+    Appender& operator=(Appender&& other) {
+      if (&other != this) {
+        flush();
+        vec_ = other.vec_;
+        blockSize_ = other.blockSize_;
+        pad_ = other.pad_;
+        next_ = other.next_;
+        spanEnd_ = other.spanEnd_;
+        spanEndIndex_ = other.spanEndIndex_;
+        blockEnd_ = other.blockEnd_;
+        other.reset();
+      }
+      return *this;
+    }
+
+    /**
+     * Append a value to the vector.
+     * @param val The value to copy into the new element.
+     * @return A reference to the new element.
+     **/
+    T& push_back(const T& val) {
+      return emplace_back(val);
+    }
+
+    /**
+     * Append a value to the vector.
+     * @param val The value to move into the new element.
+     * @return A reference to the new element.
+     **/
+    T& push_back(T&& val) {
+      return emplace_back(std::move(val));
+    }
+
+    /**
+     * Append a value to the vector.
+     * @param args The arg pack used to construct the new element.
+     * @return A reference to the new element.
+     **/
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+      if (DISPENSO_EXPECT(next_ == spanEnd_, 0)) {
+        nextSpan();
+      }
+      T* t = new (next_) T(std::forward<Args>(args)...);
+      ++next_;
+      return *t;
+    }
+
+    /**
+     * Give up the unused tail of the current block, handing it back to the vector if possible, and
+     * otherwise filling it with padding elements.
+     * @return The index range [first, second) of the padding elements in the vector, which is empty
+     * if no padding was needed.
+     **/
+    std::pair<size_type, size_type> flush() {
+      size_type used = spanEndIndex_ - static_cast<size_type>(spanEnd_ - next_);
+      std::pair<size_type, size_type> padded(used, used);
+      if (used != blockEnd_) {
+        size_type expected = blockEnd_;
+        if (!vec_->size_.compare_exchange_strong(expected, used, std::memory_order_acq_rel)) {
+          padded.second = blockEnd_;
+          vec_->forEachSpan(used, blockEnd_, pad_);
+        }
+      }
+      reset();
+      return padded;
+    }
+
+    ~Appender() {
+      flush();
+    }
+
+   private:
+    using PadFunc = std::function<void(T*, T*)>;
+
+    static PadFunc defaultPadding(std::true_type) {
+      return [](T* b, T* e) {
+        for (; b != e; ++b) {
+          new (b) T();
+        }
+      };
+    }
+
+    static PadFunc defaultPadding(std::false_type) {
+      return {};
+    }
+
+    void reset() {
+      next_ = spanEnd_ = nullptr;
+      spanEndIndex_ = blockEnd_ = 0;
+    }
+
+    void nextSpan() {
+      if (spanEndIndex_ == blockEnd_) {
+        flush();
+        spanEndIndex_ = vec_->size_.fetch_add(blockSize_, std::memory_order_acq_rel);
+        blockEnd_ = spanEndIndex_ + blockSize_;
+        vec_->buffers_.allocAsNecessary(
+            vec_->bucketAndSubIndex(spanEndIndex_), blockSize_, vec_->bucketAndSubIndex(blockEnd_));
+      }
+      // A block that crosses a bucket boundary is filled one bucket at a time.
+      auto binfo = vec_->bucketAndSubIndex(spanEndIndex_);
+      size_type len = std::min(binfo.bucketCapacity - binfo.bucketIndex, blockEnd_ - spanEndIndex_);
+      next_ = vec_->buffers_[binfo.bucket].load(std::memory_order_relaxed) + binfo.bucketIndex;
+      spanEnd_ = next_ + len;
+      spanEndIndex_ += len;
+    }
+
+    ConcurrentVector* vec_;
+    size_type blockSize_;
+    // Constructs padding elements in [b, e).
+    PadFunc pad_;
+    // The current span is [next_, spanEnd_), and spanEnd_ corresponds to index spanEndIndex_ in the
+    // vector.  The current block ends at index blockEnd_.
+    T* next_ = nullptr;
+    T* spanEnd_ = nullptr;
+    size_type spanEndIndex_ = 0;
+    size_type blockEnd_ = 0;
+  };
+
  private:
   DISPENSO_INLINE cv::BucketInfo bucketAndSubIndexForIndex(size_t index) const {
 #if defined(__clang__)
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/detail/deadline_waiter.h>
+
+#include <cmath>
+#include <cstdint>
+
+#include <dispenso/timing.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif // __linux__
+
+namespace dispenso {
+namespace detail {
+
+#if defined(__linux__)
+
+DeadlineWaiter::DeadlineWaiter()
+    : timerFd_(::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      wakeFd_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+  if (timerFd_ < 0 || wakeFd_ < 0) {
+    if (timerFd_ >= 0) {
+      ::close(timerFd_);
+      timerFd_ = -1;
+    }
+    if (wakeFd_ >= 0) {
+      ::close(wakeFd_);
+      wakeFd_ = -1;
+    }
+  }
+}
+
+DeadlineWaiter::~DeadlineWaiter() {
+  if (valid()) {
+    ::close(timerFd_);
+    ::close(wakeFd_);
+  }
+}
+
+void DeadlineWaiter::waitUntil(double deadline) {
+  pollfd fds[2];
+  fds[0].fd = wakeFd_;
+  fds[0].events = POLLIN;
+  fds[1].fd = timerFd_;
+  fds[1].events = POLLIN;
+  nfds_t numFds = 1;
+
+  if (std::isfinite(deadline)) {
+    // getTime() may not be based on CLOCK_MONOTONIC, so translate through the time remaining.
+    timespec now;
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    double remaining = deadline - getTime();
+    if (remaining <= 0.0) {
+      return;
+    }
+    int64_t ns = static_cast<int64_t>(now.tv_nsec) + static_cast<int64_t>(remaining * 1e9);
+    itimerspec spec = {};
+    spec.it_value.tv_sec = now.tv_sec + static_cast<decltype(now.tv_sec)>(ns / 1000000000);
+    spec.it_value.tv_nsec = static_cast<decltype(now.tv_nsec)>(ns % 1000000000);
+    if (::timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+      numFds = 2;
+    }
+  }
+
+  // If the timer couldn't be armed, fall back to a short poll timeout; the caller rechecks.  Arming
+  // the timer resets any stale expiration, so only the eventfd needs to be consumed.
+  int timeoutMs = numFds == 1 && std::isfinite(deadline) ? 1 : -1;
+  // allow spurious wakeups
+  ::poll(fds, numFds, timeoutMs);
+
+  uint64_t val;
+  if (::read(wakeFd_, &val, sizeof(val)) < 0) {
+    // No wake was pending.
+  }
+}
+
+void DeadlineWaiter::wake() {
+  uint64_t one = 1;
+  if (::write(wakeFd_, &one, sizeof(one)) < 0) {
+    // The counter is saturated, which already guarantees a pending wake.
+  }
+}
+
+#else
+
+DeadlineWaiter::DeadlineWaiter() {}
+DeadlineWaiter::~DeadlineWaiter() {}
+void DeadlineWaiter::waitUntil(double /*deadline*/) {}
+void DeadlineWaiter::wake() {}
+
+#endif // __linux__
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+namespace dispenso {
+namespace detail {
+
+// Blocks a thread until an absolute deadline on the getTime() timeline, or until woken.  On Linux
+// the deadline is armed on a timerfd as an absolute CLOCK_MONOTONIC expiry.  Unlike a relative
+// futex or nanosleep timeout, a timerfd expiry is not subject to the thread's timer slack, so the
+// thread wakes within a few microseconds of the deadline without spinning.  On other platforms, or
+// if the file descriptors cannot be created, valid() returns false and the waiter must not be used.
+//
+// Only one thread may wait at a time; any thread may wake.
+class DeadlineWaiter {
+ public:
+  DeadlineWaiter();
+  ~DeadlineWaiter();
+
+  DeadlineWaiter(const DeadlineWaiter&) = delete;
+  DeadlineWaiter& operator=(const DeadlineWaiter&) = delete;
+
+  bool valid() const {
+    return timerFd_ >= 0;
+  }
+
+  // Wait until deadline has passed or wake() is called.  A wake() that happens while no thread is
+  // waiting causes the next wait to return immediately.  Spurious returns are allowed.  An infinite
+  // deadline waits only for wake().
+  void waitUntil(double deadline);
+
+  void wake();
+
+ private:
+  int timerFd_ = -1;
+  int wakeFd_ = -1;
+};
+
+} // namespace detail
+} // namespace dispenso
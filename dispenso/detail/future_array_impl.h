@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <new>
+#include <type_traits>
+
+#include <dispenso/detail/epoch_waiter.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+namespace detail {
+
+template <typename Result>
+struct FutureArrayStorage {
+  static constexpr size_t kElementSize = sizeof(Result);
+  static constexpr size_t kElementAlign = alignof(Result);
+
+  template <typename F>
+  static void run(char* buf, F& f, size_t index) {
+    new (buf) Result(f(index));
+  }
+
+  static void destroy(char* buf) {
+    reinterpret_cast<Result*>(buf)->~Result();
+  }
+
+  static const Result& get(const char* buf) {
+    return *reinterpret_cast<const Result*>(buf);
+  }
+};
+
+template <>
+struct FutureArrayStorage<void> {
+  static constexpr size_t kElementSize = 0;
+  static constexpr size_t kElementAlign = 1;
+
+  template <typename F>
+  static void run(char*, F& f, size_t index) {
+    f(index);
+  }
+
+  static void destroy(char*) {}
+
+  static void get(const char*) {}
+};
+
+inline constexpr size_t alignUp(size_t val, size_t alignment) {
+  return (val + alignment - 1) & ~(alignment - 1);
+}
+
+// The control block for a batch of futures.  A single allocation holds this header, followed by
+// per-element statuses, per-element result storage, and (when exceptions are enabled) per-element
+// exception storage.  Work is distributed in chunks via an atomic chunk index, as in the dynamic
+// parallel_for, and any element not yet started may be claimed and run inline by a waiter.
+template <typename Result>
+class FutureArrayImplBase {
+ public:
+  using Storage = FutureArrayStorage<Result>;
+
+  enum Status : int { kNotStarted, kRunning, kReady };
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool isReady(size_t index) const {
+    return statuses_[index].load(std::memory_order_acquire) == kReady;
+  }
+
+  // Run chunks until none remain.  Called by each scheduled worker, and by waitAll.
+  void runChunks() {
+    while (true) {
+      size_t chunk = nextChunk_.fetch_add(1, std::memory_order_relaxed);
+      if (chunk >= numChunks_) {
+        break;
+      }
+      size_t end = std::min(size_, (chunk + 1) * chunkSize_);
+      for (size_t i = chunk * chunkSize_; i < end; ++i) {
+        tryRun(i);
+      }
+    }
+  }
+
+  void wait(size_t index) {
+    if (tryRun(index)) {
+      return;
+    }
+    if (isReady(index)) {
+      return;
+    }
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    while (true) {
+      uint32_t epoch = epoch_.current();
+      if (statuses_[index].load(std::memory_order_seq_cst) == kReady) {
+        break;
+      }
+      epoch_.wait(epoch);
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  template <class Rep, class Period>
+  bool waitFor(size_t index, const std::chrono::duration<Rep, Period>& timeoutDuration) {
+    if (isReady(index)) {
+      return true;
+    }
+    auto deadline = std::chrono::steady_clock::now() + timeoutDuration;
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    bool ready;
+    while (true) {
+      uint32_t epoch = epoch_.current();
+      if ((ready = statuses_[index].load(std::memory_order_seq_cst) == kReady)) {
+        break;
+      }
+      auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0) {
+        break;
+      }
+      epoch_.waitFor(epoch, static_cast<uint64_t>(remaining.count()));
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return ready;
+  }
+
+  void waitAll() {
+    runChunks();
+    for (size_t i = 0; i < size_; ++i) {
+      wait(i);
+    }
+  }
+
+  decltype(auto) result(size_t index) const {
+    assert(isReady(index));
+#if defined(__cpp_exceptions)
+    if (exceptions_[index]) {
+      std::rethrow_exception(exceptions_[index]);
+    }
+#endif // __cpp_exceptions
+    return Storage::get(results_ + index * Storage::kElementSize);
+  }
+
+  void incRefCount() {
+    refCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void decRefCountMaybeDestroy() {
+    if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      destroy();
+    }
+  }
+
+ protected:
+  FutureArrayImplBase(size_t size, size_t chunkSize) : size_(size), chunkSize_(chunkSize) {
+    numChunks_ = (size_ + chunkSize_ - 1) / chunkSize_;
+  }
+
+  virtual ~FutureArrayImplBase() = default;
+
+  virtual void runElement(char* buf, size_t index) = 0;
+  virtual void destroy() = 0;
+
+  bool tryRun(size_t index) {
+    int expected = kNotStarted;
+    if (!statuses_[index].compare_exchange_strong(
+            expected, kRunning, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      return false;
+    }
+    char* buf = results_ + index * Storage::kElementSize;
+#if defined(__cpp_exceptions)
+    try {
+      runElement(buf, index);
+    } catch (...) {
+      exceptions_[index] = std::current_exception();
+    }
+#else
+    runElement(buf, index);
+#endif // __cpp_exceptions
+    // Sequential consistency pairs with the waiter's increment of waiters_ followed by its load of
+    // the status, ensuring that either we see the waiter or the waiter sees the ready status.
+    statuses_[index].store(kReady, std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst)) {
+      epoch_.bumpAndWakeAll();
+    }
+    return true;
+  }
+
+  // Compute the size of the trailing arrays, and set up the pointers into them.  The returned value
+  // is the total number of bytes required, including headerBytes.
+  static size_t layout(size_t headerBytes, size_t size, size_t* resultsOffset, size_t* excOffset) {
+    size_t bytes = alignUp(headerBytes, alignof(std::atomic<int>));
+    bytes += size * sizeof(std::atomic<int>);
+    bytes = alignUp(bytes, Storage::kElementAlign);
+    *resultsOffset = bytes;
+    bytes += size * Storage::kElementSize;
+#if defined(__cpp_exceptions)
+    bytes = alignUp(bytes, alignof(std::exception_ptr));
+    *excOffset = bytes;
+    bytes += size * sizeof(std::exception_ptr);
+#else
+    *excOffset = bytes;
+#endif // __cpp_exceptions
+    return bytes;
+  }
+
+  void initArrays(char* base, size_t headerBytes, size_t resultsOffset, size_t excOffset) {
+    statuses_ = reinterpret_cast<std::atomic<int>*>(
+        base + alignUp(headerBytes, alignof(std::atomic<int>)));
+    for (size_t i = 0; i < size_; ++i) {
+      new (statuses_ + i) std::atomic<int>(kNotStarted);
+    }
+    results_ = base + resultsOffset;
+#if defined(__cpp_exceptions)
+    exceptions_ = reinterpret_cast<std::exception_ptr*>(base + excOffset);
+    for (size_t i = 0; i < size_; ++i) {
+      new (exceptions_ + i) std::exception_ptr();
+    }
+#else
+    (void)excOffset;
+#endif // __cpp_exceptions
+  }
+
+  void destroyArrays() {
+    for (size_t i = 0; i < size_; ++i) {
+      // Elements may never have been run if the pool was destroyed without running the workers and
+      // nobody waited.
+      if (statuses_[i].load(std::memory_order_acquire) != kReady) {
+        continue;
+      }
+#if defined(__cpp_exceptions)
+      if (exceptions_[i]) {
+        continue;
+      }
+#endif // __cpp_exceptions
+      Storage::destroy(results_ + i * Storage::kElementSize);
+    }
+#if defined(__cpp_exceptions)
+    for (size_t i = 0; i < size_; ++i) {
+      exceptions_[i].~exception_ptr();
+    }
+#endif // __cpp_exceptions
+  }
+
+  alignas(kCacheLineSize) std::atomic<size_t> nextChunk_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> refCount_{1};
+  std::atomic<int> waiters_{0};
+  EpochWaiter epoch_;
+  size_t size_;
+  size_t chunkSize_;
+  size_t numChunks_;
+  std::atomic<int>* statuses_;
+  char* results_;
+#if defined(__cpp_exceptions)
+  std::exception_ptr* exceptions_;
+#endif // __cpp_exceptions
+};
+
+template <typename Result, typename F>
+class FutureArrayImpl : public FutureArrayImplBase<Result> {
+  using Base = FutureArrayImplBase<Result>;
+
+ public:
+  template <typename Func>
+  static FutureArrayImpl* create(size_t size, size_t chunkSize, Func&& f) {
+    size_t resultsOffset;
+    size_t excOffset;
+    size_t bytes = Base::layout(sizeof(FutureArrayImpl), size, &resultsOffset, &excOffset);
+    // Copy to avoid odr-use of the static constexpr member by std::max prior to C++17.
+    size_t elementAlign = Base::Storage::kElementAlign;
+    char* base = reinterpret_cast<char*>(
+        alignedMalloc(bytes, std::max<size_t>(alignof(FutureArrayImpl), elementAlign)));
+    auto* impl = new (base) FutureArrayImpl(size, chunkSize, std::forward<Func>(f));
+    impl->initArrays(base, sizeof(FutureArrayImpl), resultsOffset, excOffset);
+    return impl;
+  }
+
+ private:
+  template <typename Func>
+  FutureArrayImpl(size_t size, size_t chunkSize, Func&& f)
+      : Base(size, chunkSize), f_(std::forward<Func>(f)) {}
+
+  void runElement(char* buf, size_t index) override {
+    Base::Storage::run(buf, f_, index);
+  }
+
+  void destroy() override {
+    this->destroyArrays();
+    this->~FutureArrayImpl();
+    alignedFree(this);
+  }
+
+  F f_;
+};
+
+} // namespace detail
+} // namespace dispenso
@@ -12,6 +12,10 @@
 #include <dispenso/task_set.h>
 
 namespace dispenso {
+
+template <typename Result>
+class Future;
+
 namespace detail {
 
 template <typename Result>
@@ -23,12 +27,16 @@ class FutureImplResultMember {
       std::rethrow_exception(exception_);
     }
 #endif // __cpp_exceptions
+    assert(!canceled_ && "Cannot get the result of a canceled Future");
     return *reinterpret_cast<Result*>(resultBuf_);
   }
 
   ~FutureImplResultMember() {
-#if defined(__cpp_exceptions)
     // We don't want to call the destructor if we never set the result.
+    if (canceled_) {
+      return;
+    }
+#if defined(__cpp_exceptions)
     if (exception_) {
       return;
     }
@@ -56,11 +64,19 @@ class FutureImplResultMember {
     new (resultBuf_) Result(std::forward<T>(t));
   }
 
+  void setCanceled() {
+    canceled_ = true;
+#if defined(__cpp_exceptions)
+    exception_ = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+#endif // __cpp_exceptions
+  }
+
   alignas(Result) mutable char resultBuf_[sizeof(Result)];
 
 #if defined(__cpp_exceptions)
   std::exception_ptr exception_;
 #endif // __cpp_exceptions
+  bool canceled_{false};
 };
 
 template <typename Result>
@@ -85,6 +101,7 @@ class FutureImplResultMember<Result&> {
       std::rethrow_exception(exception_);
     }
 #endif // __cpp_exceptions
+    assert(!canceled_ && "Cannot get the result of a canceled Future");
     return *result_;
   }
 
@@ -92,11 +109,19 @@ class FutureImplResultMember<Result&> {
     result_ = res;
   }
 
+  void setCanceled() {
+    canceled_ = true;
+#if defined(__cpp_exceptions)
+    exception_ = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+#endif // __cpp_exceptions
+  }
+
   Result* result_;
 
 #if defined(__cpp_exceptions)
   std::exception_ptr exception_;
 #endif // __cpp_exceptions
+  bool canceled_{false};
 };
 
 template <>
@@ -120,12 +145,21 @@ class FutureImplResultMember<void> {
       std::rethrow_exception(exception_);
     }
 #endif // __cpp_exceptions
+    assert(!canceled_ && "Cannot get the result of a canceled Future");
   }
   void setAsResult() const {}
 
+  void setCanceled() {
+    canceled_ = true;
+#if defined(__cpp_exceptions)
+    exception_ = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+#endif // __cpp_exceptions
+  }
+
 #if defined(__cpp_exceptions)
   std::exception_ptr exception_;
 #endif // __cpp_exceptions
+  bool canceled_{false};
 };
 
 template <typename Result>
@@ -144,6 +178,28 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     return status_.intrusiveStatus().load(std::memory_order_acquire) == kReady;
   }
 
+  bool canceled() {
+    return ready() && this->canceled_;
+  }
+
+  bool cancel() {
+    int s = kNotStarted;
+    if (!status_.intrusiveStatus().compare_exchange_strong(
+            s, kRunning, std::memory_order_acq_rel)) {
+      return false;
+    }
+    // We own the functor now, just as run() would.  Destroy it without invoking it, and publish the
+    // canceled state as the result.
+    destroyFunc();
+    this->setCanceled();
+    status_.notify(kReady);
+    if (taskSetCounter_) {
+      taskSetCounter_->fetch_sub(1, std::memory_order_release);
+    }
+    tryExecuteThenChain();
+    return true;
+  }
+
   void run() override {
     (void)run(kNotStarted);
     decRefCountMaybeDestroy();
@@ -215,7 +271,7 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     return false;
   }
 
-  using ThenChainInvoke = void(void*, void*);
+  using ThenChainInvoke = void(void*, void*, bool);
 
   struct ThenChain {
     ThenChain* next;
@@ -223,9 +279,9 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     void* schedulable;
     ThenChainInvoke* invoke;
 
-    ThenChain* scheduleDestroyAndGetNext() {
-      invoke(impl, schedulable);
-      constexpr size_t kImplSize = nextPow2(sizeof(this));
+    ThenChain* scheduleDestroyAndGetNext(bool canceled) {
+      invoke(impl, schedulable, canceled);
+      constexpr size_t kImplSize = nextPow2(sizeof(ThenChain));
       auto* ret = this->next;
       deallocSmallBuffer<kImplSize>(this);
       return ret;
@@ -239,8 +295,9 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
       if (thenChain_.compare_exchange_weak(head, nullptr, std::memory_order_acq_rel)) {
         // Managed to exchange with head, value of thenChain_ now points to null chain.
         // Head points to the implicit list of items to be executed.
+        bool canceled = this->canceled_;
         while (head) {
-          head = head->scheduleDestroyAndGetNext();
+          head = head->scheduleDestroyAndGetNext(canceled);
         }
         // At this point, the list is exhausted, so we exit the outer loop too.  It would be valid
         // to get head again and try all over again, but it is guaranteed that if another link was
@@ -250,28 +307,36 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     }
   }
 
-  template <typename SomeFutureImpl, typename Schedulable>
-  static void thenChainInvokeAsync(void* implv, void* schedulablev) {
+  template <typename SomeFutureImpl, typename Schedulable, bool kAsync, bool kPropagateCancel>
+  static void thenChainInvoke(void* implv, void* schedulablev, bool canceled) {
     SomeFutureImpl* impl = reinterpret_cast<SomeFutureImpl*>(implv);
+    if (kPropagateCancel && canceled) {
+      // The dependent future was never scheduled, so release the reference that run() would have.
+      (void)impl->cancel();
+      impl->decRefCountMaybeDestroy();
+      return;
+    }
     Schedulable* schedulable = reinterpret_cast<Schedulable*>(schedulablev);
-    schedulable->schedule(OnceFunction(impl, true), ForceQueuingTag());
+    if (kAsync) {
+      schedulable->schedule(OnceFunction(impl, true), ForceQueuingTag());
+    } else {
+      schedulable->schedule(OnceFunction(impl, true));
+    }
   }
 
-  template <typename SomeFutureImpl, typename Schedulable>
-  static void thenChainInvoke(void* implv, void* schedulablev) {
-    SomeFutureImpl* impl = reinterpret_cast<SomeFutureImpl*>(implv);
-    Schedulable* schedulable = reinterpret_cast<Schedulable*>(schedulablev);
-    schedulable->schedule(OnceFunction(impl, true));
+  template <typename SomeFutureImpl, typename Schedulable, bool kPropagateCancel>
+  static ThenChainInvoke* thenChainInvoker(std::launch asyncPolicy) {
+    if ((asyncPolicy & std::launch::async) == std::launch::async) {
+      return thenChainInvoke<SomeFutureImpl, Schedulable, true, kPropagateCancel>;
+    }
+    return thenChainInvoke<SomeFutureImpl, Schedulable, false, kPropagateCancel>;
   }
 
-  template <typename SomeFutureImpl, typename Schedulable>
+  template <bool kPropagateCancel, typename SomeFutureImpl, typename Schedulable>
   void addToThenChainOrExecute(SomeFutureImpl* impl, Schedulable& sched, std::launch asyncPolicy) {
     if (status_.intrusiveStatus().load(std::memory_order_acquire) == kReady) {
-      if ((asyncPolicy & std::launch::async) == std::launch::async) {
-        sched.schedule(OnceFunction(impl, true), ForceQueuingTag());
-      } else {
-        sched.schedule(OnceFunction(impl, true));
-      }
+      thenChainInvoker<SomeFutureImpl, Schedulable, kPropagateCancel>(asyncPolicy)(
+          impl, const_cast<std::remove_const_t<Schedulable>*>(&sched), this->canceled_);
       return;
     }
 
@@ -282,11 +347,7 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
     using NonConstSchedulable = std::remove_const_t<Schedulable>;
     NonConstSchedulable* nonConstSched = const_cast<NonConstSchedulable*>(&sched);
     link->schedulable = nonConstSched;
-    if ((asyncPolicy & std::launch::async) == std::launch::async) {
-      link->invoke = thenChainInvokeAsync<SomeFutureImpl, Schedulable>;
-    } else {
-      link->invoke = thenChainInvoke<SomeFutureImpl, Schedulable>;
-    }
+    link->invoke = thenChainInvoker<SomeFutureImpl, Schedulable, kPropagateCancel>(asyncPolicy);
     link->next = thenChain_.load(std::memory_order_acquire);
     while (!thenChain_.compare_exchange_weak(link->next, link, std::memory_order_acq_rel)) {
     }
@@ -306,6 +367,8 @@ class FutureImplBase : private FutureImplResultMember<Result>, public OnceCallab
 
   virtual void runFunc() = 0;
 
+  virtual void destroyFunc() = 0;
+
   virtual void dealloc() = 0;
 
   ~FutureImplBase() override = default;
@@ -340,6 +403,9 @@ class FutureImplSmall : public FutureImplBase<Result> {
     this->runToResult(*f);
     f->~F();
   }
+  void destroyFunc() override {
+    reinterpret_cast<F*>(func_)->~F();
+  }
   void dealloc() override {
     this->~FutureImplSmall();
     deallocSmallBuffer<kBufferSize>(this);
@@ -355,6 +421,7 @@ template <size_t kBufferSize, typename Result>
 class FutureImplSmall<kBufferSize, void, Result> : public FutureImplBase<Result> {
  protected:
   void runFunc() override {}
+  void destroyFunc() override {}
   void dealloc() override {
     this->~FutureImplSmall();
     deallocSmallBuffer<kBufferSize>(this);
@@ -376,6 +443,9 @@ class FutureImplAlloc : public FutureImplBase<Result> {
     this->runToResult(*f);
     f->~F();
   }
+  void destroyFunc() override {
+    reinterpret_cast<F*>(func_)->~F();
+  }
   void dealloc() override {
     this->~FutureImplAlloc();
     alignedFree(this);
@@ -563,11 +633,24 @@ class FutureBase {
     assertValid();
     return impl_->waitUntil(timeoutTime);
   }
+  bool cancel() {
+    assertValid();
+    return impl_->cancel();
+  }
+  bool is_canceled() const {
+    assertValid();
+    return impl_->canceled();
+  }
 
   template <typename RetResult, typename F, typename Schedulable>
   FutureImplBase<RetResult>*
   thenImpl(F&& f, Schedulable& sched, std::launch asyncPolicy, std::launch deferredPolicy);
 
+  // Invoke f(Future<Result>&&) inline as soon as this future is ready, even if it was canceled.
+  // This is for internal consumers (e.g. when_all) that must observe completion of every input.
+  template <typename F>
+  void whenReadyIgnoringCancel(F&& f);
+
   template <typename RetResult, typename F>
   FutureImplBase<RetResult>*
   thenImpl(F&& f, TaskSet& sched, std::launch asyncPolicy, std::launch deferredPolicy);
@@ -584,9 +667,18 @@ class FutureBase {
 #endif // DISPENSO_DEBUG
 
   mutable FutureImplBase<Result>* impl_;
+
+  friend struct FutureAccess;
 };
 
 struct ReadyTag {};
 
+struct FutureAccess {
+  template <typename Result, typename F>
+  static void whenReadyIgnoringCancel(Future<Result>& future, F&& f) {
+    static_cast<FutureBase<Result>&>(future).whenReadyIgnoringCancel(std::forward<F>(f));
+  }
+};
+
 } // namespace detail
 } // namespace dispenso
@@ -37,7 +37,7 @@ FutureImplBase<RetResult>* FutureBase<Result>::thenImpl(
 
   auto* retImpl = createFutureImpl<RetResult>(
       std::move(func), (deferredPolicy & std::launch::deferred) == std::launch::deferred, nullptr);
-  impl_->addToThenChainOrExecute(retImpl, sched, asyncPolicy);
+  impl_->template addToThenChainOrExecute<true>(retImpl, sched, asyncPolicy);
   return retImpl;
 }
 
@@ -59,7 +59,7 @@ FutureImplBase<RetResult>* FutureBase<Result>::thenImpl(
       std::move(func),
       (deferredPolicy & std::launch::deferred) == std::launch::deferred,
       &sched.outstandingTaskCount_);
-  impl_->addToThenChainOrExecute(retImpl, sched.pool(), asyncPolicy);
+  impl_->template addToThenChainOrExecute<true>(retImpl, sched.pool(), asyncPolicy);
   return retImpl;
 }
 
@@ -81,10 +81,25 @@ FutureImplBase<RetResult>* FutureBase<Result>::thenImpl(
       std::move(func),
       (deferredPolicy & std::launch::deferred) == std::launch::deferred,
       &sched.outstandingTaskCount_);
-  impl_->addToThenChainOrExecute(retImpl, sched.pool(), asyncPolicy);
+  impl_->template addToThenChainOrExecute<true>(retImpl, sched.pool(), asyncPolicy);
   return retImpl;
 }
 
+template <typename Result>
+template <typename F>
+void FutureBase<Result>::whenReadyIgnoringCancel(F&& f) {
+  Future<Result> copy(*this);
+  auto func = [f = std::move(f), copy = std::move(copy)]() mutable {
+    copy.wait();
+    f(std::move(copy));
+  };
+
+  auto* retImpl = createFutureImpl<void>(std::move(func), true, nullptr);
+  impl_->template addToThenChainOrExecute<false>(retImpl, kImmediateInvoker, kNotAsync);
+  // Nobody holds a Future to the result, so release that reference immediately.
+  retImpl->decRefCountMaybeDestroy();
+}
+
 template <size_t index, typename... Ts>
 struct ForEachApply {
   template <typename F>
@@ -167,13 +182,11 @@ auto whenAllTuple(Invoker& invoker, Futures&&... futures)
   // Avoid sequencing issue by getting the reference prior to the std::move.
   auto& tuple = shared->tuple;
   forEach(tuple, [shared = std::move(shared)](auto& future) {
-    future.then(
-        [shared](auto&&) {
-          if (shared->count.fetch_sub(1, std::memory_order_release) == 1) {
-            shared->f();
-          }
-        },
-        kImmediateInvoker);
+    FutureAccess::whenReadyIgnoringCancel(future, [shared](auto&&) {
+      if (shared->count.fetch_sub(1, std::memory_order_release) == 1) {
+        shared->f();
+      }
+    });
     return true;
   });
 
@@ -207,13 +220,11 @@ whenAllIterators(Invoker& invoker, InputIt first, InputIt last) {
 
   shared->f = std::move(invoker.savedOffFn);
   for (auto& s : shared->vec) {
-    s.then(
-        [shared](auto&&) {
-          if (shared->count.fetch_sub(1, std::memory_order_release) == 1) {
-            shared->f();
-          }
-        },
-        kImmediateInvoker);
+    FutureAccess::whenReadyIgnoringCancel(s, [shared](auto&&) {
+      if (shared->count.fetch_sub(1, std::memory_order_release) == 1) {
+        shared->f();
+      }
+    });
   }
 
   return res;
@@ -5,6 +5,9 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cstddef>
+#include <type_traits>
+
 #include <dispenso/detail/math.h>
 #include <dispenso/small_buffer_allocator.h>
 
@@ -38,6 +41,24 @@ class OnceCallableImpl : public OnceCallable {
   F f_;
 };
 
+constexpr size_t kOnceCallableInlineSize = 48;
+constexpr size_t kOnceCallableInlineAlignment = alignof(std::max_align_t);
+
+// Whether F may be held directly in a OnceFunction's inline storage.  Only trivially copyable
+// functors are held inline, so that moving a OnceFunction is a plain copy of its bytes, and so that
+// nothing need be destroyed after the call.
+template <typename F>
+struct OnceCallableFitsInline
+    : std::integral_constant<
+          bool,
+          sizeof(F) <= kOnceCallableInlineSize && alignof(F) <= kOnceCallableInlineAlignment &&
+              std::is_trivially_copyable<F>::value> {};
+
+template <typename F>
+void runInlineOnceCallable(void* storage) {
+  (*static_cast<F*>(storage))();
+}
+
 template <typename F>
 inline OnceCallable* createOnceCallable(F&& f) {
   using FNoRef = typename std::remove_reference<F>::type;
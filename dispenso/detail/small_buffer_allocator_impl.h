@@ -7,31 +7,148 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
+#include <dispenso/backing_store.h>
 #include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
+#include <dispenso/small_buffer_allocator.h>
 #include <dispenso/tsan_annotations.h>
 
 #include <concurrentqueue.h>
 
+// Sizing of the small buffer pools.  Each pool grows by slabs of
+// DISPENSO_SMALL_BUFFER_SLAB_BYTES_PER_LOG2 * log2(chunk size) bytes, and each thread caches about
+// 1/DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR of a slab.  DISPENSO_SMALL_BUFFER_SMALL_FOOTPRINT selects
+// smaller defaults, for memory-constrained deployments.
+#if defined(DISPENSO_SMALL_BUFFER_SMALL_FOOTPRINT)
+#if !defined(DISPENSO_SMALL_BUFFER_SLAB_BYTES_PER_LOG2)
+#define DISPENSO_SMALL_BUFFER_SLAB_BYTES_PER_LOG2 1024
+#endif
+#if !defined(DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR)
+#define DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR 8
+#endif
+#else
+#if !defined(DISPENSO_SMALL_BUFFER_SLAB_BYTES_PER_LOG2)
+#define DISPENSO_SMALL_BUFFER_SLAB_BYTES_PER_LOG2 4096
+#endif
+#if !defined(DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR)
+#define DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR 4
+#endif
+#endif // DISPENSO_SMALL_BUFFER_SMALL_FOOTPRINT
+
+// Placement of the small buffer pools' slabs.  DISPENSO_SMALL_BUFFER_HUGE_PAGES backs slabs with
+// transparent huge pages, growing each slab to at least one huge page.
+// DISPENSO_SMALL_BUFFER_NUMA_LOCAL places each slab on the NUMA node of the thread that allocated
+// it, and keeps a separate central store per node, for up to DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES
+// nodes.  Each thread uses the store of the node it first allocated or deallocated on.  Buffers freed
+// on a node other than their slab's are cached in the freeing node's store, because finding a
+// buffer's slab on every spill would slow the deallocation path; trim() sends each free buffer back
+// to the store that owns its slab.
+#if defined(DISPENSO_SMALL_BUFFER_NUMA_LOCAL)
+#if !defined(DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES)
+#define DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES 8
+#endif
+#else
+#undef DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES
+#define DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES 1
+#endif // DISPENSO_SMALL_BUFFER_NUMA_LOCAL
+
 namespace dispenso {
 namespace detail {
 
+constexpr size_t kSmallBufferStores = DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES;
+
+inline BackingStoreOptions smallBufferBacking() {
+  BackingStoreOptions options;
+#if defined(DISPENSO_SMALL_BUFFER_HUGE_PAGES)
+  options.hugePages = true;
+#endif // DISPENSO_SMALL_BUFFER_HUGE_PAGES
+#if defined(DISPENSO_SMALL_BUFFER_NUMA_LOCAL)
+  options.numaLocal = true;
+#endif // DISPENSO_SMALL_BUFFER_NUMA_LOCAL
+  return options;
+}
+
+// The central store used by the calling thread.
+inline size_t smallBufferStore() {
+#if DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES > 1
+  constexpr size_t kUnset = ~size_t{0};
+  static DISPENSO_THREAD_LOCAL size_t store = kUnset;
+  if (store == kUnset) {
+    store = currentNumaNode() % kSmallBufferStores;
+  }
+  return store;
+#else
+  return 0;
+#endif // DISPENSO_SMALL_BUFFER_MAX_NUMA_NODES
+}
+
+/**
+ * Sizing parameters for the pool of <code>kChunkSize</code> buffers.  This may be specialized to
+ * tune individual size classes; as the pools are instantiated within the dispenso library, this
+ * must be done when building the library.
+ **/
+template <size_t kChunkSize>
+struct SmallBufferTraits {
+  // The number of bytes allocated from the system each time the pool grows.
+  static constexpr size_t kMallocBytes =
+      DISPENSO_SMALL_BUFFER_SLAB_BYTES_PER_LOG2 * log2const(kChunkSize | 1);
+  // The number of bytes of buffers each thread aims to keep cached.
+  static constexpr size_t kTLCacheBytes = kMallocBytes / DISPENSO_SMALL_BUFFER_TL_CACHE_DIVISOR;
+};
+
 struct SmallBufferGlobals {
+  explicit SmallBufferGlobals(size_t slabBytes) : slabBytes(slabBytes) {}
+
   moodycamel::ConcurrentQueue<char*> centralStore;
   std::vector<char*> backingStore;
   std::atomic<uint32_t> backingStoreLock{0};
+  const size_t slabBytes;
+
+  // Batch transfers between thread caches and the central store, for statistics.
+  alignas(kCacheLineSize) std::atomic<uint64_t> refills{0};
+  std::atomic<uint64_t> spills{0};
+
+  // The number of slabs held across all stores of the size class, and the most held at once.  Stores
+  // grow at different times, so these are kept only in store 0's globals rather than summed.
+  std::atomic<size_t> totalSlabs{0};
+  std::atomic<size_t> peakSlabs{0};
+
+  // The buffer counts of the thread caches using this store, guarded by threadCachesLock.
+  std::vector<const size_t*> threadCaches;
+  std::atomic<uint32_t> threadCachesLock{0};
+
+  void registerThreadCache(const size_t* count) {
+    lockThreadCaches();
+    threadCaches.push_back(count);
+    threadCachesLock.store(0, std::memory_order_release);
+  }
+
+  void unregisterThreadCache(const size_t* count) {
+    lockThreadCaches();
+    threadCaches.erase(std::find(threadCaches.begin(), threadCaches.end(), count));
+    threadCachesLock.store(0, std::memory_order_release);
+  }
+
+  void lockThreadCaches() {
+    uint32_t expected = 0;
+    while (!threadCachesLock.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+      expected = 0;
+      std::this_thread::yield();
+    }
+  }
 
   ~SmallBufferGlobals() {
     for (char* b : backingStore) {
-      alignedFree(b);
+      backingStoreFree(b, slabBytes, smallBufferBacking());
     }
   }
 };
 
 template <size_t kChunkSize>
-DISPENSO_DLL_ACCESS SmallBufferGlobals& getSmallBufferGlobals();
+DISPENSO_DLL_ACCESS SmallBufferGlobals& getSmallBufferGlobals(size_t store);
 
 /**
  * A class for allocating small chunks of memory quickly.  The class is built on concepts of
@@ -44,21 +161,32 @@ DISPENSO_DLL_ACCESS SmallBufferGlobals& getSmallBufferGlobals();
 template <size_t kChunkSize>
 class SmallBufferAllocator {
  private:
-  static constexpr size_t kLogFactor = log2const(kChunkSize | 1);
-
-  // TODO(T88183021): Make these factors compile-time configurable.  For example, the current values
-  // can lead to megabytes of data being allocated, even if the alloctor is only used for one or two
-  // allocations.  Likely we can reduce these sizes by a decent factor without affecting benchmarks,
-  // and then reduce them even further as an option.
-  static constexpr size_t kMallocBytes = (1 << 12) * kLogFactor;
-  static constexpr size_t kIdealTLCacheBytes = kMallocBytes / 4;
-  static constexpr size_t kIdealNumTLBuffers = kIdealTLCacheBytes / kChunkSize;
+  using Traits = SmallBufferTraits<kChunkSize>;
+
+  // Slabs always hold at least a few buffers, so that large chunk sizes still amortize growth.
+#if defined(DISPENSO_SMALL_BUFFER_HUGE_PAGES)
+  static constexpr size_t kMallocBytes =
+      std::max(std::max(Traits::kMallocBytes, 4 * kChunkSize), kHugePageSize);
+#else
+  static constexpr size_t kMallocBytes = std::max(Traits::kMallocBytes, 4 * kChunkSize);
+#endif // DISPENSO_SMALL_BUFFER_HUGE_PAGES
+  static constexpr size_t kIdealNumTLBuffers =
+      std::max<size_t>(Traits::kTLCacheBytes / kChunkSize, 1);
   static constexpr size_t kMaxNumTLBuffers = 2 * kIdealNumTLBuffers;
   static constexpr size_t kBuffersPerMalloc = kMallocBytes / kChunkSize;
 
-  static_assert(kIdealNumTLBuffers > 0, "Must have a positive number of buffers to work with");
+  static_assert(
+      kBuffersPerMalloc > kIdealNumTLBuffers,
+      "Each slab must hold more buffers than a thread grabs at once");
 
  public:
+  /**
+   * The size of the slabs the pool grows by.
+   **/
+  static constexpr size_t slabBytes() {
+    return kMallocBytes;
+  }
+
   /**
    * Allocate a buffer of <code>kChunkSize</code> bytes.
    *
@@ -105,28 +233,49 @@ class SmallBufferAllocator {
    * @return The approximate number of bytes currently allocated.
    **/
   static size_t bytesAllocated() {
-    uint32_t allocId = 0;
-    auto& globals = getSmallBufferGlobals<kChunkSize>();
-    auto& lock = globals.backingStoreLock;
-    while (!lock.compare_exchange_weak(allocId, 1, std::memory_order_acquire)) {
+    size_t bytes = 0;
+    for (size_t store = 0; store < kSmallBufferStores; ++store) {
+      uint32_t allocId = 0;
+      auto& globals = getSmallBufferGlobals<kChunkSize>(store);
+      auto& lock = globals.backingStoreLock;
+      while (!lock.compare_exchange_weak(allocId, 1, std::memory_order_acquire)) {
+      }
+      bytes += kMallocBytes * globals.backingStore.size();
+      lock.store(0, std::memory_order_release);
     }
-    size_t bytes = kMallocBytes * globals.backingStore.size();
-    lock.store(0, std::memory_order_release);
     return bytes;
   }
 
+  /**
+   * Release slabs whose buffers are all free back to the system.  The calling thread's cached
+   * buffers are returned to the central store first, but buffers cached by other threads keep their
+   * slabs alive.  Free buffers in the remaining slabs are returned to the central store owning their
+   * slab.  This locks the backing store for the duration, and allocations that need to grow
+   * the backing store wait meanwhile, so it is intended to be called occasionally, e.g. after a
+   * burst of allocations has been freed.
+   *
+   * @return The number of bytes released.
+   **/
+  static size_t trim();
+
+  /**
+   * Get statistics for this pool.  Locks briefly, and reads thread caches without synchronizing
+   * with their owners, so counts are approximate while other threads allocate.
+   **/
+  static SmallBufferStats stats();
+
  private:
   struct PerThreadQueuingData {
-    PerThreadQueuingData(
-        moodycamel::ConcurrentQueue<char*>& cstore,
-        std::tuple<char**, size_t&> buffersAndCount)
-        : cstore_(cstore),
+    PerThreadQueuingData(SmallBufferGlobals& globals, std::tuple<char**, size_t&> buffersAndCount)
+        : globals_(globals),
+          cstore_(globals.centralStore),
           buffers_(std::get<0>(buffersAndCount)),
           count_(std::get<1>(buffersAndCount)) {
       DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
-      new (ptokenBuf_) moodycamel::ProducerToken(cstore);
-      new (ctokenBuf_) moodycamel::ConsumerToken(cstore);
+      new (ptokenBuf_) moodycamel::ProducerToken(cstore_);
+      new (ctokenBuf_) moodycamel::ConsumerToken(cstore_);
       DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+      globals_.registerThreadCache(&count_);
     }
 
     ~PerThreadQueuingData();
@@ -144,6 +293,10 @@ class SmallBufferAllocator {
       return actual;
     }
 
+    SmallBufferGlobals& globals() {
+      return globals_;
+    }
+
    private:
     moodycamel::ProducerToken& ptoken() {
       return *reinterpret_cast<moodycamel::ProducerToken*>(ptokenBuf_);
@@ -152,6 +305,7 @@ class SmallBufferAllocator {
       return *reinterpret_cast<moodycamel::ConsumerToken*>(ctokenBuf_);
     }
 
+    SmallBufferGlobals& globals_;
     moodycamel::ConcurrentQueue<char*>& cstore_;
     alignas(moodycamel::ProducerToken) char ptokenBuf_[sizeof(moodycamel::ProducerToken)];
     alignas(moodycamel::ConsumerToken) char ctokenBuf_[sizeof(moodycamel::ConsumerToken)];
@@ -170,25 +324,40 @@ class SmallBufferAllocator {
 
   static size_t grabFromCentralStore(char** buffers) {
     auto& queue = getThreadQueuingData();
-    auto& globals = getSmallBufferGlobals<kChunkSize>();
+    auto& globals = getSmallBufferGlobals<kChunkSize>(smallBufferStore());
     auto& lock = globals.backingStoreLock;
     auto& backingStore = globals.backingStore;
     while (true) {
       size_t grabbed = queue.try_dequeue_bulk(buffers, kIdealNumTLBuffers);
       if (grabbed) {
+        globals.refills.fetch_add(1, std::memory_order_relaxed);
         return grabbed;
       }
       uint32_t allocId = lock.fetch_add(1, std::memory_order_acquire);
       if (allocId == 0) {
-        char* buffer = reinterpret_cast<char*>(detail::alignedMalloc(kMallocBytes, kChunkSize));
+        char* buffer = reinterpret_cast<char*>(
+            backingStoreAlloc(kMallocBytes, kChunkSize, smallBufferBacking()));
         backingStore.push_back(buffer);
+        auto& root = getSmallBufferGlobals<kChunkSize>(0);
+        size_t total = root.totalSlabs.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = root.peakSlabs.load(std::memory_order_relaxed);
+        while (peak < total &&
+               !root.peakSlabs.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+        }
+        globals.refills.fetch_add(1, std::memory_order_relaxed);
 
+        // Push in bounded batches, as huge page slabs may hold very many buffers.
         constexpr size_t kNumToPush = kBuffersPerMalloc - kIdealNumTLBuffers;
-        char* topush[kNumToPush];
-        for (size_t i = 0; i < kNumToPush; ++i, buffer += kChunkSize) {
-          topush[i] = buffer;
+        constexpr size_t kPushBatch = std::min<size_t>(kNumToPush, 2048);
+        char* topush[kPushBatch];
+        for (size_t pushed = 0; pushed < kNumToPush;) {
+          size_t batch = std::min(kPushBatch, kNumToPush - pushed);
+          for (size_t i = 0; i < batch; ++i, buffer += kChunkSize) {
+            topush[i] = buffer;
+          }
+          queue.enqueue_bulk(topush, batch);
+          pushed += batch;
         }
-        queue.enqueue_bulk(topush, kNumToPush);
         lock.store(0, std::memory_order_release);
         for (size_t i = 0; i < kIdealNumTLBuffers; ++i, buffer += kChunkSize) {
           buffers[i] = buffer;
@@ -203,9 +372,10 @@ class SmallBufferAllocator {
   }
 
   static void recycleToCentralStore(char** buffers, size_t numToRecycle) {
-    getThreadQueuingData().enqueue_bulk(buffers, numToRecycle);
-    // TODO(bbudge): consider whether we need to do any garbage collection and return memory to
-    // the system.
+    // Memory is only returned to the system on demand, via trim(), to keep this path cheap.
+    auto& queue = getThreadQueuingData();
+    queue.enqueue_bulk(buffers, numToRecycle);
+    queue.globals().spills.fetch_add(1, std::memory_order_relaxed);
   }
 
  private:
@@ -216,7 +386,7 @@ class SmallBufferAllocator {
   };
   DISPENSO_DLL_ACCESS static PerThreadQueuingData& getThreadQueuingData() {
     static thread_local PerThreadQueuingData data(
-        getSmallBufferGlobals<kChunkSize>().centralStore, buffersAndCount());
+        getSmallBufferGlobals<kChunkSize>(smallBufferStore()), buffersAndCount());
     return data;
   }
 };
@@ -17,6 +17,7 @@
 
 namespace dispenso {
 
+class ScratchArena;
 class TaskSetBase;
 
 namespace detail {
@@ -24,6 +25,9 @@ template <typename Result>
 class FutureBase;
 
 class LimitGatedScheduler;
+struct TaskSetScratch;
+
+DISPENSO_DLL_ACCESS ScratchArena* taskSetScratchArena(TaskSetBase* tasks);
 
 DISPENSO_DLL_ACCESS void pushThreadTaskSet(TaskSetBase* tasks);
 DISPENSO_DLL_ACCESS void popThreadTaskSet();
@@ -82,6 +86,9 @@ class TaskSetBase {
     if (parent_) {
       parent_->unregisterChild(this);
     }
+    if (scratch_.load(std::memory_order_relaxed)) {
+      destroyScratch();
+    }
   }
 
  protected:
@@ -106,6 +113,30 @@ class TaskSetBase {
     };
   }
 
+  // Release everything allocated from this set's scratch arenas.  Must only be called while no tasks
+  // are outstanding.
+  void releaseScratch() {
+    if (scratch_.load(std::memory_order_acquire)) {
+      releaseScratchImpl();
+    }
+  }
+  DISPENSO_DLL_ACCESS void releaseScratchImpl();
+  DISPENSO_DLL_ACCESS void destroyScratch();
+
+  // Run a task immediately on the scheduling thread, as a task of this set, so that e.g.
+  // parentTaskSet() and scratchArena() see this set.
+  template <typename F>
+  void runInline(F& f) {
+    struct PopOnExit {
+      ~PopOnExit() {
+        detail::popThreadTaskSet();
+      }
+    };
+    detail::pushThreadTaskSet(this);
+    PopOnExit pop;
+    f();
+  }
+
   DISPENSO_DLL_ACCESS void trySetCurrentException();
   bool testAndResetException();
 
@@ -171,6 +202,11 @@ class TaskSetBase {
   // prev_ and next_ are links in our *parent's* intrusive linked list.
   TaskSetBase* prev_;
   TaskSetBase* next_;
+
+  // Per-thread scratch arenas for this set's tasks, created on first use by scratchArena().
+  std::atomic<detail::TaskSetScratch*> scratch_{nullptr};
+
+  friend ScratchArena* detail::taskSetScratchArena(TaskSetBase* tasks);
 };
 
 } // namespace dispenso
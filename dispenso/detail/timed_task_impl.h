@@ -5,50 +5,207 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
+#include <limits>
+#include <memory>
+
+#include <dispenso/latency_histogram.h>
+#include <dispenso/once_function.h>
 #include <dispenso/thread_pool.h>
+#include <dispenso/timing.h>
 
 namespace dispenso {
+
+class TimedTaskScheduler;
+
 namespace detail {
 
-enum FunctionFlags : uint32_t { kFFlagsNone = 0, kFFlagsDetached = 1, kFFlagsCancelled = 2 };
+// Latency histograms for timed task firings, all measured from the time a run was scheduled for.
+struct TimedTaskLatency {
+  // Until the scheduler thread handed the run to the backing schedulable.
+  LatencyHistogram dispatch;
+  // Until the functor began executing.
+  LatencyHistogram start;
+};
+
+enum FunctionFlags : uint32_t {
+  kFFlagsNone = 0,
+  kFFlagsDetached = 1,
+  kFFlagsCancelled = 2,
+  kFFlagsFuncDestroyed = 4
+};
 
-struct TimedTaskImpl {
+// The shared state of a timed task.  This is intrusively reference counted: the TimedTask handle,
+// the scheduler's queue, and each dispatched run hold one reference apiece.  Each run is handed to
+// the backing schedulable as a OnceFunction wrapping this object directly, so firing a task
+// requires no allocation.
+class TimedTaskImpl : public OnceCallable {
+ public:
   alignas(kCacheLineSize) std::atomic<size_t> count{0};
   std::atomic<size_t> timesToRun;
   std::atomic<uint32_t> flags{kFFlagsNone};
   std::atomic<uint32_t> inProgress{0};
   double nextAbsTime;
   double period;
+  // How far past nextAbsTime the task may be run, to allow coalescing with other tasks.
+  double slack{0.0};
   bool steady;
-  std::function<void(std::shared_ptr<TimedTaskImpl>)> func;
-
-  template <typename F, typename Schedulable>
-  TimedTaskImpl(size_t times, double next, double per, F&& f, Schedulable& sched, bool stdy)
-      : timesToRun(times), nextAbsTime(next), period(per), steady(stdy) {
-    func = [&sched, f = std::move(f), this](std::shared_ptr<TimedTaskImpl> me) {
-      if (flags.load(std::memory_order_acquire) & kFFlagsCancelled) {
-        return;
+  // Whether the scheduler should spin as nextAbsTime approaches, even when it otherwise waits
+  // precisely.
+  bool spin{false};
+  // Skip runs that come due while a previous run is still in progress.
+  bool noOverlap{false};
+  // For steady tasks, the most missed periods to run back-to-back when behind.
+  size_t maxCatchUp{std::numeric_limits<size_t>::max()};
+  // The scheduler this task was scheduled on, cleared once the scheduler no longer holds the task.
+  std::atomic<TimedTaskScheduler*> scheduler{nullptr};
+  // Position within the scheduler's queue, guarded by the scheduler's queue mutex.  queueSlot is
+  // negative while the task is not held in the queue.
+  int32_t queueSlot{-1};
+  uint32_t queuePos{0};
+  // Latency recording, each enabled when non-null.  The scheduler's histograms are shared so that
+  // runs still in flight may record into them after the scheduler is destroyed.
+  std::shared_ptr<TimedTaskLatency> schedulerLatency;
+  std::unique_ptr<TimedTaskLatency> latency;
+  // The time the most recently fired run was scheduled for.  When runs of a task overlap, a run
+  // may measure its start latency from a later run's scheduled time.
+  std::atomic<double> firedFor{0.0};
+
+  // The latest time at which the task should be run.
+  double latestTime() const {
+    return nextAbsTime + slack;
+  }
+
+  void acquire() {
+    refCount_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release() {
+    if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      destroyFunc();
+      dealloc();
+    }
+  }
+
+  // Dispatch one run of the functor to the backing schedulable, unless the task is cancelled.
+  void fire() {
+    // Count the run as in progress before checking for cancellation, so that a TimedTask being
+    // destroyed either prevents the run, or waits for it.
+    inProgress.fetch_add(1, std::memory_order_seq_cst);
+    if (flags.load(std::memory_order_seq_cst) & kFFlagsCancelled) {
+      inProgress.fetch_sub(1, std::memory_order_release);
+      return;
+    }
+    firedFor.store(nextAbsTime, std::memory_order_relaxed);
+    acquire();
+    dispatch();
+  }
+
+  void recordDispatch(double lateness) {
+    if (schedulerLatency) {
+      schedulerLatency->dispatch.record(lateness);
+    }
+    if (latency) {
+      latency->dispatch.record(lateness);
+    }
+  }
+
+  // Destroy the functor if that hasn't already happened.  Must not race with a run of the functor.
+  void destroyFunc() {
+    if (!(flags.fetch_or(kFFlagsFuncDestroyed, std::memory_order_acq_rel) &
+          kFFlagsFuncDestroyed)) {
+      destroyFuncImpl();
+    }
+  }
+
+  void run() override {
+    if (!(flags.load(std::memory_order_acquire) & kFFlagsCancelled)) {
+      if (schedulerLatency || latency) {
+        recordStart();
+      }
+      if (!invoke()) {
+        timesToRun.store(0, std::memory_order_release);
+        flags.fetch_or(kFFlagsCancelled, std::memory_order_acq_rel);
+        destroyFunc();
       }
+      count.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    inProgress.fetch_sub(1, std::memory_order_release);
+    release();
+  }
+
+ protected:
+  TimedTaskImpl(size_t times, double next, double per, bool stdy)
+      : timesToRun(times), nextAbsTime(next), period(per), steady(stdy) {}
 
-      inProgress.fetch_add(1, std::memory_order_acq_rel);
+  ~TimedTaskImpl() override = default;
 
-      auto wrap = [&f, this, me = std::move(me)]() mutable {
-        if (!(flags.load(std::memory_order_acquire) & kFFlagsCancelled)) {
-          if (!f()) {
-            timesToRun.store(0, std::memory_order_release);
-            flags.fetch_or(kFFlagsCancelled, std::memory_order_acq_rel);
-            func = {};
-          }
-          count.fetch_add(1, std::memory_order_acq_rel);
-        }
+  virtual bool invoke() = 0;
+  virtual void dispatch() = 0;
+  virtual void destroyFuncImpl() = 0;
+  virtual void dealloc() = 0;
 
-        inProgress.fetch_sub(1, std::memory_order_release);
-        me.reset();
-      };
-      sched.schedule(wrap, ForceQueuingTag());
-    };
+  OnceFunction asOnceFunction() {
+    return OnceFunction(this, true);
   }
+
+  void recordStart() {
+    double lateness = getTime() - firedFor.load(std::memory_order_relaxed);
+    if (schedulerLatency) {
+      schedulerLatency->start.record(lateness);
+    }
+    if (latency) {
+      latency->start.record(lateness);
+    }
+  }
+
+ private:
+  std::atomic<uint32_t> refCount_{1};
 };
 
+template <size_t kBufferSize, typename F, typename Schedulable>
+class TimedTaskImplSmall : public TimedTaskImpl {
+ public:
+  template <typename G>
+  TimedTaskImplSmall(Schedulable& sched, G&& f, size_t times, double next, double per, bool stdy)
+      : TimedTaskImpl(times, next, per, stdy), sched_(sched) {
+    new (func_) F(std::forward<G>(f));
+  }
+
+ protected:
+  bool invoke() override {
+    return (*reinterpret_cast<F*>(func_))();
+  }
+  void dispatch() override {
+    sched_.schedule(asOnceFunction(), ForceQueuingTag());
+  }
+  void destroyFuncImpl() override {
+    reinterpret_cast<F*>(func_)->~F();
+  }
+  void dealloc() override {
+    this->~TimedTaskImplSmall();
+    deallocSmallBuffer<kBufferSize>(this);
+  }
+
+  ~TimedTaskImplSmall() override {}
+
+ private:
+  Schedulable& sched_;
+  alignas(F) char func_[sizeof(F)];
+};
+
+// Create a task holding a single reference, owned by the caller.
+template <typename Schedulable, typename F>
+inline TimedTaskImpl*
+createTimedTaskImpl(Schedulable& sched, F&& f, size_t times, double next, double per, bool stdy) {
+  using FNoRef = typename std::remove_reference<F>::type;
+  constexpr size_t kImplSize = nextPow2(sizeof(TimedTaskImplSmall<16, FNoRef, Schedulable>));
+  using SmallT = TimedTaskImplSmall<kImplSize, FNoRef, Schedulable>;
+  return new (allocSmallBuffer<kImplSize>())
+      SmallT(sched, std::forward<F>(f), times, next, per, stdy);
+}
+
 } // namespace detail
 } // namespace dispenso
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/detail/timed_task_queue.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <dispenso/detail/math.h>
+
+namespace dispenso {
+namespace detail {
+
+void TimedTaskHeap::siftUp(uint32_t pos) {
+  TimedTaskPtr task = tasks_[pos];
+  while (pos > 0) {
+    uint32_t parent = (pos - 1) / 2;
+    if (!before(task, tasks_[parent])) {
+      break;
+    }
+    place(pos, tasks_[parent]);
+    pos = parent;
+  }
+  place(pos, task);
+}
+
+void TimedTaskHeap::siftDown(uint32_t pos) {
+  TimedTaskPtr task = tasks_[pos];
+  uint32_t size = static_cast<uint32_t>(tasks_.size());
+  while (true) {
+    uint32_t child = 2 * pos + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && before(tasks_[child + 1], tasks_[child])) {
+      ++child;
+    }
+    if (!before(tasks_[child], task)) {
+      break;
+    }
+    place(pos, tasks_[child]);
+    pos = child;
+  }
+  place(pos, task);
+}
+
+void TimedTaskHeap::removeAt(uint32_t pos) {
+  tasks_[pos]->queueSlot = -1;
+  TimedTaskPtr last = tasks_.back();
+  tasks_.pop_back();
+  if (pos == tasks_.size()) {
+    return;
+  }
+  place(pos, last);
+  if (pos > 0 && before(last, tasks_[(pos - 1) / 2])) {
+    siftUp(pos);
+  } else {
+    siftDown(pos);
+  }
+}
+
+void TimedTaskHeap::push(TimedTaskPtr task) {
+  task->queueSlot = 0;
+  tasks_.push_back(task);
+  siftUp(static_cast<uint32_t>(tasks_.size() - 1));
+}
+
+bool TimedTaskHeap::remove(TimedTaskImpl* task) {
+  if (task->queueSlot < 0) {
+    return false;
+  }
+  assert(tasks_[task->queuePos] == task);
+  removeAt(task->queuePos);
+  return true;
+}
+
+double TimedTaskHeap::nextExpiry() const {
+  return tasks_.empty() ? std::numeric_limits<double>::infinity() : tasks_.front()->latestTime();
+}
+
+bool TimedTaskHeap::nextExpiryIsExact() const {
+  return !tasks_.empty() && tasks_.front()->slack == 0.0;
+}
+
+bool TimedTaskHeap::nextExpiryWantsSpin() const {
+  return nextExpiryIsExact() && tasks_.front()->spin;
+}
+
+void TimedTaskHeap::popExpired(double curTime, std::vector<TimedTaskPtr>& expired) {
+  while (!tasks_.empty() && tasks_.front()->nextAbsTime <= curTime) {
+    expired.push_back(tasks_.front());
+    removeAt(0);
+  }
+}
+
+void TimedTaskHeap::drain(std::vector<TimedTaskPtr>& tasks) {
+  for (auto* task : tasks_) {
+    task->queueSlot = -1;
+    tasks.push_back(task);
+  }
+  tasks_.clear();
+}
+
+constexpr uint32_t TimingWheel::kSlotBits;
+constexpr uint32_t TimingWheel::kSlots;
+constexpr uint32_t TimingWheel::kLevels;
+constexpr int32_t TimingWheel::kDueSlot;
+
+namespace {
+constexpr uint32_t kWordsPerLevel = TimingWheel::kSlots / 64;
+constexpr uint64_t kMaxDelta = (uint64_t{1} << (TimingWheel::kSlotBits * TimingWheel::kLevels)) - 1;
+constexpr uint64_t kMaxTick = std::numeric_limits<uint64_t>::max() >> 1;
+
+uint64_t clampTick(double ticks) {
+  if (ticks <= 0.0) {
+    return 0;
+  }
+  if (ticks >= static_cast<double>(kMaxTick)) {
+    return kMaxTick;
+  }
+  return static_cast<uint64_t>(ticks);
+}
+} // namespace
+
+TimingWheel::TimingWheel(double resolution, double startTime)
+    : resolution_(resolution),
+      invResolution_(1.0 / resolution),
+      startTime_(startTime),
+      slots_(kSlots * kLevels),
+      occupied_(kWordsPerLevel * kLevels, 0) {
+  assert(resolution > 0.0);
+}
+
+uint64_t TimingWheel::toTick(double t) const {
+  return clampTick(std::ceil((t - startTime_) * invResolution_));
+}
+
+uint64_t TimingWheel::targetTick(const TimedTaskImpl& task) const {
+  uint64_t first = toTick(task.nextAbsTime);
+  if (task.slack == 0.0 || !first) {
+    return first;
+  }
+  uint64_t last = clampTick(std::floor((task.latestTime() - startTime_) * invResolution_));
+  if (last <= first) {
+    return first;
+  }
+  // Keep the bits of last above the highest bit in which it differs from first - 1.  The result is
+  // the most aligned tick in [first, last].
+  uint64_t mask = (uint64_t{1} << log2((first - 1) ^ last)) - 1;
+  return last & ~mask;
+}
+
+void TimingWheel::link(Slot& slot, int32_t slotIndex, TimedTaskPtr task) {
+  task->queueSlot = slotIndex;
+  task->queuePos = static_cast<uint32_t>(slot.size());
+  slot.push_back(task);
+  if (slotIndex != kDueSlot) {
+    occupied_[slotIndex >> 6] |= uint64_t{1} << (slotIndex & 63);
+  }
+}
+
+void TimingWheel::insert(TimedTaskPtr task) {
+  uint64_t tick = targetTick(*task);
+  if (tick <= curTick_) {
+    link(due_, kDueSlot, task);
+    return;
+  }
+  uint64_t delta = std::min(tick - curTick_, kMaxDelta);
+  tick = curTick_ + delta;
+  uint32_t level = 0;
+  while (delta >> (kSlotBits * (level + 1))) {
+    ++level;
+  }
+  uint32_t slot = static_cast<uint32_t>(tick >> (kSlotBits * level)) & (kSlots - 1);
+  int32_t slotIndex = static_cast<int32_t>(level * kSlots + slot);
+  link(slots_[slotIndex], slotIndex, task);
+}
+
+void TimingWheel::push(TimedTaskPtr task) {
+  ++size_;
+  insert(task);
+}
+
+bool TimingWheel::remove(TimedTaskImpl* task) {
+  int32_t slotIndex = task->queueSlot;
+  if (slotIndex < 0) {
+    return false;
+  }
+  Slot& slot = slotAt(slotIndex);
+  uint32_t pos = task->queuePos;
+  if (pos + 1 != slot.size()) {
+    slot[pos] = slot.back();
+    slot[pos]->queuePos = pos;
+  }
+  slot.pop_back();
+  if (slot.empty() && slotIndex != kDueSlot) {
+    occupied_[slotIndex >> 6] &= ~(uint64_t{1} << (slotIndex & 63));
+  }
+  task->queueSlot = -1;
+  --size_;
+  return true;
+}
+
+void TimingWheel::cascade(uint32_t level) {
+  uint32_t slot = static_cast<uint32_t>(curTick_ >> (kSlotBits * level)) & (kSlots - 1);
+  int32_t slotIndex = static_cast<int32_t>(level * kSlots + slot);
+  Slot tasks;
+  tasks.swap(slots_[slotIndex]);
+  occupied_[slotIndex >> 6] &= ~(uint64_t{1} << (slotIndex & 63));
+  for (auto* task : tasks) {
+    insert(task);
+  }
+  // Hand the capacity back so that steady-state cascading does not allocate.
+  tasks.clear();
+  if (slots_[slotIndex].empty()) {
+    slots_[slotIndex].swap(tasks);
+  }
+}
+
+uint64_t TimingWheel::nextEventTick() const {
+  uint64_t best = std::numeric_limits<uint64_t>::max();
+  for (uint32_t level = 0; level < kLevels; ++level) {
+    const uint64_t* bits = &occupied_[level * kWordsPerLevel];
+    uint64_t base = curTick_ >> (kSlotBits * level);
+    // Scan the slots after the current position, wrapping around to include the current slot,
+    // which at higher levels holds tasks one full revolution out.
+    for (uint32_t k = 1; k <= kSlots;) {
+      uint32_t slot = static_cast<uint32_t>(base + k) & (kSlots - 1);
+      uint64_t word = bits[slot >> 6] >> (slot & 63);
+      if (word) {
+        uint32_t offset = k + log2(word & (~word + 1));
+        if (offset <= kSlots) {
+          best = std::min(best, (base + offset) << (kSlotBits * level));
+        }
+        break;
+      }
+      k += 64 - (slot & 63);
+    }
+  }
+  return best;
+}
+
+double TimingWheel::nextExpiry() const {
+  if (!due_.empty()) {
+    return startTime_ + static_cast<double>(curTick_) * resolution_;
+  }
+  if (!size_) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return startTime_ + static_cast<double>(nextEventTick()) * resolution_;
+}
+
+void TimingWheel::popExpired(double curTime, std::vector<TimedTaskPtr>& expired) {
+  uint64_t nowTick = clampTick(std::floor((curTime - startTime_) * invResolution_));
+
+  while (curTick_ < nowTick) {
+    if (size_ == due_.size()) {
+      // Nothing in the wheel proper; jump straight to the current tick.
+      curTick_ = nowTick;
+      break;
+    }
+    uint64_t next = nextEventTick();
+    if (next > nowTick) {
+      curTick_ = nowTick;
+      break;
+    }
+    curTick_ = next;
+    for (uint32_t level = kLevels - 1; level > 0; --level) {
+      if (!(curTick_ & ((uint64_t{1} << (kSlotBits * level)) - 1))) {
+        cascade(level);
+      }
+    }
+    int32_t slotIndex = static_cast<int32_t>(curTick_ & (kSlots - 1));
+    Slot& slot = slots_[slotIndex];
+    for (auto* task : slot) {
+      link(due_, kDueSlot, task);
+    }
+    slot.clear();
+    occupied_[slotIndex >> 6] &= ~(uint64_t{1} << (slotIndex & 63));
+  }
+
+  size_ -= due_.size();
+  for (auto* task : due_) {
+    task->queueSlot = -1;
+    expired.push_back(task);
+  }
+  due_.clear();
+}
+
+void TimingWheel::drain(std::vector<TimedTaskPtr>& tasks) {
+  for (auto& slot : slots_) {
+    for (auto* task : slot) {
+      task->queueSlot = -1;
+      tasks.push_back(task);
+    }
+    slot.clear();
+  }
+  for (auto* task : due_) {
+    task->queueSlot = -1;
+    tasks.push_back(task);
+  }
+  due_.clear();
+  std::fill(occupied_.begin(), occupied_.end(), 0);
+  size_ = 0;
+}
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <dispenso/detail/timed_task_impl.h>
+
+namespace dispenso {
+namespace detail {
+
+using TimedTaskPtr = TimedTaskImpl*;
+
+// The pending-task container backing a TimedTaskScheduler.  All calls are made with the
+// scheduler's queue mutex held.  The queue owns one reference to each task it holds; push() hands
+// a reference to the queue, and remove(), popExpired() and drain() hand it back to the caller.
+class DISPENSO_DLL_ACCESS TimedTaskQueue {
+ public:
+  virtual ~TimedTaskQueue() = default;
+
+  virtual void push(TimedTaskPtr task) = 0;
+
+  // Unlink a pending task.  Returns false if the task is not currently held in the queue, e.g. it is
+  // being kicked off.
+  virtual bool remove(TimedTaskImpl* task) = 0;
+
+  // The absolute time at which the queue next needs servicing, or +infinity if the queue is empty.
+  virtual double nextExpiry() const = 0;
+
+  // Whether nextExpiry() should be waited for precisely, i.e. by spinning as it approaches.
+  virtual bool nextExpiryIsExact() const = 0;
+
+  // Whether nextExpiry() is exact and its task asked to be spun for even by a scheduler that
+  // otherwise waits precisely without spinning.
+  virtual bool nextExpiryWantsSpin() const = 0;
+
+  // Move every task due at or before curTime into expired.  Tasks whose windows have opened, i.e.
+  // whose nextAbsTime has passed, may be returned together with those whose latestTime() has
+  // passed, so that they are fired in a single batch.
+  virtual void popExpired(double curTime, std::vector<TimedTaskPtr>& expired) = 0;
+
+  // Move every pending task into tasks, leaving the queue empty.
+  virtual void drain(std::vector<TimedTaskPtr>& tasks) = 0;
+
+  virtual size_t size() const = 0;
+
+  bool empty() const {
+    return size() == 0;
+  }
+};
+
+// A binary heap ordered by latestTime().  As with Linux hrtimers, when the earliest latestTime()
+// comes due, tasks are popped in heap order for as long as their windows have opened.  Each task
+// tracks its index in the heap in queuePos, so that cancelled tasks can be removed in O(log n).
+class DISPENSO_DLL_ACCESS TimedTaskHeap : public TimedTaskQueue {
+ public:
+  void push(TimedTaskPtr task) override;
+  bool remove(TimedTaskImpl* task) override;
+  double nextExpiry() const override;
+  bool nextExpiryIsExact() const override;
+  bool nextExpiryWantsSpin() const override;
+  void popExpired(double curTime, std::vector<TimedTaskPtr>& expired) override;
+  void drain(std::vector<TimedTaskPtr>& tasks) override;
+  size_t size() const override {
+    return tasks_.size();
+  }
+
+ private:
+  static bool before(const TimedTaskImpl* a, const TimedTaskImpl* b) {
+    return a->latestTime() < b->latestTime();
+  }
+
+  void place(uint32_t pos, TimedTaskPtr task) {
+    tasks_[pos] = task;
+    task->queuePos = pos;
+  }
+  void siftUp(uint32_t pos);
+  void siftDown(uint32_t pos);
+  void removeAt(uint32_t pos);
+
+  // TODO(bbudge): Consider lock-free priority queue implementation.  I'd expect it to be minimally
+  // beneficial for this use case though... timed tasks should rarely be super-high contention.
+  std::vector<TimedTaskPtr> tasks_;
+};
+
+// A hierarchical timing wheel in the style of Varghese and Lauck.  Time is quantized into ticks of
+// a fixed resolution.  Level 0 holds tasks due within the next kSlots ticks, one slot per tick, and
+// each higher level covers kSlots times the span of the level below.  When the lower levels wrap,
+// the next slot of the level above is cascaded down.  Insertion and removal are O(1), and all tasks
+// in a level 0 slot expire together.
+//
+// Tasks never expire early: a task is placed in the first tick at or after its nextAbsTime, so it
+// may expire up to one resolution late.  For tasks with slack, the tick within the task's window
+// that is a multiple of the largest power of two is chosen instead, so that tasks with overlapping
+// windows tend to land in the same slot.
+class DISPENSO_DLL_ACCESS TimingWheel : public TimedTaskQueue {
+ public:
+  static constexpr uint32_t kSlotBits = 8;
+  static constexpr uint32_t kSlots = 1 << kSlotBits;
+  static constexpr uint32_t kLevels = 4;
+
+  TimingWheel(double resolution, double startTime);
+
+  void push(TimedTaskPtr task) override;
+  bool remove(TimedTaskImpl* task) override;
+  double nextExpiry() const override;
+  bool nextExpiryIsExact() const override {
+    return false;
+  }
+  bool nextExpiryWantsSpin() const override {
+    return false;
+  }
+  void popExpired(double curTime, std::vector<TimedTaskPtr>& expired) override;
+  void drain(std::vector<TimedTaskPtr>& tasks) override;
+  size_t size() const override {
+    return size_;
+  }
+
+  double resolution() const {
+    return resolution_;
+  }
+
+ private:
+  // Slot index used for tasks that were already due when they were inserted.
+  static constexpr int32_t kDueSlot = kSlots * kLevels;
+
+  using Slot = std::vector<TimedTaskPtr>;
+
+  uint64_t toTick(double t) const;
+  uint64_t targetTick(const TimedTaskImpl& task) const;
+  void insert(TimedTaskPtr task);
+  void link(Slot& slot, int32_t slotIndex, TimedTaskPtr task);
+  void cascade(uint32_t level);
+  // The next tick after curTick_ at which a level 0 slot expires or a higher level slot cascades,
+  // or UINT64_MAX if nothing is pending in the wheel proper.
+  uint64_t nextEventTick() const;
+
+  Slot& slotAt(int32_t slotIndex) {
+    return slotIndex == kDueSlot ? due_ : slots_[slotIndex];
+  }
+
+  double resolution_;
+  double invResolution_;
+  double startTime_;
+  uint64_t curTick_ = 0;
+  size_t size_ = 0;
+  std::vector<Slot> slots_;
+  // One bit per slot, set when the slot is non-empty, to find the next event quickly.
+  std::vector<uint64_t> occupied_;
+  Slot due_;
+};
+
+} // namespace detail
+} // namespace dispenso
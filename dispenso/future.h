@@ -202,6 +202,31 @@ class Future : detail::FutureBase<Result> {
     return Base::wait_until(timeoutTime);
   }
 
+  /**
+   * Cancel the Future if its functor has not yet started.  A canceled Future becomes ready
+   * immediately, its functor is destroyed without being invoked, and the pool will skip it when it
+   * is dequeued.  Futures dependent on this one via <code>then</code> are canceled as well.
+   *
+   * @return <code>true</code> if the Future was canceled by this call, <code>false</code> if the
+   * functor was already running or complete (or the Future was already canceled).
+   *
+   * @note <code>get</code> on a canceled Future throws <code>std::future_error</code> with
+   * <code>std::future_errc::broken_promise</code>.  When exceptions are disabled, calling
+   * <code>get</code> on a canceled Future is an error.
+   **/
+  bool cancel() {
+    return Base::cancel();
+  }
+
+  /**
+   * Was the Future canceled?
+   *
+   * @return <code>true</code> if the Future is ready because it was canceled.
+   **/
+  bool is_canceled() const {
+    return Base::is_canceled();
+  }
+
   /**
    * Provide a shared future.  <code>share</code> is here only to provide compatible api with
    * <code>std::experimental::future</code>, but Future already works like std::shared_future.
@@ -262,6 +287,7 @@ class Future : detail::FutureBase<Result> {
 
   template <typename R>
   friend class Future;
+  friend struct detail::FutureAccess;
 };
 
 template <typename Result>
@@ -290,6 +316,8 @@ class Future<Result&> : detail::FutureBase<Result&> {
     return *this;
   }
   ~Future() = default;
+  using Base::cancel;
+  using Base::is_canceled;
   using Base::is_ready;
   using Base::valid;
   using Base::wait;
@@ -337,6 +365,7 @@ class Future<Result&> : detail::FutureBase<Result&> {
 
   template <typename R>
   friend class Future;
+  friend struct detail::FutureAccess;
 };
 
 template <>
@@ -365,6 +394,8 @@ class Future<void> : detail::FutureBase<void> {
     return *this;
   }
   ~Future() = default;
+  using Base::cancel;
+  using Base::is_canceled;
   using Base::is_ready;
   using Base::valid;
   using Base::wait;
@@ -408,6 +439,7 @@ class Future<void> : detail::FutureBase<void> {
 
   template <typename R>
   friend class Future;
+  friend struct detail::FutureAccess;
 };
 
 // TODO(bbudge): Determine if we should
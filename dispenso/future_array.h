@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file future_array.h
+ * A batch of futures launched from a single call.  Instead of one allocation, refcount, and
+ * scheduled task per value as with <code>dispenso::async</code>, <code>asyncBatch</code> creates a
+ * single shared control block holding all results and statuses, and schedules the work in chunks as
+ * is done with <code>parallel_for</code>.
+ **/
+
+#pragma once
+
+#include <future>
+
+#include <dispenso/detail/future_array_impl.h>
+#include <dispenso/detail/result_of.h>
+#include <dispenso/thread_pool.h>
+
+namespace dispenso {
+
+template <typename Result>
+class FutureArray;
+
+template <typename F>
+FutureArray<detail::ResultOf<F, size_t>>
+asyncBatch(ThreadPool& pool, size_t count, F&& f, size_t chunkSize = 0);
+
+/**
+ * A fixed-size array of futures sharing one control block.  Each element has <code>get</code> and
+ * <code>wait</code> semantics matching those of <code>Future</code>.  Like Future, FutureArray is
+ * copyable, and copies refer to the same shared results.
+ **/
+template <typename Result>
+class FutureArray {
+  static_assert(!std::is_reference<Result>::value, "FutureArray does not support reference results");
+
+ public:
+  /**
+   * Construct an invalid FutureArray.
+   **/
+  FutureArray() noexcept : impl_(nullptr) {}
+
+  FutureArray(FutureArray&& f) noexcept : impl_(f.impl_) {
+    f.impl_ = nullptr;
+  }
+
+  FutureArray(const FutureArray& f) noexcept : impl_(f.impl_) {
+    if (impl_) {
+      impl_->incRefCount();
+    }
+  }
+
+  FutureArray& operator=(FutureArray&& f) noexcept {
+    std::swap(impl_, f.impl_);
+    return *this;
+  }
+
+  FutureArray& operator=(const FutureArray& f) noexcept {
+    if (impl_ == f.impl_) {
+      return *this;
+    }
+    if (impl_) {
+      impl_->decRefCountMaybeDestroy();
+    }
+    impl_ = f.impl_;
+    if (impl_) {
+      impl_->incRefCount();
+    }
+    return *this;
+  }
+
+  /**
+   * Destruct the FutureArray.  Any work that has not yet run will still run.
+   **/
+  ~FutureArray() {
+    if (impl_) {
+      impl_->decRefCountMaybeDestroy();
+    }
+  }
+
+  /**
+   * Is this FutureArray backed by shared results?
+   **/
+  bool valid() const noexcept {
+    return impl_ != nullptr;
+  }
+
+  /**
+   * The number of elements in the batch.
+   **/
+  size_t size() const {
+    return impl_ ? impl_->size() : 0;
+  }
+
+  /**
+   * Is the result at <code>index</code> ready?
+   **/
+  bool is_ready(size_t index) const {
+    assert(valid());
+    return impl_->isReady(index);
+  }
+
+  /**
+   * Wait until the result at <code>index</code> is ready.  If the element has not yet been started,
+   * it will be run by the calling thread.
+   **/
+  void wait(size_t index) const {
+    assert(valid());
+    impl_->wait(index);
+  }
+
+  /**
+   * Wait until every result in the batch is ready.  The calling thread participates in running any
+   * chunks that have not yet been started.
+   **/
+  void wait() const {
+    assert(valid());
+    impl_->waitAll();
+  }
+
+  /**
+   * Wait until the result at <code>index</code> is ready, or until the timeout has elapsed.  Unlike
+   * <code>wait</code>, this will not run the element on the calling thread.
+   *
+   * @param index The element to wait for.
+   * @param timeoutDuration The maximum amount of time to wait.
+   *
+   * @return <code>std::future_status::ready</code> if the result is ready, or
+   * <code>std::future_status::timeout</code> otherwise.
+   **/
+  template <class Rep, class Period>
+  std::future_status wait_for(
+      size_t index,
+      const std::chrono::duration<Rep, Period>& timeoutDuration) const {
+    assert(valid());
+    return impl_->waitFor(index, timeoutDuration) ? std::future_status::ready
+                                                  : std::future_status::timeout;
+  }
+
+  /**
+   * Get the result at <code>index</code>, waiting if necessary.  If the functor threw an exception
+   * for this element, it is rethrown here.
+   *
+   * @return A const reference to the result, or void for <code>FutureArray&lt;void&gt;</code>.
+   **/
+  decltype(auto) get(size_t index) const {
+    wait(index);
+    return impl_->result(index);
+  }
+
+ private:
+  explicit FutureArray(detail::FutureArrayImplBase<Result>* impl) : impl_(impl) {}
+
+  detail::FutureArrayImplBase<Result>* impl_;
+
+  template <typename F>
+  friend FutureArray<detail::ResultOf<F, size_t>>
+  asyncBatch(ThreadPool& pool, size_t count, F&& f, size_t chunkSize);
+};
+
+/**
+ * Launch <code>count</code> invocations of <code>f</code> on <code>pool</code>, returning a
+ * FutureArray holding the results.  Element <code>i</code> of the result is
+ * <code>f(i)</code>.  Regardless of <code>count</code>, this makes a single allocation for the
+ * results and statuses, and schedules at most one worker task per pool thread.
+ *
+ * @param pool The ThreadPool on which to run the work.
+ * @param count The number of elements to compute.
+ * @param f A functor with signature Result(size_t).  It will be called concurrently from
+ * multiple threads.
+ * @param chunkSize The number of consecutive elements claimed by a worker at a time.  If zero, a
+ * chunk size is chosen in the same way as for a dynamically load-balanced parallel_for.
+ *
+ * @return A FutureArray of size <code>count</code>.
+ **/
+template <typename F>
+FutureArray<detail::ResultOf<F, size_t>>
+asyncBatch(ThreadPool& pool, size_t count, F&& f, size_t chunkSize) {
+  using Result = detail::ResultOf<F, size_t>;
+  using Impl = detail::FutureArrayImpl<Result, std::decay_t<F>>;
+
+  size_t numThreads = static_cast<size_t>(std::max<ssize_t>(pool.numThreads(), 0));
+  if (!chunkSize) {
+    size_t workingThreads = numThreads + 1;
+    size_t dynFactor = std::max<size_t>(1, std::min<size_t>(16, count / workingThreads));
+    size_t roughChunks = dynFactor * workingThreads;
+    chunkSize = std::max<size_t>(1, (count + roughChunks - 1) / roughChunks);
+  }
+
+  auto* impl = Impl::create(count, chunkSize, std::forward<F>(f));
+  FutureArray<Result> result(impl);
+
+  size_t numChunks = (count + chunkSize - 1) / chunkSize;
+  size_t numWorkers = std::min(std::max<size_t>(numThreads, 1), numChunks);
+  for (size_t i = 0; i < numWorkers; ++i) {
+    impl->incRefCount();
+    pool.schedule(
+        [impl]() {
+          impl->runChunks();
+          impl->decRefCountMaybeDestroy();
+        },
+        ForceQueuingTag());
+  }
+  return result;
+}
+
+/**
+ * Launch <code>count</code> invocations of <code>f</code> on the global thread pool, returning a
+ * FutureArray holding the results.
+ *
+ * @param count The number of elements to compute.
+ * @param f A functor with signature Result(size_t).
+ *
+ * @return A FutureArray of size <code>count</code>.
+ **/
+template <typename F>
+FutureArray<detail::ResultOf<F, size_t>> asyncBatch(size_t count, F&& f) {
+  return asyncBatch(globalThreadPool(), count, std::forward<F>(f));
+}
+
+} // namespace dispenso
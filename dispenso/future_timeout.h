@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file future_timeout.h
+ * Utilities for attaching timeouts and deadlines to Futures without blocking a waiting thread.  A
+ * timer on a TimedTaskScheduler races the Future's then-chain, and whichever completes first
+ * determines the result.
+ **/
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#include <dispenso/detail/op_result.h>
+#include <dispenso/future.h>
+#include <dispenso/timed_task.h>
+
+namespace dispenso {
+namespace detail {
+template <typename Result>
+struct TimeoutShared;
+} // namespace detail
+
+/**
+ * The result of a Future that has been raced against a timeout.  If the timeout did not expire
+ * first, <code>status()</code> is <code>std::future_status::ready</code> and the value can be
+ * obtained via <code>get()</code>.
+ **/
+template <typename Result>
+class TimeoutResult {
+ public:
+  /**
+   * Get the status of the race.
+   *
+   * @return <code>std::future_status::ready</code> if the underlying Future became ready before the
+   * timeout, or <code>std::future_status::timeout</code> otherwise.
+   **/
+  std::future_status status() const {
+    return status_;
+  }
+
+  /**
+   * Did the timeout expire before the underlying Future became ready?
+   **/
+  bool timedOut() const {
+    return status_ == std::future_status::timeout;
+  }
+
+  /**
+   * Access the underlying Future.  This is always valid, and may still become ready later even if
+   * the timeout expired.
+   **/
+  const Future<Result>& future() const {
+    return future_;
+  }
+
+  /**
+   * Get the value of the underlying Future.
+   *
+   * @note If <code>timedOut()</code> is true, this will block until the underlying Future is ready.
+   **/
+  decltype(auto) get() const {
+    return future_.get();
+  }
+
+ private:
+  TimeoutResult(std::future_status status, const Future<Result>& future)
+      : status_(status), future_(future) {}
+
+  std::future_status status_;
+  Future<Result> future_;
+
+  template <typename R>
+  friend struct detail::TimeoutShared;
+};
+
+namespace detail {
+
+template <typename Result>
+struct TimeoutShared {
+  Future<Result> future;
+  std::chrono::steady_clock::time_point deadline;
+  std::atomic<bool> done{false};
+  std::atomic<bool> timedOut{false};
+  OnceFunction f;
+
+  // The timer is held only so that it can be cancelled if the value arrives first.  It is reset by
+  // whichever side finishes the race in order to break the reference cycle between the timer's
+  // functor and this shared state.
+  std::mutex timerMutex;
+  OpResult<TimedTask> timer;
+
+  TimeoutShared(const Future<Result>& fut, std::chrono::steady_clock::time_point dl)
+      : future(fut), deadline(dl) {}
+
+  TimeoutResult<Result> makeResult(std::future_status status) {
+    return TimeoutResult<Result>(status, future);
+  }
+
+  // Returns true if the caller won the race, and should finish off the resultant future.
+  bool finish() {
+    return !done.exchange(true, std::memory_order_acq_rel);
+  }
+
+  void resetTimer(bool cancel) {
+    std::lock_guard<std::mutex> lk(timerMutex);
+    if (timer) {
+      if (cancel) {
+        timer.value().cancel();
+      }
+      timer = OpResult<TimedTask>();
+    }
+  }
+};
+
+} // namespace detail
+
+/**
+ * Race a Future against a deadline.  No thread blocks waiting for either event; the deadline is
+ * tracked by a timer on <code>scheduler</code>, and the timer is cancelled if the value arrives
+ * first.
+ *
+ * @param future The Future to race against the deadline.
+ * @param deadline The absolute time at which the returned Future will complete with timeout status
+ * if <code>future</code> is not yet ready.
+ * @param scheduler The TimedTaskScheduler used to track the deadline.
+ *
+ * @return A Future that becomes ready as soon as either <code>future</code> is ready or the
+ * deadline is reached, containing a <code>TimeoutResult</code> describing which came first.
+ *
+ * @note Calling <code>wait</code> or <code>get</code> on the returned Future will block no longer
+ * than until the deadline.
+ **/
+template <typename Result, typename Clock, typename Duration>
+Future<TimeoutResult<Result>> withDeadline(
+    Future<Result> future,
+    const std::chrono::time_point<Clock, Duration>& deadline,
+    TimedTaskScheduler& scheduler = globalTimedTaskScheduler()) {
+  auto steadyDeadline = std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline - Clock::now());
+
+  auto shared = std::make_shared<detail::TimeoutShared<Result>>(future, steadyDeadline);
+
+  // If wait() or get() is called on the resultant future before either side finishes the race,
+  // this functor may be run inline.  In that case we simply wait for the value or the deadline.
+  auto whenComplete = [shared]() -> TimeoutResult<Result> {
+    if (shared->timedOut.load(std::memory_order_acquire)) {
+      return shared->makeResult(std::future_status::timeout);
+    }
+    return shared->makeResult(shared->future.wait_until(shared->deadline));
+  };
+
+  detail::InterceptionInvoker interceptor;
+  Future<TimeoutResult<Result>> res(std::move(whenComplete), interceptor);
+  shared->f = std::move(interceptor.savedOffFn);
+
+  TimedTask timer = scheduler.schedule(
+      kImmediateInvoker,
+      [shared]() {
+        if (shared->finish()) {
+          shared->timedOut.store(true, std::memory_order_release);
+          shared->f();
+        }
+        shared->resetTimer(false);
+        return true;
+      },
+      deadline);
+  // The timer must never block in destruction, since the last reference may be dropped from within
+  // the timer's own functor.
+  timer.detach();
+  {
+    std::lock_guard<std::mutex> lk(shared->timerMutex);
+    if (shared->done.load(std::memory_order_acquire)) {
+      timer.cancel();
+    } else {
+      shared->timer.emplace(std::move(timer));
+    }
+  }
+
+  detail::FutureAccess::whenReadyIgnoringCancel(future, [shared](auto&&) {
+    if (shared->finish()) {
+      shared->f();
+    }
+    shared->resetTimer(true);
+  });
+
+  return res;
+}
+
+/**
+ * Race a Future against a timeout.  No thread blocks waiting for either event; the timeout is
+ * tracked by a timer on <code>scheduler</code>, and the timer is cancelled if the value arrives
+ * first.
+ *
+ * @param future The Future to race against the timeout.
+ * @param timeout The duration after which the returned Future will complete with timeout status if
+ * <code>future</code> is not yet ready.
+ * @param scheduler The TimedTaskScheduler used to track the timeout.
+ *
+ * @return A Future that becomes ready as soon as either <code>future</code> is ready or the
+ * timeout expires, containing a <code>TimeoutResult</code> describing which came first.
+ **/
+template <typename Result, typename Rep, typename Period>
+Future<TimeoutResult<Result>> withTimeout(
+    Future<Result> future,
+    const std::chrono::duration<Rep, Period>& timeout,
+    TimedTaskScheduler& scheduler = globalTimedTaskScheduler()) {
+  return withDeadline(std::move(future), std::chrono::steady_clock::now() + timeout, scheduler);
+}
+
+} // namespace dispenso
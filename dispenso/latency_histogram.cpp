@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/latency_histogram.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace dispenso {
+
+constexpr uint32_t LatencyHistogram::kSubBucketBits;
+constexpr uint32_t LatencyHistogram::kSubBuckets;
+constexpr uint32_t LatencyHistogram::kMaxValueBits;
+constexpr uint64_t LatencyHistogram::kMaxValue;
+constexpr uint32_t LatencyHistogram::kNumBuckets;
+
+uint64_t LatencyHistogram::bucketStart(uint32_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  uint32_t shift = index / kSubBuckets - 1;
+  uint64_t mantissa = kSubBuckets + (index & (kSubBuckets - 1));
+  return mantissa << shift;
+}
+
+uint64_t LatencyHistogram::bucketWidth(uint32_t index) {
+  return index < kSubBuckets ? 1 : uint64_t{1} << (index / kSubBuckets - 1);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snap;
+  snap.counts_.resize(kNumBuckets);
+  for (uint32_t i = 0; i < kNumBuckets; ++i) {
+    snap.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+    snap.count_ += snap.counts_[i];
+  }
+  snap.sumNs_ = sumNs_.load(std::memory_order_relaxed);
+  snap.maxNs_ = maxNs_.load(std::memory_order_relaxed);
+  return snap;
+}
+
+void LatencyHistogram::reset() {
+  for (auto& c : counts_) {
+    c.store(0, std::memory_order_relaxed);
+  }
+  sumNs_.store(0, std::memory_order_relaxed);
+  maxNs_.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Snapshot::percentile(double p) const {
+  if (!count_) {
+    return 0.0;
+  }
+  p = std::min(std::max(p, 0.0), 100.0);
+  uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(p * 0.01 * static_cast<double>(count_))));
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      // Report the middle of the bucket, but never more than the largest value recorded.
+      uint64_t ns = bucketStart(i) + bucketWidth(i) / 2;
+      return static_cast<double>(std::min(ns, maxNs_)) * 1e-9;
+    }
+  }
+  return max();
+}
+
+} // namespace dispenso
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file latency_histogram.h
+ * A lock-free histogram of durations, in the style of HdrHistogram.  Values are bucketed on a
+ * log-linear scale, so that every recorded value is represented to within a fixed relative
+ * precision, regardless of magnitude.
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A histogram of durations that may be recorded concurrently from any number of threads.  Durations
+ * are stored with nanosecond granularity, and each bucket spans at most 1/16th of its lower bound,
+ * so percentiles are accurate to within about 6%.  Durations of about 18 minutes or longer are
+ * clamped into the last bucket.
+ **/
+class LatencyHistogram {
+ public:
+  /**
+   * A point-in-time copy of a LatencyHistogram, from which percentiles may be read.
+   **/
+  class Snapshot {
+   public:
+    /**
+     * The number of durations recorded.
+     **/
+    uint64_t count() const {
+      return count_;
+    }
+
+    /**
+     * The mean of the recorded durations, in seconds, or zero if none were recorded.
+     **/
+    double mean() const {
+      return count_ ? static_cast<double>(sumNs_) * 1e-9 / static_cast<double>(count_) : 0.0;
+    }
+
+    /**
+     * The largest recorded duration, in seconds.
+     **/
+    double max() const {
+      return static_cast<double>(maxNs_) * 1e-9;
+    }
+
+    /**
+     * Get a percentile of the recorded durations.
+     *
+     * @param p The percentile in [0, 100], e.g. <code>99.9</code>.
+     * @return The duration in seconds at or below which <code>p</code> percent of the recorded
+     * durations fall, or zero if none were recorded.
+     **/
+    DISPENSO_DLL_ACCESS double percentile(double p) const;
+
+   private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sumNs_ = 0;
+    uint64_t maxNs_ = 0;
+
+    friend class LatencyHistogram;
+  };
+
+  /**
+   * Record a duration.  Negative durations are recorded as zero.
+   *
+   * @param seconds The duration in seconds.
+   **/
+  void record(double seconds) {
+    uint64_t ns = seconds > 0.0 ? static_cast<uint64_t>(seconds * 1e9) : 0;
+    if (ns > kMaxValue) {
+      ns = kMaxValue;
+    }
+    counts_[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    sumNs_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t prevMax = maxNs_.load(std::memory_order_relaxed);
+    while (ns > prevMax &&
+           !maxNs_.compare_exchange_weak(prevMax, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * Copy the current contents of the histogram.  Durations recorded concurrently with the snapshot
+   * may or may not be included.
+   **/
+  DISPENSO_DLL_ACCESS Snapshot snapshot() const;
+
+  /**
+   * Discard all recorded durations.  Must not be called concurrently with record().
+   **/
+  DISPENSO_DLL_ACCESS void reset();
+
+ private:
+  static constexpr uint32_t kSubBucketBits = 4;
+  static constexpr uint32_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr uint32_t kMaxValueBits = 40;
+  static constexpr uint64_t kMaxValue = (uint64_t{1} << kMaxValueBits) - 1;
+  static constexpr uint32_t kNumBuckets = (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  static uint32_t bucketIndex(uint64_t ns) {
+    if (ns < kSubBuckets) {
+      return static_cast<uint32_t>(ns);
+    }
+    uint32_t shift = detail::log2(ns) - kSubBucketBits;
+    uint32_t mantissa = static_cast<uint32_t>(ns >> shift) & (kSubBuckets - 1);
+    return (shift + 1) * kSubBuckets + mantissa;
+  }
+
+  // The smallest value held by bucket index, and the width of the bucket.
+  static uint64_t bucketStart(uint32_t index);
+  static uint64_t bucketWidth(uint32_t index);
+
+  std::atomic<uint64_t> counts_[kNumBuckets] = {};
+  std::atomic<uint64_t> sumNs_{0};
+  std::atomic<uint64_t> maxNs_{0};
+};
+
+} // namespace dispenso
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/object_pool.h>
+
+namespace dispenso {
+namespace detail {
+
+namespace {
+std::atomic<uint64_t> g_nextObjectPoolId{1};
+
+DISPENSO_THREAD_LOCAL ObjectPoolCacheEntry g_objectPoolCache[kObjectPoolCacheEntries];
+} // namespace
+
+uint64_t nextObjectPoolId() {
+  return g_nextObjectPoolId.fetch_add(1, std::memory_order_relaxed);
+}
+
+ObjectPoolCacheEntry* objectPoolThreadCache() {
+  return g_objectPoolCache;
+}
+
+} // namespace detail
+} // namespace dispenso
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file object_pool.h
+ * A file providing ObjectPool, an elastic pool of reusable objects with per-thread free lists.
+ * Unlike ResourcePool, the pool never blocks: when no object is free, a new one is constructed.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <concurrentqueue.h>
+#include <dispenso/platform.h>
+#include <dispenso/thread_id.h>
+#include <dispenso/tsan_annotations.h>
+
+namespace dispenso {
+namespace detail {
+
+struct ObjectPoolCacheEntry {
+  uint64_t poolId;
+  void* list;
+};
+
+constexpr size_t kObjectPoolCacheEntries = 4;
+
+// Pool ids are never reused, so a stale thread cache entry for a destroyed pool can never match.
+DISPENSO_DLL_ACCESS uint64_t nextObjectPoolId();
+
+// The calling thread's most recently used pools, most recent first.
+DISPENSO_DLL_ACCESS ObjectPoolCacheEntry* objectPoolThreadCache();
+
+} // namespace detail
+
+template <typename T>
+class ObjectPool;
+
+/**
+ * A RAII wrapper for an object acquired from an ObjectPool, which returns the object to the pool
+ * upon destruction.
+ **/
+template <typename T>
+class PooledObject {
+ public:
+  PooledObject(PooledObject&& other) : object_(other.object_), pool_(other.pool_) {
+    other.object_ = nullptr;
+  }
+
+  PooledObject& operator=(PooledObject&& other) {
+    if (&other != this) {
+      recycle();
+      object_ = other.object_;
+      pool_ = other.pool_;
+      other.object_ = nullptr;
+    }
+    return *this;
+  }
+
+  /**
+   * Access the underlying object.
+   *
+   * @return a reference to the object.
+   **/
+  T& get() const {
+    return *object_;
+  }
+
+  T& operator*() const {
+    return *object_;
+  }
+
+  T* operator->() const {
+    return object_;
+  }
+
+  ~PooledObject() {
+    recycle();
+  }
+
+ private:
+  PooledObject(T* object, ObjectPool<T>* pool) : object_(object), pool_(pool) {}
+
+  void recycle();
+
+  T* object_;
+  ObjectPool<T>* pool_;
+
+  friend class ObjectPool<T>;
+};
+
+/**
+ * A pool of objects that are constructed once and then reused, e.g. large scratch buffers or
+ * compressor states.  Each thread keeps its own bounded free list, so that an acquire and release
+ * on the same thread touch no shared state.  A thread's free list spills half of its objects to a
+ * shared lock-free list when full, and refills from the shared list when empty.  When no object is
+ * free anywhere, <code>acquire</code> constructs a new one, so the pool grows to the peak number of
+ * objects in use at once.
+ *
+ * Objects remain in a thread's free list after the thread exits, until the pool is destroyed.
+ **/
+template <typename T>
+class ObjectPool {
+ public:
+  /**
+   * The default number of free objects each thread may hold before spilling to the shared list.
+   **/
+  static constexpr size_t kDefaultThreadCapacity = 32;
+
+  /**
+   * Construct an ObjectPool of default constructed objects.
+   **/
+  ObjectPool() : ObjectPool([]() { return T(); }) {}
+
+  /**
+   * Construct an ObjectPool.
+   *
+   * @param init A functor with signature T() which is called to create each object.
+   * @param reset An optional functor with signature void(T&) which is called on each object as it
+   * is returned to the pool, e.g. to clear a buffer while keeping its capacity.
+   * @param threadCapacity The number of free objects each thread may hold before spilling half of
+   * them to the shared list.
+   **/
+  explicit ObjectPool(
+      std::function<T()> init,
+      std::function<void(T&)> reset = {},
+      size_t threadCapacity = kDefaultThreadCapacity)
+      : init_(std::move(init)),
+        reset_(std::move(reset)),
+        threadCapacity_(std::max<size_t>(threadCapacity, 1)),
+        transferCount_(std::max<size_t>(threadCapacity_ / 2, 1)),
+        id_(detail::nextObjectPoolId()) {}
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  /**
+   * Acquire an object from the pool, constructing a new one if none is free.
+   *
+   * @return a <code>PooledObject</code>-wrapped object.
+   **/
+  PooledObject<T> acquire() {
+    ThreadList& list = threadList();
+    if (list.objects.empty() && !refill(list)) {
+      return PooledObject<T>(create(), this);
+    }
+    T* t = list.objects.back();
+    list.objects.pop_back();
+    return PooledObject<T>(t, this);
+  }
+
+  /**
+   * Construct objects up front, so that the first acquires need not.  The objects are placed in the
+   * shared list.
+   *
+   * @param count The number of objects to construct.
+   **/
+  void reserve(size_t count) {
+    std::vector<T*> objects;
+    objects.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      objects.push_back(create());
+    }
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+    central_.enqueue_bulk(objects.data(), objects.size());
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+  }
+
+  /**
+   * Get the number of objects the pool has constructed, whether free or in use.
+   *
+   * @return The number of objects owned by the pool.
+   **/
+  size_t size() const {
+    return created_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Destruct the ObjectPool and all of its objects.  The user must ensure that all objects are
+   * returned to the pool prior to destroying the pool.
+   **/
+  ~ObjectPool() {
+    size_t destroyed = 0;
+    for (auto& entry : threadLists_) {
+      for (T* t : entry.second->objects) {
+        destroy(t);
+        ++destroyed;
+      }
+    }
+    T* t;
+    while (central_.try_dequeue(t)) {
+      destroy(t);
+      ++destroyed;
+    }
+    assert(destroyed == size());
+    (void)destroyed;
+  }
+
+ private:
+  struct ThreadList {
+    std::vector<T*> objects;
+  };
+
+  using ThreadListPtr = std::unique_ptr<ThreadList, detail::AlignedFreeDeleter<ThreadList>>;
+
+  ThreadList& threadList() {
+    detail::ObjectPoolCacheEntry* cache = detail::objectPoolThreadCache();
+    if (DISPENSO_EXPECT(cache[0].poolId == id_, 1)) {
+      return *static_cast<ThreadList*>(cache[0].list);
+    }
+    return threadListSlow(cache);
+  }
+
+  ThreadList& threadListSlow(detail::ObjectPoolCacheEntry* cache) {
+    detail::ObjectPoolCacheEntry entry{id_, nullptr};
+    size_t pos = 1;
+    for (; pos < detail::kObjectPoolCacheEntries; ++pos) {
+      if (cache[pos].poolId == id_) {
+        entry = cache[pos];
+        break;
+      }
+    }
+    if (!entry.list) {
+      pos = detail::kObjectPoolCacheEntries - 1;
+      entry.list = registerThread(threadId());
+    }
+    // Move the entry to the front, evicting the least recently used entry on a miss.
+    for (; pos > 0; --pos) {
+      cache[pos] = cache[pos - 1];
+    }
+    cache[0] = entry;
+    return *static_cast<ThreadList*>(entry.list);
+  }
+
+  ThreadList* registerThread(uint64_t tid) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto& entry : threadLists_) {
+      if (entry.first == tid) {
+        return entry.second.get();
+      }
+    }
+    // Cache line align each list so that threads' free lists do not falsely share.
+    ThreadListPtr list(
+        new (detail::alignedMalloc(detail::alignToCacheLine(sizeof(ThreadList)))) ThreadList());
+    list->objects.reserve(threadCapacity_);
+    threadLists_.emplace_back(tid, std::move(list));
+    return threadLists_.back().second.get();
+  }
+
+  bool refill(ThreadList& list) {
+    list.objects.resize(transferCount_);
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+    size_t got = central_.try_dequeue_bulk(list.objects.data(), transferCount_);
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+    list.objects.resize(got);
+    return got > 0;
+  }
+
+  void recycle(T* t) {
+    if (reset_) {
+      reset_(*t);
+    }
+    ThreadList& list = threadList();
+    if (list.objects.size() == threadCapacity_) {
+      T** spill = list.objects.data() + (threadCapacity_ - transferCount_);
+      DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+      central_.enqueue_bulk(spill, transferCount_);
+      DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+      list.objects.resize(threadCapacity_ - transferCount_);
+    }
+    list.objects.push_back(t);
+  }
+
+  T* create() {
+    constexpr size_t kAlignment = std::max<size_t>(alignof(T), kCacheLineSize);
+    void* buf = detail::alignedMalloc((sizeof(T) + kAlignment - 1) & ~(kAlignment - 1), kAlignment);
+    T* t;
+#if defined(__cpp_exceptions)
+    try {
+      t = new (buf) T(init_());
+    } catch (...) {
+      detail::alignedFree(buf);
+      throw;
+    }
+#else
+    t = new (buf) T(init_());
+#endif // __cpp_exceptions
+    created_.fetch_add(1, std::memory_order_relaxed);
+    return t;
+  }
+
+  static void destroy(T* t) {
+    t->~T();
+    detail::alignedFree(t);
+  }
+
+  std::function<T()> init_;
+  std::function<void(T&)> reset_;
+  const size_t threadCapacity_;
+  // The number of objects moved between a thread's free list and the shared list at a time.
+  const size_t transferCount_;
+  const uint64_t id_;
+
+  moodycamel::ConcurrentQueue<T*> central_;
+
+  std::mutex mtx_;
+  std::vector<std::pair<uint64_t, ThreadListPtr>> threadLists_;
+
+  std::atomic<size_t> created_{0};
+
+  friend class PooledObject<T>;
+};
+
+template <typename T>
+void PooledObject<T>::recycle() {
+  if (object_) {
+    pool_->recycle(object_);
+  }
+}
+
+} // namespace dispenso
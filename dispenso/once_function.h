@@ -13,6 +13,10 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 #include <dispenso/detail/once_callable_impl.h>
@@ -23,12 +27,15 @@ template <typename Result>
 class FutureBase;
 template <typename Result>
 class FutureImplBase;
+class TimedTaskImpl;
 } // namespace detail
 
 /**
  * A class fullfilling the void() signature, and operator() must be called exactly once for valid
  * <code>OnceFunction</code>s.  This class can be much more efficient than std::function for type
- * erasing functors without too much state (currently < ~250 bytes).
+ * erasing functors without too much state (currently < ~250 bytes).  Trivially copyable functors of
+ * up to 48 bytes, e.g. lambdas capturing a few pointers or references, are held inline and require
+ * no allocation at all.
  * @note The wrapped type-erased functor in OnceFunction is *not* deleted upon destruction, but
  * rather when operator() is called.  It is the user's responsibility to ensure that operator() is
  * called.
@@ -41,7 +48,7 @@ class OnceFunction {
    **/
   OnceFunction()
 #if defined DISPENSO_DEBUG
-      : onceCallable_(nullptr)
+      : onceCallable_(nullptr), invokeInline_(nullptr)
 #endif // DISPENSO_DEBUG
   {
   }
@@ -54,23 +61,36 @@ class OnceFunction {
    * overhead for double type erasure.
    **/
   template <typename F>
-  OnceFunction(F&& f) : onceCallable_(detail::createOnceCallable(std::forward<F>(f))) {}
+  OnceFunction(F&& f)
+      : OnceFunction(
+            std::forward<F>(f),
+            detail::OnceCallableFitsInline<typename std::decay<F>::type>()) {}
 
   OnceFunction(const OnceFunction& other) = delete;
 
-  OnceFunction(OnceFunction&& other) : onceCallable_(other.onceCallable_) {
+  OnceFunction(OnceFunction&& other)
+      : onceCallable_(other.onceCallable_), invokeInline_(other.invokeInline_) {
+    if (invokeInline_) {
+      std::memcpy(storage_, other.storage_, sizeof(storage_));
+    }
 #if defined DISPENSO_DEBUG
     other.onceCallable_ = nullptr;
+    other.invokeInline_ = nullptr;
 #endif // DISPENSO_DEBUG
   }
 
   OnceFunction& operator=(OnceFunction&& other) {
-    onceCallable_ = other.onceCallable_;
-#if defined DISPENSO_DEBUG
     if (&other != this) {
+      onceCallable_ = other.onceCallable_;
+      invokeInline_ = other.invokeInline_;
+      if (invokeInline_) {
+        std::memcpy(storage_, other.storage_, sizeof(storage_));
+      }
+#if defined DISPENSO_DEBUG
       other.onceCallable_ = nullptr;
-    }
+      other.invokeInline_ = nullptr;
 #endif // DISPENSO_DEBUG
+    }
     return *this;
   }
 
@@ -80,25 +100,48 @@ class OnceFunction {
    **/
   void operator()() const {
 #if defined DISPENSO_DEBUG
-    assert(onceCallable_ != nullptr && "Must not use OnceFunction more than once!");
+    assert(
+        (onceCallable_ != nullptr || invokeInline_ != nullptr) &&
+        "Must not use OnceFunction more than once!");
 #endif // DISPENSO_DEBUG
 
-    onceCallable_->run();
+    if (invokeInline_) {
+      invokeInline_(storage_);
+    } else {
+      onceCallable_->run();
+    }
 
 #if defined DISPENSO_DEBUG
     onceCallable_ = nullptr;
+    invokeInline_ = nullptr;
 #endif // DISPENSO_DEBUG
   }
 
  private:
-  OnceFunction(detail::OnceCallable* func, bool) : onceCallable_(func) {}
+  OnceFunction(detail::OnceCallable* func, bool) : onceCallable_(func), invokeInline_(nullptr) {}
+
+  template <typename F>
+  OnceFunction(F&& f, std::true_type)
+      : onceCallable_(nullptr),
+        invokeInline_(&detail::runInlineOnceCallable<typename std::decay<F>::type>) {
+    new (storage_) typename std::decay<F>::type(std::forward<F>(f));
+  }
+
+  template <typename F>
+  OnceFunction(F&& f, std::false_type)
+      : onceCallable_(detail::createOnceCallable(std::forward<F>(f))), invokeInline_(nullptr) {}
 
+  // Holds the functor when invokeInline_ is set.  Otherwise the functor is held by onceCallable_.
+  alignas(detail::kOnceCallableInlineAlignment) mutable char
+      storage_[detail::kOnceCallableInlineSize];
   mutable detail::OnceCallable* onceCallable_;
+  mutable void (*invokeInline_)(void*);
 
   template <typename Result>
   friend class detail::FutureBase;
   template <typename Result>
   friend class detail::FutureImplBase;
+  friend class detail::TimedTaskImpl;
 };
 
 } // namespace dispenso
@@ -16,6 +16,7 @@
 #include <limits>
 #include <memory>
 
+#include <dispenso/concurrent_vector.h>
 #include <dispenso/detail/can_invoke.h>
 #include <dispenso/detail/per_thread_info.h>
 #include <dispenso/task_set.h>
@@ -762,4 +763,87 @@ void parallel_for(
   parallel_for(taskSet, states, defaultState, start, end, std::forward<F>(f), options);
 }
 
+/**
+ * Execute a loop over the elements of a ConcurrentVector in parallel.  The indices
+ * <code>[0, vec.size())</code> are chunked as for an index loop, and each chunk is further split at
+ * the boundaries of the vector's underlying buffers, so that <code>f</code> is handed contiguous
+ * spans of elements, and inner loops can run over raw pointers.
+ *
+ * @param taskSet The task set to schedule the loop on.
+ * @param vec The vector to loop over.  Elements appended concurrently with this call may or may not
+ * be visited.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(T* begin, T* end)</code>.  It may be called more than once per chunk.
+ * @param options See ParForOptions for details.
+ **/
+template <typename TaskSetT, typename T, typename Traits, typename SizeTraits, typename F>
+void parallel_for(
+    TaskSetT& taskSet,
+    ConcurrentVector<T, Traits, SizeTraits>& vec,
+    F&& f,
+    ParForOptions options = {}) {
+  auto range = makeChunkedRange(size_t{0}, vec.size(), options.defaultChunking);
+  parallel_for(
+      taskSet,
+      range,
+      [&vec, f = std::move(f)](size_t s, size_t e) { vec.forEachSpan(s, e, f); },
+      options);
+}
+
+/**
+ * Execute a loop over the elements of a ConcurrentVector in parallel, handing <code>f</code>
+ * contiguous spans of elements.
+ *
+ * @param taskSet The task set to schedule the loop on.
+ * @param vec The vector to loop over.  Elements appended concurrently with this call may or may not
+ * be visited.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(const T* begin, const T* end)</code>.  It may be called more than once per chunk.
+ * @param options See ParForOptions for details.
+ **/
+template <typename TaskSetT, typename T, typename Traits, typename SizeTraits, typename F>
+void parallel_for(
+    TaskSetT& taskSet,
+    const ConcurrentVector<T, Traits, SizeTraits>& vec,
+    F&& f,
+    ParForOptions options = {}) {
+  auto range = makeChunkedRange(size_t{0}, vec.size(), options.defaultChunking);
+  parallel_for(
+      taskSet,
+      range,
+      [&vec, f = std::move(f)](size_t s, size_t e) { vec.forEachSpan(s, e, f); },
+      options);
+}
+
+/**
+ * Execute a loop over the elements of a ConcurrentVector in parallel on the global thread pool, and
+ * block until loop completion.
+ *
+ * @param vec The vector to loop over.
+ * @param f The functor to execute in parallel.  Must have a signature like
+ * <code>void(T* begin, T* end)</code>, or <code>void(const T* begin, const T* end)</code> if
+ * <code>vec</code> is const.  It may be called more than once per chunk.
+ * @param options See ParForOptions for details.  <code>options.wait</code> will always be reset
+ *to true.
+ **/
+template <typename T, typename Traits, typename SizeTraits, typename F>
+void parallel_for(
+    ConcurrentVector<T, Traits, SizeTraits>& vec,
+    F&& f,
+    ParForOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  parallel_for(taskSet, vec, std::forward<F>(f), options);
+}
+
+template <typename T, typename Traits, typename SizeTraits, typename F>
+void parallel_for(
+    const ConcurrentVector<T, Traits, SizeTraits>& vec,
+    F&& f,
+    ParForOptions options = {}) {
+  TaskSet taskSet(globalThreadPool());
+  options.wait = true;
+  parallel_for(taskSet, vec, std::forward<F>(f), options);
+}
+
 } // namespace dispenso
@@ -7,6 +7,11 @@
 
 #include <dispenso/pool_allocator.h>
 
+#include <algorithm>
+
+#include <dispenso/detail/math.h>
+#include <dispenso/thread_id.h>
+
 namespace dispenso {
 
 template <bool kThreadSafe>
@@ -14,54 +19,106 @@ PoolAllocatorT<kThreadSafe>::PoolAllocatorT(
     size_t chunkSize,
     size_t allocSize,
     std::function<void*(size_t)> allocFunc,
-    std::function<void(void*)> deallocFunc)
+    std::function<void(void*)> deallocFunc,
+    size_t threadCacheChunks)
     : chunkSize_(chunkSize),
       allocSize_(allocSize),
       chunksPerAlloc_(allocSize / chunkSize),
       allocFunc_(std::move(allocFunc)),
-      deallocFunc_(std::move(deallocFunc)) {
+      deallocFunc_(std::move(deallocFunc)),
+      threadCacheChunks_(kThreadSafe ? threadCacheChunks : 0) {
   // Start off with at least enough space to store at least one set of chunks.
   chunks_.reserve(chunksPerAlloc_);
+
+  if (threadCacheChunks_) {
+    // Twice as many magazines as hardware threads keeps collisions between thread ids rare.
+    size_t numCaches = static_cast<size_t>(
+        detail::nextPow2(2 * std::max<uint64_t>(std::thread::hardware_concurrency(), 1)));
+    threadCacheMask_ = numCaches - 1;
+    threadCaches_ = reinterpret_cast<ThreadCache*>(
+        detail::alignedMalloc(numCaches * sizeof(ThreadCache), alignof(ThreadCache)));
+    for (size_t i = 0; i < numCaches; ++i) {
+      new (threadCaches_ + i) ThreadCache();
+      threadCaches_[i].chunks.reserve(2 * threadCacheChunks_);
+    }
+  }
 }
 
 template <bool kThreadSafe>
-char* PoolAllocatorT<kThreadSafe>::alloc() {
-  while (true) {
-    uint32_t allocId = 0;
-    if (kThreadSafe) {
-      allocId = backingAllocLock_.fetch_or(1, std::memory_order_acquire);
+PoolAllocatorT<kThreadSafe>::PoolAllocatorT(
+    size_t chunkSize,
+    size_t allocSize,
+    BackingStoreOptions backing,
+    size_t threadCacheChunks)
+    : PoolAllocatorT(
+          chunkSize,
+          allocSize,
+          [backing](size_t bytes) {
+            return backingStoreAlloc(bytes, alignof(std::max_align_t), backing);
+          },
+          [backing, allocSize](void* ptr) { backingStoreFree(ptr, allocSize, backing); },
+          threadCacheChunks) {}
+
+template <bool kThreadSafe>
+typename PoolAllocatorT<kThreadSafe>::ThreadCache& PoolAllocatorT<kThreadSafe>::threadCache() {
+  return threadCaches_[static_cast<size_t>(threadId()) & threadCacheMask_];
+}
+
+template <bool kThreadSafe>
+char* PoolAllocatorT<kThreadSafe>::allocLocked() {
+  if (chunks_.empty()) {
+    char* buffer;
+    if (backingAllocs2_.empty()) {
+      buffer = reinterpret_cast<char*>(allocFunc_(allocSize_));
+    } else {
+      buffer = backingAllocs2_.back();
+      backingAllocs2_.pop_back();
     }
+    backingAllocs_.push_back(buffer);
+    // Push n-1 values into the chunks_ buffer, and then return the nth.
+    for (size_t i = 0; i < chunksPerAlloc_ - 1; ++i) {
+      chunks_.push_back(buffer);
+      buffer += chunkSize_;
+    }
+    return buffer;
+  }
+  char* back = chunks_.back();
+  chunks_.pop_back();
+  return back;
+}
+
+template <bool kThreadSafe>
+char* PoolAllocatorT<kThreadSafe>::refill(ThreadCache& cache) {
+  lock(backingAllocLock_);
+  char* result = allocLocked();
+  auto batchStart =
+      chunks_.end() - static_cast<ptrdiff_t>(std::min(chunks_.size(), threadCacheChunks_));
+  cache.chunks.insert(cache.chunks.end(), batchStart, chunks_.end());
+  chunks_.erase(batchStart, chunks_.end());
+  unlock(backingAllocLock_);
+  return result;
+}
 
-    if (allocId == 0) {
-      if (chunks_.empty()) {
-        char* buffer;
-        if (backingAllocs2_.empty()) {
-          buffer = reinterpret_cast<char*>(allocFunc_(allocSize_));
-        } else {
-          buffer = backingAllocs2_.back();
-          backingAllocs2_.pop_back();
-        }
-        backingAllocs_.push_back(buffer);
-        // Push n-1 values into the chunks_ buffer, and then return the nth.
-        for (size_t i = 0; i < chunksPerAlloc_ - 1; ++i) {
-          chunks_.push_back(buffer);
-          buffer += chunkSize_;
-        }
-        if (kThreadSafe) {
-          backingAllocLock_.store(0, std::memory_order_release);
-        }
-        return buffer;
-      }
-      char* back = chunks_.back();
-      chunks_.pop_back();
-      if (kThreadSafe) {
-        backingAllocLock_.store(0, std::memory_order_release);
-      }
-      return back;
+template <bool kThreadSafe>
+char* PoolAllocatorT<kThreadSafe>::alloc() {
+  if (threadCacheChunks_) {
+    ThreadCache& cache = threadCache();
+    lock(cache.lock);
+    char* result;
+    if (cache.chunks.empty()) {
+      result = refill(cache);
     } else {
-      std::this_thread::yield();
+      result = cache.chunks.back();
+      cache.chunks.pop_back();
     }
+    unlock(cache.lock);
+    return result;
   }
+
+  lock(backingAllocLock_);
+  char* result = allocLocked();
+  unlock(backingAllocLock_);
+  return result;
 }
 
 template <bool kThreadSafe>
@@ -73,24 +130,34 @@ void PoolAllocatorT<kThreadSafe>::dealloc(char* ptr) {
   // slower, but would ensure we don't get into a situation where we need a bunch of memory up
   // front, and then never again.
 
-  while (true) {
-    uint32_t allocId = 0;
-    if (kThreadSafe) {
-      allocId = backingAllocLock_.fetch_or(1, std::memory_order_acquire);
-    }
-    if (allocId == 0) {
-      chunks_.push_back(ptr);
-      if (kThreadSafe) {
-        backingAllocLock_.store(0, std::memory_order_release);
-      }
-      break;
+  if (threadCacheChunks_) {
+    ThreadCache& cache = threadCache();
+    lock(cache.lock);
+    cache.chunks.push_back(ptr);
+    if (cache.chunks.size() == 2 * threadCacheChunks_) {
+      auto batchStart = cache.chunks.end() - static_cast<ptrdiff_t>(threadCacheChunks_);
+      lock(backingAllocLock_);
+      chunks_.insert(chunks_.end(), batchStart, cache.chunks.end());
+      unlock(backingAllocLock_);
+      cache.chunks.erase(batchStart, cache.chunks.end());
     }
+    unlock(cache.lock);
+    return;
   }
+
+  lock(backingAllocLock_);
+  chunks_.push_back(ptr);
+  unlock(backingAllocLock_);
 }
 
 template <bool kThreadSafe>
 void PoolAllocatorT<kThreadSafe>::clear() {
   chunks_.clear();
+  if (threadCacheChunks_) {
+    for (size_t i = 0; i <= threadCacheMask_; ++i) {
+      threadCaches_[i].chunks.clear();
+    }
+  }
   if (backingAllocs2_.size() < backingAllocs_.size()) {
     std::swap(backingAllocs2_, backingAllocs_);
   }
@@ -102,6 +169,12 @@ void PoolAllocatorT<kThreadSafe>::clear() {
 
 template <bool kThreadSafe>
 PoolAllocatorT<kThreadSafe>::~PoolAllocatorT() {
+  if (threadCacheChunks_) {
+    for (size_t i = 0; i <= threadCacheMask_; ++i) {
+      threadCaches_[i].~ThreadCache();
+    }
+    detail::alignedFree(threadCaches_);
+  }
   for (char* backing : backingAllocs_) {
     deallocFunc_(backing);
   }
@@ -15,9 +15,13 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <functional>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <dispenso/backing_store.h>
 #include <dispenso/platform.h>
 
 namespace dispenso {
@@ -35,12 +39,31 @@ class PoolAllocatorT {
    * @param allocSize The size of underlying slabs to be chunked
    * @param allocFunc The underlying allocation function for allocating slabs
    * @param deallocFunc The underlying deallocation function.  Currently only called on destruction.
+   * @param threadCacheChunks If non-zero, and the allocator is thread safe, chunks are cached in
+   * per-thread magazines, and moved to and from the shared free list this many at a time.  Each
+   * thread may then hold up to twice this many free chunks that other threads cannot allocate.
    **/
   DISPENSO_DLL_ACCESS PoolAllocatorT(
       size_t chunkSize,
       size_t allocSize,
       std::function<void*(size_t)> allocFunc,
-      std::function<void(void*)> deallocFunc);
+      std::function<void(void*)> deallocFunc,
+      size_t threadCacheChunks = 0);
+
+  /**
+   * Construct a PoolAllocator whose slabs are obtained via backingStoreAlloc.
+   *
+   * @param chunkSize The chunk size for each pool allocation
+   * @param allocSize The size of underlying slabs to be chunked.  With huge pages, this should be a
+   * multiple of kHugePageSize, as each slab occupies whole huge pages.
+   * @param backing The placement policy for slabs, e.g. huge pages or NUMA-local placement.
+   * @param threadCacheChunks See above.
+   **/
+  DISPENSO_DLL_ACCESS PoolAllocatorT(
+      size_t chunkSize,
+      size_t allocSize,
+      BackingStoreOptions backing,
+      size_t threadCacheChunks = 0);
 
   /**
    * Allocate a chunk from a slab
@@ -59,7 +82,7 @@ class PoolAllocatorT {
   /**
    * Effectively dealloc all previously allocated chunks.  Useful for arenas.
    * This function is not thread safe, and no previously allocated chunks may be dealloc'd after
-   * clear.
+   * clear.  Chunks cached by threads are discarded along with the rest.
    **/
   DISPENSO_DLL_ACCESS void clear();
 
@@ -70,12 +93,49 @@ class PoolAllocatorT {
   size_t totalChunkCapacity() const {
     return (backingAllocs2_.size() + backingAllocs_.size()) * chunksPerAlloc_;
   }
+
+  /**
+   * Get the size in bytes of the chunks returned by alloc().
+   **/
+  size_t chunkSize() const {
+    return chunkSize_;
+  }
+
   /**
    * Destruct a PoolAllocator
    **/
   DISPENSO_DLL_ACCESS ~PoolAllocatorT();
 
  private:
+  // A magazine of free chunks.  Threads are mapped onto magazines by thread id, so that as long as
+  // there are no more threads than magazines, each magazine and its lock are only touched by one
+  // thread.
+  struct alignas(kCacheLineSize) ThreadCache {
+    std::atomic<uint32_t> lock{0};
+    std::vector<char*> chunks;
+  };
+
+  static void lock(std::atomic<uint32_t>& l) {
+    if (kThreadSafe) {
+      while (l.fetch_or(1, std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  static void unlock(std::atomic<uint32_t>& l) {
+    if (kThreadSafe) {
+      l.store(0, std::memory_order_release);
+    }
+  }
+
+  ThreadCache& threadCache();
+  // Take a chunk from the shared free list, growing the pool if it is empty.  Must be called with
+  // backingAllocLock_ held.
+  char* allocLocked();
+  // Move up to threadCacheChunks_ chunks from the shared free list into cache, growing the pool if
+  // needed, and return one further chunk.
+  char* refill(ThreadCache& cache);
+
   const size_t chunkSize_;
   const size_t allocSize_;
   const size_t chunksPerAlloc_;
@@ -89,9 +149,97 @@ class PoolAllocatorT {
   std::vector<char*> backingAllocs2_;
 
   std::vector<char*> chunks_;
+
+  const size_t threadCacheChunks_;
+  size_t threadCacheMask_ = 0;
+  ThreadCache* threadCaches_ = nullptr;
 };
 
 using PoolAllocator = PoolAllocatorT<true>;
 using NoLockPoolAllocator = PoolAllocatorT<false>;
 
+/**
+ * An allocator satisfying the standard library's Allocator requirements, which takes memory from a
+ * PoolAllocator.  This is intended for node-based containers such as <code>std::list</code>,
+ * <code>std::map</code>, and <code>std::unordered_map</code>, whose nodes are allocated one at a
+ * time; the pool's chunk size should be chosen to fit the container's node type.  Requests that do
+ * not fit in a chunk, such as hash table bucket arrays, fall back on alignedMalloc.
+ *
+ * Copies and rebound copies share the same pool, which must outlive them and any memory they
+ * allocate.  The pool's allocFunc is assumed to return memory at least as aligned as malloc's.
+ *
+ * @tparam T The type to allocate.
+ * @tparam Pool The pool type, either PoolAllocator or NoLockPoolAllocator.
+ **/
+template <typename T, typename Pool = PoolAllocator>
+class PoolStlAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  template <typename U>
+  struct rebind {
+    using other = PoolStlAllocator<U, Pool>;
+  };
+
+  /**
+   * Construct an allocator drawing from a pool.
+   *
+   * @param pool The backing pool.
+   **/
+  PoolStlAllocator(Pool& pool) : pool_(&pool) {}
+
+  template <typename U>
+  PoolStlAllocator(const PoolStlAllocator<U, Pool>& other) : pool_(&other.pool()) {}
+
+  /**
+   * Allocate storage for <code>n</code> objects of type <code>T</code>.
+   **/
+  T* allocate(size_t n) {
+    if (fitsInChunk(n)) {
+      return reinterpret_cast<T*>(pool_->alloc());
+    }
+    return reinterpret_cast<T*>(detail::alignedMalloc(n * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * Deallocate storage previously returned by <code>allocate(n)</code>.
+   **/
+  void deallocate(T* p, size_t n) {
+    if (fitsInChunk(n)) {
+      pool_->dealloc(reinterpret_cast<char*>(p));
+    } else {
+      detail::alignedFree(p);
+    }
+  }
+
+  /**
+   * Get the backing pool.
+   **/
+  Pool& pool() const {
+    return *pool_;
+  }
+
+ private:
+  bool fitsInChunk(size_t n) const {
+    size_t chunkSize = pool_->chunkSize();
+    return n <= chunkSize / sizeof(T) && alignof(T) <= alignof(std::max_align_t) &&
+        chunkSize % alignof(T) == 0;
+  }
+
+  Pool* pool_;
+};
+
+template <typename T, typename U, typename Pool>
+inline bool operator==(const PoolStlAllocator<T, Pool>& a, const PoolStlAllocator<U, Pool>& b) {
+  return &a.pool() == &b.pool();
+}
+
+template <typename T, typename U, typename Pool>
+inline bool operator!=(const PoolStlAllocator<T, Pool>& a, const PoolStlAllocator<U, Pool>& b) {
+  return !(a == b);
+}
+
 } // namespace dispenso
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/reactor.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace dispenso {
+
+namespace {
+// Events carry the file descriptor in the low 32 bits and the registration generation in the high
+// 32 bits, so that events racing with remove (or with reuse of the descriptor) can be discarded.
+constexpr uint64_t kWakeKey = ~uint64_t{0};
+
+inline uint64_t makeKey(int fd, uint32_t generation) {
+  return (uint64_t{generation} << 32) | static_cast<uint32_t>(fd);
+}
+} // namespace
+
+Reactor::Reactor() : epollFd_(::epoll_create1(EPOLL_CLOEXEC)), wakeFd_(-1) {
+  if (epollFd_ < 0) {
+    return;
+  }
+  // A semaphore eventfd makes each wake() release exactly one poller.
+  wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.u64 = kWakeKey;
+  if (wakeFd_ < 0 || ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev)) {
+    if (wakeFd_ >= 0) {
+      ::close(wakeFd_);
+      wakeFd_ = -1;
+    }
+    ::close(epollFd_);
+    epollFd_ = -1;
+  }
+}
+
+Reactor::~Reactor() {
+  if (!valid()) {
+    return;
+  }
+  ::close(wakeFd_);
+  ::close(epollFd_);
+}
+
+bool Reactor::arm(int op, const Registration& reg) {
+  epoll_event ev;
+  ev.events = reg.events | EPOLLONESHOT;
+  ev.data.u64 = makeKey(reg.fd, reg.generation);
+  return ::epoll_ctl(epollFd_, op, reg.fd, &ev) == 0;
+}
+
+bool Reactor::add(int fd, uint32_t events, Callback callback) {
+  if (!valid()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lk(mtx_);
+  auto reg = std::make_shared<Registration>();
+  reg->fd = fd;
+  reg->generation = nextGeneration_++;
+  reg->events = events;
+  reg->callback = std::move(callback);
+  if (!registrations_.emplace(fd, reg).second) {
+    return false;
+  }
+  if (!arm(EPOLL_CTL_ADD, *reg)) {
+    registrations_.erase(fd);
+    return false;
+  }
+  return true;
+}
+
+bool Reactor::modify(int fd, uint32_t events) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  auto it = registrations_.find(fd);
+  if (it == registrations_.end()) {
+    return false;
+  }
+  it->second->events = events;
+  // If the callback is currently running, it will be rearmed with the new events when it returns.
+  return it->second->running || arm(EPOLL_CTL_MOD, *it->second);
+}
+
+bool Reactor::remove(int fd) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  auto it = registrations_.find(fd);
+  if (it == registrations_.end()) {
+    return false;
+  }
+  ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+  registrations_.erase(it);
+  return true;
+}
+
+size_t Reactor::poll(uint32_t timeoutUs) {
+  // Take a single event at a time, so that when several descriptors are ready their callbacks are
+  // spread across the idle pollers rather than serialized on one thread.
+  epoll_event ev;
+  int timeoutMs = static_cast<int>((uint64_t{timeoutUs} + 999) / 1000);
+  int n;
+  do {
+    n = ::epoll_wait(epollFd_, &ev, 1, timeoutMs);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    return 0;
+  }
+
+  if (ev.data.u64 == kWakeKey) {
+    uint64_t val;
+    // With EFD_SEMAPHORE this consumes a single wake.  Rearm so that any remaining wakes release
+    // other pollers.
+    (void)!::read(wakeFd_, &val, sizeof(val));
+    epoll_event wev;
+    wev.events = EPOLLIN | EPOLLONESHOT;
+    wev.data.u64 = kWakeKey;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, wakeFd_, &wev);
+    return 0;
+  }
+
+  int fd = static_cast<int>(static_cast<uint32_t>(ev.data.u64));
+  uint32_t generation = static_cast<uint32_t>(ev.data.u64 >> 32);
+  std::shared_ptr<Registration> reg;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = registrations_.find(fd);
+    if (it == registrations_.end() || it->second->generation != generation) {
+      return 0;
+    }
+    reg = it->second;
+    reg->running = true;
+  }
+
+  reg->callback(ev.events);
+
+  std::lock_guard<std::mutex> lk(mtx_);
+  reg->running = false;
+  auto it = registrations_.find(fd);
+  if (it != registrations_.end() && it->second == reg) {
+    arm(EPOLL_CTL_MOD, *reg);
+  }
+  return 1;
+}
+
+void Reactor::wake() {
+  uint64_t one = 1;
+  (void)!::write(wakeFd_, &one, sizeof(one));
+}
+
+} // namespace dispenso
+
+#endif // __linux__
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file reactor.h
+ * An epoll-based reactor that can be attached to a ThreadPool.  When attached, idle pool threads
+ * block in <code>epoll_wait</code> rather than on the pool's futex, and readiness callbacks are run
+ * directly on those threads, avoiding a hop from a separate event-loop thread.  Wakeups for newly
+ * scheduled work are delivered through an eventfd registered with the same epoll instance.
+ *
+ * Reactor is only available on Linux.
+ **/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+/**
+ * A set of file descriptors of interest, and callbacks to run when they become ready.
+ *
+ * Each registration is armed one-shot internally and rearmed after its callback returns, so a
+ * callback is never invoked concurrently with itself, even when many threads are polling.  Distinct
+ * file descriptors' callbacks may run concurrently on different threads.
+ **/
+class Reactor {
+ public:
+  /**
+   * The callback type.  The argument is the set of epoll events (e.g. <code>EPOLLIN</code>) that
+   * were reported for the file descriptor.
+   **/
+  using Callback = std::function<void(uint32_t events)>;
+
+  DISPENSO_DLL_ACCESS Reactor();
+  DISPENSO_DLL_ACCESS ~Reactor();
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+  /**
+   * Was the underlying epoll instance created successfully?
+   **/
+  bool valid() const {
+    return epollFd_ >= 0;
+  }
+
+  /**
+   * Register interest in a file descriptor.
+   *
+   * @param fd The file descriptor to watch.  Only one registration per file descriptor is allowed.
+   * @param events The epoll events of interest, e.g. <code>EPOLLIN | EPOLLRDHUP</code>.
+   * <code>EPOLLONESHOT</code> and <code>EPOLLET</code> are managed internally and should not be
+   * passed.
+   * @param callback The functor to invoke each time <code>fd</code> is ready.
+   *
+   * @return true on success, false if <code>fd</code> could not be registered.
+   **/
+  DISPENSO_DLL_ACCESS bool add(int fd, uint32_t events, Callback callback);
+
+  /**
+   * Change the events of interest for a registered file descriptor.
+   *
+   * @return true on success, false if <code>fd</code> is not registered.
+   **/
+  DISPENSO_DLL_ACCESS bool modify(int fd, uint32_t events);
+
+  /**
+   * Stop watching a file descriptor.  This must be called before closing <code>fd</code>.
+   *
+   * @return true if <code>fd</code> was registered.
+   *
+   * @note A callback for <code>fd</code> that is already executing on another thread may still be
+   * running when this returns, but no new invocation will begin.
+   **/
+  DISPENSO_DLL_ACCESS bool remove(int fd);
+
+  /**
+   * Wait up to <code>timeoutUs</code> microseconds for a ready file descriptor or a wakeup, and run
+   * the callback for at most one ready file descriptor.  This is called by idle threads of any
+   * ThreadPool the reactor is attached to, but may also be called directly, e.g. to drive a
+   * reactor that is not attached to a pool.
+   *
+   * @param timeoutUs The maximum time to wait.  Zero checks for readiness without blocking.  The
+   * timeout is rounded up to whole milliseconds.
+   *
+   * @return The number of callbacks invoked.
+   **/
+  DISPENSO_DLL_ACCESS size_t poll(uint32_t timeoutUs);
+
+  /**
+   * Wake one thread blocked in <code>poll</code>.  If no thread is currently blocked, the next call
+   * to <code>poll</code> returns immediately.
+   **/
+  DISPENSO_DLL_ACCESS void wake();
+
+ private:
+  struct Registration {
+    int fd;
+    uint32_t generation;
+    uint32_t events;
+    bool running = false;
+    Callback callback;
+  };
+
+  bool arm(int op, const Registration& reg);
+
+  int epollFd_;
+  int wakeFd_;
+  std::mutex mtx_;
+  std::unordered_map<int, std::shared_ptr<Registration>> registrations_;
+  uint32_t nextGeneration_ = 0;
+};
+
+} // namespace dispenso
+
+#endif // __linux__
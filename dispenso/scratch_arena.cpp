@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/scratch_arena.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <dispenso/pool_allocator.h>
+#include <dispenso/task_set.h>
+#include <dispenso/thread_id.h>
+
+namespace dispenso {
+
+constexpr size_t ScratchArena::kBlockSize;
+
+namespace detail {
+
+namespace {
+constexpr size_t kBlocksPerSlab = 16;
+constexpr size_t kThreadCacheBlocks = 4;
+// Room at the start of each allocation for the list link, keeping the remainder aligned.
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+constexpr size_t kMaxInBlock = ScratchArena::kBlockSize / 4;
+
+static_assert(sizeof(char*) <= kHeaderSize, "List links must fit in the header");
+
+PoolAllocator& scratchBlockPool() {
+  // Never destroyed, since arenas held by statics or thread-locals may be released during exit.
+  alignas(PoolAllocator) static char storage[sizeof(PoolAllocator)];
+  static PoolAllocator* pool = new (storage) PoolAllocator(
+      ScratchArena::kBlockSize,
+      ScratchArena::kBlockSize * kBlocksPerSlab,
+      [](size_t bytes) { return alignedMalloc(bytes); },
+      [](void* ptr) { alignedFree(ptr); },
+      kThreadCacheBlocks);
+  return *pool;
+}
+
+char*& nextLink(char* allocation) {
+  return *reinterpret_cast<char**>(allocation);
+}
+
+std::atomic<uint64_t> g_nextScratchId{1};
+
+DISPENSO_THREAD_LOCAL ScratchArenaScope* g_scratchScope = nullptr;
+// The most recently used task set arena on this thread, keyed by the TaskSetScratch id.
+DISPENSO_THREAD_LOCAL uint64_t g_cachedScratchId = 0;
+DISPENSO_THREAD_LOCAL ScratchArena* g_cachedScratchArena = nullptr;
+} // namespace
+
+struct TaskSetScratch {
+  const uint64_t id = g_nextScratchId.fetch_add(1, std::memory_order_relaxed);
+  std::mutex mtx;
+  std::vector<std::pair<uint64_t, std::unique_ptr<ScratchArena>>> arenas;
+
+  ScratchArena* arenaForThread(uint64_t tid) {
+    std::lock_guard<std::mutex> lk(mtx);
+    for (auto& entry : arenas) {
+      if (entry.first == tid) {
+        return entry.second.get();
+      }
+    }
+    arenas.emplace_back(tid, std::make_unique<ScratchArena>());
+    return arenas.back().second.get();
+  }
+};
+
+ScratchArena* taskSetScratchArena(TaskSetBase* tasks) {
+  TaskSetScratch* scratch = tasks->scratch_.load(std::memory_order_acquire);
+  if (!scratch) {
+    auto* created = new TaskSetScratch();
+    if (tasks->scratch_.compare_exchange_strong(scratch, created, std::memory_order_acq_rel)) {
+      scratch = created;
+    } else {
+      delete created;
+    }
+  }
+  if (g_cachedScratchId != scratch->id) {
+    g_cachedScratchArena = scratch->arenaForThread(threadId());
+    g_cachedScratchId = scratch->id;
+  }
+  return g_cachedScratchArena;
+}
+
+} // namespace detail
+
+void* ScratchArena::allocateSlow(size_t bytes, size_t alignment) {
+  using namespace detail;
+  if (bytes > kMaxInBlock || alignment > kCacheLineSize) {
+    size_t offset = std::max(alignment, kHeaderSize);
+    char* allocation = reinterpret_cast<char*>(alignedMalloc(offset + bytes, offset));
+    nextLink(allocation) = large_;
+    large_ = allocation;
+    bytesReserved_ += offset + bytes;
+    return allocation + offset;
+  }
+
+  char* block = scratchBlockPool().alloc();
+  nextLink(block) = blocks_;
+  blocks_ = block;
+  bytesReserved_ += kBlockSize;
+  cur_ = reinterpret_cast<uintptr_t>(block + kHeaderSize);
+  end_ = reinterpret_cast<uintptr_t>(block + kBlockSize);
+  return allocate(bytes, alignment);
+}
+
+void ScratchArena::release() {
+  using namespace detail;
+  if (blocks_) {
+    auto& pool = scratchBlockPool();
+    while (blocks_) {
+      char* next = nextLink(blocks_);
+      pool.dealloc(blocks_);
+      blocks_ = next;
+    }
+  }
+  while (large_) {
+    char* next = nextLink(large_);
+    alignedFree(large_);
+    large_ = next;
+  }
+  cur_ = end_ = 0;
+  bytesReserved_ = 0;
+}
+
+ScratchArenaScope::ScratchArenaScope()
+    : prev_(detail::g_scratchScope), taskSet_(parentTaskSet()) {
+  detail::g_scratchScope = this;
+}
+
+ScratchArenaScope::~ScratchArenaScope() {
+  detail::g_scratchScope = prev_;
+}
+
+ScratchArena* scratchArena() {
+  TaskSetBase* tasks = parentTaskSet();
+  ScratchArenaScope* scope = detail::g_scratchScope;
+  // A scope only applies to the task that opened it, and not to tasks of other sets that run
+  // inline on this thread, e.g. while the scope's task waits.
+  if (scope && scope->taskSet_ == tasks) {
+    return &scope->arena_;
+  }
+  return tasks ? detail::taskSetScratchArena(tasks) : nullptr;
+}
+
+void TaskSetBase::releaseScratchImpl() {
+  auto* scratch = scratch_.load(std::memory_order_acquire);
+  std::lock_guard<std::mutex> lk(scratch->mtx);
+  for (auto& entry : scratch->arenas) {
+    entry.second->release();
+  }
+}
+
+void TaskSetBase::destroyScratch() {
+  delete scratch_.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+} // namespace dispenso
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/**
+ * @file scratch_arena.h
+ * A file providing ScratchArena, a bump allocator for temporary allocations that are all freed at
+ * once, along with a thread-local accessor that binds arenas to a TaskSet or to a scope within a
+ * task.
+ **/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include <dispenso/platform.h>
+
+namespace dispenso {
+
+class TaskSetBase;
+
+/**
+ * A monotonic allocator: allocation bumps a pointer within the current block, and memory is only
+ * reclaimed, all at once, by <code>release</code> or destruction.  Blocks are taken from a
+ * process-wide pool with per-thread caching, so an arena that is repeatedly filled and released
+ * does not go to the system allocator.  Objects created in the arena are not destroyed; types with
+ * non-trivial destructors must be destroyed by the caller before the memory is released.
+ *
+ * <code>ScratchArena</code> is not thread safe; each arena should be used from one thread at a time.
+ **/
+class ScratchArena {
+ public:
+  /**
+   * The size of the blocks the arena is carved from.  Requests larger than a quarter of a block are
+   * allocated individually.
+   **/
+  static constexpr size_t kBlockSize = 16384;
+
+  ScratchArena() = default;
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  /**
+   * Allocate memory from the arena.
+   *
+   * @param bytes The number of bytes to allocate.
+   * @param alignment The required alignment, which must be a power of two.
+   * @return A pointer to the memory, valid until the arena is released or destroyed.
+   **/
+  void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+    uintptr_t p = (cur_ + alignment - 1) & ~(alignment - 1);
+    if (cur_ && p + bytes <= end_) {
+      cur_ = p + bytes;
+      return reinterpret_cast<void*>(p);
+    }
+    return allocateSlow(bytes, alignment);
+  }
+
+  /**
+   * Construct an object in the arena.
+   *
+   * @param args The arguments to forward to <code>T</code>'s constructor.
+   * @return A pointer to the new object.
+   **/
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Allocate uninitialized storage for an array.
+   *
+   * @param n The number of elements.
+   * @return A pointer to storage for <code>n</code> objects of type <code>T</code>.
+   **/
+  template <typename T>
+  T* allocateArray(size_t n) {
+    return reinterpret_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * Free everything allocated from the arena, returning its blocks to the pool.
+   **/
+  DISPENSO_DLL_ACCESS void release();
+
+  /**
+   * Get the number of bytes the arena currently holds, including unused space in its blocks.
+   **/
+  size_t bytesReserved() const {
+    return bytesReserved_;
+  }
+
+  ~ScratchArena() {
+    release();
+  }
+
+ private:
+  DISPENSO_DLL_ACCESS void* allocateSlow(size_t bytes, size_t alignment);
+
+  uintptr_t cur_ = 0;
+  uintptr_t end_ = 0;
+  // Singly linked lists of pool blocks and of individually allocated large requests, each linked
+  // through a pointer at the start of the allocation.
+  char* blocks_ = nullptr;
+  char* large_ = nullptr;
+  size_t bytesReserved_ = 0;
+};
+
+/**
+ * Make a fresh arena the current thread's <code>scratchArena()</code> for the lifetime of the scope,
+ * e.g. for the duration of a single task invocation.  Everything allocated from it is released when
+ * the scope ends.  Scopes nest, and the previous arena is restored on destruction.
+ **/
+class ScratchArenaScope {
+ public:
+  DISPENSO_DLL_ACCESS ScratchArenaScope();
+  ScratchArenaScope(const ScratchArenaScope&) = delete;
+  ScratchArenaScope& operator=(const ScratchArenaScope&) = delete;
+  DISPENSO_DLL_ACCESS ~ScratchArenaScope();
+
+  /**
+   * Get the scope's arena.
+   **/
+  ScratchArena& arena() {
+    return arena_;
+  }
+
+ private:
+  ScratchArena arena_;
+  ScratchArenaScope* prev_;
+  TaskSetBase* taskSet_;
+
+  friend DISPENSO_DLL_ACCESS ScratchArena* scratchArena();
+};
+
+/**
+ * Get the scratch arena for the calling code.  Within a <code>ScratchArenaScope</code>, this is the
+ * innermost scope's arena.  Otherwise, within a task scheduled on a <code>TaskSet</code> or
+ * <code>ConcurrentTaskSet</code>, this is an arena belonging to that set and the calling thread,
+ * whose memory remains valid until the set's <code>wait()</code> returns.  Each thread running the
+ * set's tasks gets its own arena, so tasks allocate without synchronization.
+ *
+ * @return The current arena, or nullptr outside of any scope or task set.
+ **/
+DISPENSO_DLL_ACCESS ScratchArena* scratchArena();
+
+} // namespace dispenso
@@ -8,17 +8,18 @@
 #include <dispenso/detail/small_buffer_allocator_impl.h>
 #include <dispenso/small_buffer_allocator.h>
 
+#include <algorithm>
 #include <new>
+#include <utility>
 
 namespace dispenso {
 namespace detail {
 // It may be possible that some tsan impls try to do global ctors and dtors in parallel.
 static std::atomic<int> g_smallBufferSchwarzCounter; // global is zero-init
 
-#define SMALL_BUFFER_GLOBALS_DECL(N)                           \
-  static AlignedBuffer<SmallBufferGlobals> g_globalsBuffer##N; \
-  static SmallBufferGlobals& g_globals##N =                    \
-      reinterpret_cast<SmallBufferGlobals&>(g_globalsBuffer##N)
+#define SMALL_BUFFER_GLOBALS_DECL(N)                                               \
+  static AlignedBuffer<SmallBufferGlobals> g_globalsBuffer##N[kSmallBufferStores]; \
+  static SmallBufferGlobals* g_globals##N = reinterpret_cast<SmallBufferGlobals*>(g_globalsBuffer##N)
 
 SMALL_BUFFER_GLOBALS_DECL(4);
 SMALL_BUFFER_GLOBALS_DECL(8);
@@ -27,11 +28,15 @@ SMALL_BUFFER_GLOBALS_DECL(32);
 SMALL_BUFFER_GLOBALS_DECL(64);
 SMALL_BUFFER_GLOBALS_DECL(128);
 SMALL_BUFFER_GLOBALS_DECL(256);
+SMALL_BUFFER_GLOBALS_DECL(512);
+SMALL_BUFFER_GLOBALS_DECL(1024);
+SMALL_BUFFER_GLOBALS_DECL(2048);
+SMALL_BUFFER_GLOBALS_DECL(4096);
 
-#define SMALL_BUFFER_GLOBAL_FUNC_DEFS(N)           \
-  template <>                                      \
-  SmallBufferGlobals& getSmallBufferGlobals<N>() { \
-    return g_globals##N;                           \
+#define SMALL_BUFFER_GLOBAL_FUNC_DEFS(N)                       \
+  template <>                                                  \
+  SmallBufferGlobals& getSmallBufferGlobals<N>(size_t store) { \
+    return g_globals##N[store];                                \
   }
 
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(4)
@@ -41,28 +46,44 @@ SMALL_BUFFER_GLOBAL_FUNC_DEFS(32)
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(64)
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(128)
 SMALL_BUFFER_GLOBAL_FUNC_DEFS(256)
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(512)
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(1024)
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(2048)
+SMALL_BUFFER_GLOBAL_FUNC_DEFS(4096)
 
 SchwarzSmallBufferInit::SchwarzSmallBufferInit() {
   if (g_smallBufferSchwarzCounter.fetch_add(1, std::memory_order_acq_rel) == 0) {
-    ::new (&g_globals4) SmallBufferGlobals();
-    ::new (&g_globals8) SmallBufferGlobals();
-    ::new (&g_globals16) SmallBufferGlobals();
-    ::new (&g_globals32) SmallBufferGlobals();
-    ::new (&g_globals64) SmallBufferGlobals();
-    ::new (&g_globals128) SmallBufferGlobals();
-    ::new (&g_globals256) SmallBufferGlobals();
+    for (size_t store = 0; store < kSmallBufferStores; ++store) {
+      ::new (&g_globals4[store]) SmallBufferGlobals(SmallBufferAllocator<4>::slabBytes());
+      ::new (&g_globals8[store]) SmallBufferGlobals(SmallBufferAllocator<8>::slabBytes());
+      ::new (&g_globals16[store]) SmallBufferGlobals(SmallBufferAllocator<16>::slabBytes());
+      ::new (&g_globals32[store]) SmallBufferGlobals(SmallBufferAllocator<32>::slabBytes());
+      ::new (&g_globals64[store]) SmallBufferGlobals(SmallBufferAllocator<64>::slabBytes());
+      ::new (&g_globals128[store]) SmallBufferGlobals(SmallBufferAllocator<128>::slabBytes());
+      ::new (&g_globals256[store]) SmallBufferGlobals(SmallBufferAllocator<256>::slabBytes());
+      ::new (&g_globals512[store]) SmallBufferGlobals(SmallBufferAllocator<512>::slabBytes());
+      ::new (&g_globals1024[store]) SmallBufferGlobals(SmallBufferAllocator<1024>::slabBytes());
+      ::new (&g_globals2048[store]) SmallBufferGlobals(SmallBufferAllocator<2048>::slabBytes());
+      ::new (&g_globals4096[store]) SmallBufferGlobals(SmallBufferAllocator<4096>::slabBytes());
+    }
   }
 }
 
 static void destroySmallBufferGlobals() {
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
-  g_globals4.~SmallBufferGlobals();
-  g_globals8.~SmallBufferGlobals();
-  g_globals16.~SmallBufferGlobals();
-  g_globals32.~SmallBufferGlobals();
-  g_globals64.~SmallBufferGlobals();
-  g_globals128.~SmallBufferGlobals();
-  g_globals256.~SmallBufferGlobals();
+  for (size_t store = 0; store < kSmallBufferStores; ++store) {
+    g_globals4[store].~SmallBufferGlobals();
+    g_globals8[store].~SmallBufferGlobals();
+    g_globals16[store].~SmallBufferGlobals();
+    g_globals32[store].~SmallBufferGlobals();
+    g_globals64[store].~SmallBufferGlobals();
+    g_globals128[store].~SmallBufferGlobals();
+    g_globals256[store].~SmallBufferGlobals();
+    g_globals512[store].~SmallBufferGlobals();
+    g_globals1024[store].~SmallBufferGlobals();
+    g_globals2048[store].~SmallBufferGlobals();
+    g_globals4096[store].~SmallBufferGlobals();
+  }
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
 }
 
@@ -88,6 +109,14 @@ char* allocSmallBufferImpl(size_t ordinal) {
       return detail::SmallBufferAllocator<128>::alloc();
     case 6:
       return detail::SmallBufferAllocator<256>::alloc();
+    case 7:
+      return detail::SmallBufferAllocator<512>::alloc();
+    case 8:
+      return detail::SmallBufferAllocator<1024>::alloc();
+    case 9:
+      return detail::SmallBufferAllocator<2048>::alloc();
+    case 10:
+      return detail::SmallBufferAllocator<4096>::alloc();
     default:
       assert(false && "Invalid small buffer ordinal requested");
       return nullptr;
@@ -117,8 +146,59 @@ void deallocSmallBufferImpl(size_t ordinal, void* buf) {
     case 6:
       detail::SmallBufferAllocator<256>::dealloc(reinterpret_cast<char*>(buf));
       break;
+    case 7:
+      detail::SmallBufferAllocator<512>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+    case 8:
+      detail::SmallBufferAllocator<1024>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+    case 9:
+      detail::SmallBufferAllocator<2048>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+    case 10:
+      detail::SmallBufferAllocator<4096>::dealloc(reinterpret_cast<char*>(buf));
+      break;
+    default:
+      assert(false && "Invalid small buffer ordinal requested");
+  }
+}
+
+size_t trimSmallBuffersImpl() {
+  return SmallBufferAllocator<4>::trim() + SmallBufferAllocator<8>::trim() +
+      SmallBufferAllocator<16>::trim() + SmallBufferAllocator<32>::trim() +
+      SmallBufferAllocator<64>::trim() + SmallBufferAllocator<128>::trim() +
+      SmallBufferAllocator<256>::trim() + SmallBufferAllocator<512>::trim() +
+      SmallBufferAllocator<1024>::trim() + SmallBufferAllocator<2048>::trim() +
+      SmallBufferAllocator<4096>::trim();
+}
+
+SmallBufferStats smallBufferStatsImpl(size_t ordinal) {
+  switch (ordinal) {
+    case 0:
+      return detail::SmallBufferAllocator<4>::stats();
+    case 1:
+      return detail::SmallBufferAllocator<8>::stats();
+    case 2:
+      return detail::SmallBufferAllocator<16>::stats();
+    case 3:
+      return detail::SmallBufferAllocator<32>::stats();
+    case 4:
+      return detail::SmallBufferAllocator<64>::stats();
+    case 5:
+      return detail::SmallBufferAllocator<128>::stats();
+    case 6:
+      return detail::SmallBufferAllocator<256>::stats();
+    case 7:
+      return detail::SmallBufferAllocator<512>::stats();
+    case 8:
+      return detail::SmallBufferAllocator<1024>::stats();
+    case 9:
+      return detail::SmallBufferAllocator<2048>::stats();
+    case 10:
+      return detail::SmallBufferAllocator<4096>::stats();
     default:
       assert(false && "Invalid small buffer ordinal requested");
+      return {};
   }
 }
 
@@ -138,6 +218,14 @@ size_t approxBytesAllocatedSmallBufferImpl(size_t ordinal) {
       return detail::SmallBufferAllocator<128>::bytesAllocated();
     case 6:
       return detail::SmallBufferAllocator<256>::bytesAllocated();
+    case 7:
+      return detail::SmallBufferAllocator<512>::bytesAllocated();
+    case 8:
+      return detail::SmallBufferAllocator<1024>::bytesAllocated();
+    case 9:
+      return detail::SmallBufferAllocator<2048>::bytesAllocated();
+    case 10:
+      return detail::SmallBufferAllocator<4096>::bytesAllocated();
     default:
       assert(false && "Invalid small buffer ordinal requested");
       return 0;
@@ -151,6 +239,8 @@ SmallBufferAllocator<kChunkSize>::PerThreadQueuingData::~PerThreadQueuingData()
   // ensure it is safe to release these resources.
   if (g_smallBufferSchwarzCounter.fetch_add(1, std::memory_order_acq_rel) > 0) {
     enqueue_bulk(buffers_, count_);
+    count_ = 0;
+    globals_.unregisterThreadCache(&count_);
   }
 
   if (g_smallBufferSchwarzCounter.fetch_sub(1, std::memory_order_acq_rel) == 1) {
@@ -163,6 +253,142 @@ SmallBufferAllocator<kChunkSize>::PerThreadQueuingData::~PerThreadQueuingData()
   DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
 }
 
+template <size_t kChunkSize>
+size_t SmallBufferAllocator<kChunkSize>::trim() {
+  auto bnc = buffersAndCount();
+  char** tlBuffers = std::get<0>(bnc);
+  size_t& tlCount = std::get<1>(bnc);
+  registerCleanup();
+  if (tlCount) {
+    recycleToCentralStore(tlBuffers, tlCount);
+    tlCount = 0;
+  }
+
+  // All stores are trimmed together, since a store's central queue may hold buffers freed on its
+  // node from slabs owned by another store.  Locks are always taken in store order.
+  SmallBufferGlobals* stores[kSmallBufferStores];
+  for (size_t store = 0; store < kSmallBufferStores; ++store) {
+    stores[store] = &getSmallBufferGlobals<kChunkSize>(store);
+    auto& lock = stores[store]->backingStoreLock;
+    uint32_t allocId = 0;
+    while (!lock.compare_exchange_weak(allocId, 1, std::memory_order_acquire)) {
+      allocId = 0;
+      std::this_thread::yield();
+    }
+  }
+
+  // Take every free buffer out of the central stores, remembering which store each came from.
+  // Buffers enqueued concurrently may be missed, which only means their slabs are conservatively
+  // kept.
+  using Owned = std::pair<char*, size_t>;
+  std::vector<Owned> freeBuffers;
+  std::vector<Owned> slabs;
+  constexpr size_t kBatch = 256;
+  char* batch[kBatch];
+  for (size_t store = 0; store < kSmallBufferStores; ++store) {
+    size_t got;
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+    while ((got = stores[store]->centralStore.try_dequeue_bulk(batch, kBatch)) > 0) {
+      for (size_t i = 0; i < got; ++i) {
+        freeBuffers.emplace_back(batch[i], store);
+      }
+    }
+    DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+    for (char* slab : stores[store]->backingStore) {
+      slabs.emplace_back(slab, store);
+    }
+    stores[store]->backingStore.clear();
+  }
+
+  // Count the free buffers in each slab, walking both sets in address order.  Slabs that are
+  // entirely free are released; every other buffer goes to the store that owns its slab.
+  std::sort(freeBuffers.begin(), freeBuffers.end());
+  std::sort(slabs.begin(), slabs.end());
+  auto before = [](const Owned& a, const char* b) { return a.first < b; };
+  std::vector<char*> kept[kSmallBufferStores];
+  size_t released = 0;
+  auto it = freeBuffers.begin();
+  for (const Owned& slab : slabs) {
+    auto slabBegin = std::lower_bound(it, freeBuffers.end(), slab.first, before);
+    // Every free buffer should lie within some slab, but never drop one that doesn't.
+    for (; it != slabBegin; ++it) {
+      kept[it->second].push_back(it->first);
+    }
+    auto slabEnd = std::lower_bound(slabBegin, freeBuffers.end(), slab.first + kMallocBytes, before);
+    if (static_cast<size_t>(slabEnd - slabBegin) == kBuffersPerMalloc) {
+      backingStoreFree(slab.first, kMallocBytes, smallBufferBacking());
+      released += kMallocBytes;
+    } else {
+      for (auto b = slabBegin; b != slabEnd; ++b) {
+        kept[slab.second].push_back(b->first);
+      }
+      stores[slab.second]->backingStore.push_back(slab.first);
+    }
+    it = slabEnd;
+  }
+  for (; it != freeBuffers.end(); ++it) {
+    kept[it->second].push_back(it->first);
+  }
+  stores[0]->totalSlabs.fetch_sub(released / kMallocBytes, std::memory_order_relaxed);
+
+  for (size_t store = kSmallBufferStores; store--;) {
+    stores[store]->backingStoreLock.store(0, std::memory_order_release);
+  }
+
+  for (size_t store = 0; store < kSmallBufferStores; ++store) {
+    if (!kept[store].empty()) {
+      DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_BEGIN();
+      stores[store]->centralStore.enqueue_bulk(kept[store].data(), kept[store].size());
+      DISPENSO_TSAN_ANNOTATE_IGNORE_WRITES_END();
+    }
+  }
+  return released;
+}
+
+template <size_t kChunkSize>
+SmallBufferStats SmallBufferAllocator<kChunkSize>::stats() {
+  size_t slabs = 0;
+  size_t centralBuffers = 0;
+  size_t cachedBuffers = 0;
+  SmallBufferStats stats;
+  for (size_t store = 0; store < kSmallBufferStores; ++store) {
+    auto& globals = getSmallBufferGlobals<kChunkSize>(store);
+    auto& lock = globals.backingStoreLock;
+    uint32_t allocId = 0;
+    while (!lock.compare_exchange_weak(allocId, 1, std::memory_order_acquire)) {
+      allocId = 0;
+      std::this_thread::yield();
+    }
+    slabs += globals.backingStore.size();
+    lock.store(0, std::memory_order_release);
+
+    centralBuffers += globals.centralStore.size_approx();
+
+    // Thread cache counts are read without synchronizing with their owning threads.
+    globals.lockThreadCaches();
+    DISPENSO_TSAN_ANNOTATE_IGNORE_READS_BEGIN();
+    for (const size_t* count : globals.threadCaches) {
+      cachedBuffers += *count;
+    }
+    DISPENSO_TSAN_ANNOTATE_IGNORE_READS_END();
+    globals.threadCachesLock.store(0, std::memory_order_release);
+
+    stats.refills += globals.refills.load(std::memory_order_relaxed);
+    stats.spills += globals.spills.load(std::memory_order_relaxed);
+  }
+
+  size_t totalBuffers = slabs * kBuffersPerMalloc;
+  size_t freeBuffers = std::min(totalBuffers, centralBuffers + cachedBuffers);
+  stats.blockSize = kChunkSize;
+  stats.bytesReserved = slabs * kMallocBytes;
+  stats.peakBytesReserved =
+      getSmallBufferGlobals<kChunkSize>(0).peakSlabs.load(std::memory_order_relaxed) * kMallocBytes;
+  stats.bytesCentral = centralBuffers * kChunkSize;
+  stats.bytesThreadCached = cachedBuffers * kChunkSize;
+  stats.liveAllocations = totalBuffers - freeBuffers;
+  return stats;
+}
+
 template class SmallBufferAllocator<4>;
 template class SmallBufferAllocator<8>;
 template class SmallBufferAllocator<16>;
@@ -170,6 +396,10 @@ template class SmallBufferAllocator<32>;
 template class SmallBufferAllocator<64>;
 template class SmallBufferAllocator<128>;
 template class SmallBufferAllocator<256>;
+template class SmallBufferAllocator<512>;
+template class SmallBufferAllocator<1024>;
+template class SmallBufferAllocator<2048>;
+template class SmallBufferAllocator<4096>;
 
 } // namespace detail
 } // namespace dispenso
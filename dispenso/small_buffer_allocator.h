@@ -13,6 +13,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
 #include <dispenso/detail/math.h>
 #include <dispenso/platform.h>
 
@@ -21,9 +26,33 @@ namespace dispenso {
 /**
  * Set a standard for the maximum chunk size for use within dispenso.  The reason for this limit is
  * that there are diminishing returns after a certain size, and each new pool has it's own memory
- * overhead.
+ * overhead.  Pools are sized per chunk size; see SmallBufferTraits in
+ * detail/small_buffer_allocator_impl.h, and the DISPENSO_SMALL_BUFFER_SMALL_FOOTPRINT build option.
+ **/
+constexpr size_t kMaxSmallBufferSize = 4096;
+
+/**
+ * A snapshot of the state of one small buffer pool, for diagnostics and monitoring.  Buffer counts
+ * are approximate while other threads allocate and deallocate.
  **/
-constexpr size_t kMaxSmallBufferSize = 256;
+struct SmallBufferStats {
+  /** The size of the buffers in this pool. **/
+  size_t blockSize = 0;
+  /** Bytes of slabs currently obtained from the system. **/
+  size_t bytesReserved = 0;
+  /** The most bytesReserved has been, counting all NUMA node stores at the same moment. **/
+  size_t peakBytesReserved = 0;
+  /** Bytes of free buffers held in the central store. **/
+  size_t bytesCentral = 0;
+  /** Bytes of free buffers held in thread-local caches. **/
+  size_t bytesThreadCached = 0;
+  /** The number of buffers currently allocated, i.e. neither centrally stored nor cached. **/
+  size_t liveAllocations = 0;
+  /** The number of times a thread cache was refilled from the central store. **/
+  uint64_t refills = 0;
+  /** The number of times a thread cache spilled a batch of buffers to the central store. **/
+  uint64_t spills = 0;
+};
 
 namespace detail {
 
@@ -31,6 +60,8 @@ DISPENSO_DLL_ACCESS char* allocSmallBufferImpl(size_t ordinal);
 DISPENSO_DLL_ACCESS void deallocSmallBufferImpl(size_t ordinal, void* buf);
 
 DISPENSO_DLL_ACCESS size_t approxBytesAllocatedSmallBufferImpl(size_t ordinal);
+DISPENSO_DLL_ACCESS size_t trimSmallBuffersImpl();
+DISPENSO_DLL_ACCESS SmallBufferStats smallBufferStatsImpl(size_t ordinal);
 
 // This has the effect of selecting actual block sizes starting with 4 bytes.  Smaller requests
 // (e.g. 1 byte, 2 bytes) will still utilize 4-byte blocks.  Choice of 4 bytes as the smallest
@@ -71,6 +102,27 @@ inline std::enable_if_t<(kBlockSize > kMaxSmallBufferSize), void> deallocSmallOr
   alignedFree(buf);
 }
 
+// Runtime-sized variants of the above, for callers whose sizes are not known at compile time.
+inline char* allocSmallOrLarge(size_t bytes, size_t alignment) {
+#if !defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  if (bytes <= kMaxSmallBufferSize) {
+    return allocSmallBufferImpl(log2(nextPow2(std::max<size_t>(bytes, 4))) - 2);
+  }
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+  return reinterpret_cast<char*>(alignedMalloc(bytes, alignment));
+}
+
+inline void deallocSmallOrLarge(void* buf, size_t bytes) {
+#if !defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  if (bytes <= kMaxSmallBufferSize) {
+    deallocSmallBufferImpl(log2(nextPow2(std::max<size_t>(bytes, 4))) - 2, buf);
+    return;
+  }
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+  (void)bytes;
+  alignedFree(buf);
+}
+
 static struct SchwarzSmallBufferInit {
   DISPENSO_DLL_ACCESS SchwarzSmallBufferInit();
   DISPENSO_DLL_ACCESS ~SchwarzSmallBufferInit();
@@ -119,4 +171,106 @@ size_t approxBytesAllocatedSmallBuffer() {
   return detail::approxBytesAllocatedSmallBufferImpl(detail::getOrdinal(kBlockSize));
 }
 
+/**
+ * Get statistics for the small buffer pool associated with kBlockSize.  This locks briefly, and
+ * should be called occasionally, e.g. to feed a monitoring dashboard, rather than on hot paths.
+ *
+ * @tparam kBlockSize The block size for the pool to query.
+ **/
+template <size_t kBlockSize>
+SmallBufferStats smallBufferStats() {
+#if defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  SmallBufferStats stats;
+  stats.blockSize = kBlockSize;
+  return stats;
+#else
+  return detail::smallBufferStatsImpl(detail::getOrdinal(kBlockSize));
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+}
+
+/**
+ * Get statistics for every small buffer pool, ordered by block size.
+ **/
+inline std::vector<SmallBufferStats> smallBufferStats() {
+  std::vector<SmallBufferStats> stats;
+  for (size_t blockSize = 4; blockSize <= kMaxSmallBufferSize; blockSize *= 2) {
+#if defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+    stats.emplace_back();
+    stats.back().blockSize = blockSize;
+#else
+    stats.push_back(detail::smallBufferStatsImpl(detail::getOrdinal(blockSize)));
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+  }
+  return stats;
+}
+
+/**
+ * Return memory held by the small buffer pools to the system.  Pools only grow as buffers are
+ * allocated, so after a burst of allocations has been freed, calling this releases every slab of
+ * memory whose buffers are all free.  Buffers cached by threads other than the caller are not
+ * considered free, and keep their slabs alive.  This adds no cost to allocation or deallocation,
+ * but is itself relatively expensive, so should be called occasionally, e.g. periodically or after
+ * known bursts.
+ *
+ * @return The number of bytes released.
+ **/
+inline size_t trimSmallBufferAllocators() {
+#if defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  return 0;
+#else
+  return detail::trimSmallBuffersImpl();
+#endif // DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+}
+
+/**
+ * An allocator satisfying the standard library's Allocator requirements, which takes memory from
+ * the small buffer pools.  Requests of up to kMaxSmallBufferSize bytes are rounded up to a power of
+ * two and served from the matching pool, and larger requests fall back on alignedMalloc.  This is
+ * best suited to node-based containers such as <code>std::list</code>, <code>std::map</code>, and
+ * <code>std::unordered_map</code>, whose nodes are allocated one at a time.  The allocator is
+ * stateless, and memory allocated by one instance may be deallocated by any other.
+ *
+ * @tparam T The type to allocate.
+ **/
+template <typename T>
+class SmallBufferStlAllocator {
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template <typename U>
+  struct rebind {
+    using other = SmallBufferStlAllocator<U>;
+  };
+
+  SmallBufferStlAllocator() = default;
+
+  template <typename U>
+  SmallBufferStlAllocator(const SmallBufferStlAllocator<U>&) {}
+
+  /**
+   * Allocate storage for <code>n</code> objects of type <code>T</code>.
+   **/
+  T* allocate(size_t n) {
+    return reinterpret_cast<T*>(detail::allocSmallOrLarge(n * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * Deallocate storage previously returned by <code>allocate(n)</code>.
+   **/
+  void deallocate(T* p, size_t n) {
+    detail::deallocSmallOrLarge(p, n * sizeof(T));
+  }
+};
+
+template <typename T, typename U>
+inline bool operator==(const SmallBufferStlAllocator<T>&, const SmallBufferStlAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const SmallBufferStlAllocator<T>&, const SmallBufferStlAllocator<U>&) {
+  return false;
+}
+
 } // namespace dispenso
@@ -66,6 +66,7 @@ bool ConcurrentTaskSet::wait() {
     }
   }
 
+  releaseScratch();
   return testAndResetException();
 }
 
@@ -83,6 +84,7 @@ bool ConcurrentTaskSet::tryWait(size_t maxToExecute) {
     return false;
   }
 
+  releaseScratch();
   return !testAndResetException();
 }
 
@@ -104,6 +106,7 @@ bool TaskSet::wait() {
     }
   }
 
+  releaseScratch();
   return testAndResetException();
 }
 
@@ -131,6 +134,7 @@ bool TaskSet::tryWait(size_t maxToExecute) {
     return false;
   }
 
+  releaseScratch();
   return !testAndResetException();
 }
 
@@ -76,7 +76,7 @@ class TaskSet : public TaskSetBase {
       return;
     }
     if (outstandingTaskCount_.load(std::memory_order_relaxed) > taskSetLoadFactor_) {
-      f();
+      runInline(f);
     } else {
       pool_.schedule(token_, packageTask(std::forward<F>(f)));
     }
@@ -101,6 +101,7 @@ class TaskSet : public TaskSetBase {
   /**
    * Wait for all currently scheduled functors to finish execution.  If exceptions are thrown
    * during execution of the set of tasks, <code>wait</code> will propagate the first exception.
+   * Memory the tasks allocated from <code>scratchArena()</code> is released before returning.
    *
    * @return true if the TaskSet was canceled, false otherwise
    **/
@@ -112,7 +113,10 @@ class TaskSet : public TaskSetBase {
    * may be cases that <code>tryWait</code> must be called multiple times with
    * <code>maxToExecute &gt 0</code> to prevent livelock/deadlock.  If exceptions have been
    * propagated since the last call to <code>wait</code> or <code>tryWait</code>,
-   * <code>tryWait</code> will propagate the first of them.
+   * <code>tryWait</code> will propagate the first of them.  If all scheduled functors have
+   * completed, memory the tasks allocated from <code>scratchArena()</code> is released before
+   * returning; otherwise it is kept until a later <code>wait</code> or successful
+   * <code>tryWait</code>.
    *
    * @param maxToExecute The maximum number of tasks to proactively execute on the current thread.
    *
@@ -213,7 +217,7 @@ class ConcurrentTaskSet : public TaskSetBase {
   void schedule(F&& f, bool skipRecheck = false) {
     if (outstandingTaskCount_.load(std::memory_order_relaxed) > taskSetLoadFactor_ &&
         DISPENSO_EXPECT(!canceled(), true)) {
-      f();
+      runInline(f);
     } else if (skipRecheck) {
       pool_.schedule(packageTask(std::forward<F>(f)), ForceQueuingTag());
     } else {
@@ -240,6 +244,7 @@ class ConcurrentTaskSet : public TaskSetBase {
   /**
    * Wait for all currently scheduled functors to finish execution.  If exceptions are thrown
    * during execution of the set of tasks, <code>wait</code> will propagate the first exception.
+   * Memory the tasks allocated from <code>scratchArena()</code> is released before returning.
    **/
   DISPENSO_DLL_ACCESS bool wait();
 
@@ -249,7 +254,10 @@ class ConcurrentTaskSet : public TaskSetBase {
    * may be cases that <code>tryWait</code> must be called multiple times with
    * <code>maxToExecute &gt 0</code> to prevent livelock/deadlock.  If exceptions have been
    * propagated since the last call to <code>wait</code> or <code>tryWait</code>,
-   * <code>tryWait</code> will propagate the first of them.
+   * <code>tryWait</code> will propagate the first of them.  If all scheduled functors have
+   * completed, memory the tasks allocated from <code>scratchArena()</code> is released before
+   * returning; otherwise it is kept until a later <code>wait</code> or successful
+   * <code>tryWait</code>.
    *
    * @param maxToExecute The maximum number of tasks to proactively execute on the current thread.
    *
@@ -6,6 +6,7 @@
  */
 
 #include <dispenso/detail/quanta.h>
+#include <dispenso/reactor.h>
 #include <dispenso/thread_pool.h>
 
 namespace dispenso {
@@ -18,6 +19,12 @@ void ThreadPool::PerThreadData::stop() {
 }
 
 uint32_t ThreadPool::wait(uint32_t currentEpoch) {
+#if defined(__linux__)
+  if (Reactor* reactor = reactor_.load(std::memory_order_acquire)) {
+    reactor->poll(sleepLengthUs_.load(std::memory_order_acquire));
+    return epochWaiter_.current();
+  }
+#endif // __linux__
   if (sleepLengthUs_ > 0) {
     return epochWaiter_.waitFor(currentEpoch, sleepLengthUs_.load(std::memory_order_acquire));
   } else {
@@ -25,9 +32,25 @@ uint32_t ThreadPool::wait(uint32_t currentEpoch) {
   }
 }
 void ThreadPool::wake() {
+#if defined(__linux__)
+  if (Reactor* reactor = reactor_.load(std::memory_order_acquire)) {
+    reactor->wake();
+    return;
+  }
+#endif // __linux__
   epochWaiter_.bumpAndWake();
 }
 
+#if defined(__linux__)
+void ThreadPool::setReactor(Reactor* reactor) {
+  std::lock_guard<std::mutex> lk(threadsMutex_);
+  ssize_t currentPoolSize = numThreads();
+  resizeLocked(0);
+  reactor_.store(reactor, std::memory_order_release);
+  resizeLocked(currentPoolSize);
+}
+#endif // __linux__
+
 inline bool ThreadPool::PerThreadData::running() {
   return running_.load(std::memory_order_acquire);
 }
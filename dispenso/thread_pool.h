@@ -62,6 +62,10 @@ constexpr bool kDefaultWakeupEnable = false;
  **/
 struct ForceQueuingTag {};
 
+#if defined(__linux__)
+class Reactor;
+#endif // __linux__
+
 /**
  * The basic executor for dispenso.  It provides typical thread pool functionality, plus allows work
  * stealing by related types (e.g. TaskSet, Future, etc...), which prevents deadlock when waiting
@@ -107,6 +111,23 @@ class alignas(kCacheLineSize) ThreadPool {
             std::chrono::duration_cast<std::chrono::microseconds>(sleepDuration).count()));
   }
 
+#if defined(__linux__)
+  /**
+   * Attach a Reactor to the pool, or detach the current one.  While attached, idle pool threads
+   * block in the reactor's <code>poll</code> instead of sleeping on the pool's futex, so readiness
+   * callbacks run directly on pool threads.  Wakeups for newly scheduled work are delivered through
+   * the reactor.  This function is blocking and potentially very slow, as with
+   * <code>setSignalingWake</code>.
+   *
+   * @param reactor The reactor to attach, or nullptr to detach.  The reactor must outlive its
+   * attachment to the pool.
+   *
+   * @note Signaling wake should usually be enabled on pools with an attached reactor, since the
+   * reactor's poll timeout is rounded up to whole milliseconds.
+   **/
+  DISPENSO_DLL_ACCESS void setReactor(Reactor* reactor);
+#endif // __linux__
+
   /**
    * Change the number of threads backing the thread pool.  This is a blocking and potentially
    * slow operation, and repeatedly resizing is discouraged.
@@ -239,6 +260,9 @@ class alignas(kCacheLineSize) ThreadPool {
   alignas(kCacheLineSize) detail::EpochWaiter epochWaiter_;
   alignas(kCacheLineSize) std::atomic<bool> enableEpochWaiter_{kDefaultWakeupEnable};
   std::atomic<uint32_t> sleepLengthUs_{kDefaultSleepLenUs};
+#if defined(__linux__)
+  std::atomic<Reactor*> reactor_{nullptr};
+#endif // __linux__
 
 #if defined DISPENSO_DEBUG
   alignas(kCacheLineSize) std::atomic<ssize_t> outstandingTaskSets_{0};
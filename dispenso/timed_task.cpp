@@ -5,15 +5,50 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <dispenso/detail/deadline_waiter.h>
 #include <dispenso/detail/quanta.h>
+#include <dispenso/detail/timed_task_queue.h>
 #include <dispenso/timed_task.h>
 
+#include <cassert>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 namespace dispenso {
 
-TimedTaskScheduler::TimedTaskScheduler(ThreadPriority prio)
-    : thread_([this, prio]() {
+namespace {
+std::unique_ptr<detail::DeadlineWaiter> makeDeadlineWaiter(
+    const TimedTaskSchedulerOptions& options) {
+  if (options.waitStrategy != TimedTaskWaitStrategy::kPrecise) {
+    return nullptr;
+  }
+  auto waiter = std::make_unique<detail::DeadlineWaiter>();
+  if (!waiter->valid()) {
+    return nullptr;
+  }
+  return waiter;
+}
+
+std::unique_ptr<detail::TimedTaskQueue> makeQueue(const TimedTaskSchedulerOptions& options) {
+  switch (options.queueType) {
+    case TimedTaskQueueType::kTimingWheel:
+      return std::make_unique<detail::TimingWheel>(options.wheelResolution, getTime());
+    case TimedTaskQueueType::kHeap:
+    default:
+      return std::make_unique<detail::TimedTaskHeap>();
+  }
+}
+} // namespace
+
+TimedTaskScheduler::TimedTaskScheduler(
+    ThreadPriority prio,
+    const TimedTaskSchedulerOptions& options)
+    : tasks_(makeQueue(options)),
+      latency_(
+          options.recordLatency ? std::make_shared<detail::TimedTaskLatency>() : nullptr),
+      deadlineWaiter_(makeDeadlineWaiter(options)),
+      thread_([this, prio]() {
         detail::registerFineSchedulerQuanta();
         if (!setCurrentThreadPriority(prio)) {
           std::cerr << "Couldn't set thread priority" << std::endl;
@@ -26,26 +61,72 @@ TimedTaskScheduler::~TimedTaskScheduler() {
     std::lock_guard<std::mutex> lk(queueMutex_);
     running_ = false;
   }
-  epoch_.bumpAndWake();
+  wake();
   thread_.join();
+
+  // Tasks left pending may be outlived by their TimedTask handles; make sure those no longer refer
+  // back to this scheduler.
+  std::vector<detail::TimedTaskImpl*> remaining;
+  {
+    std::lock_guard<std::mutex> lk(queueMutex_);
+    tasks_->drain(remaining);
+  }
+  for (auto* task : remaining) {
+    task->scheduler.store(nullptr, std::memory_order_release);
+    task->release();
+  }
 }
 
-void TimedTaskScheduler::kickOffTask(std::shared_ptr<detail::TimedTaskImpl> next, double curTime) {
-  size_t remaining = next->timesToRun.fetch_sub(1, std::memory_order_acq_rel);
-  if (remaining == 1) {
-    auto* np = next.get();
-    np->func(std::move(next));
-  } else if (remaining > 1) {
-    next->func(next);
+void TimedTaskScheduler::kickOffTask(detail::TimedTaskImpl* next, double curTime) {
+  // We own the queue's reference to next, and either hand it back to the queue or release it.
+  if (next->noOverlap && next->inProgress.load(std::memory_order_acquire)) {
+    // The previous run is still executing, so skip this one without consuming a run.  Skip any other
+    // missed periods too, rather than retrying back-to-back.
+    if (next->timesToRun.load(std::memory_order_acquire) && requeue(next, curTime, 0)) {
+      return;
+    }
+  } else {
+    size_t remaining = next->timesToRun.fetch_sub(1, std::memory_order_acq_rel);
+    if (remaining == 1) {
+      next->scheduler.store(nullptr, std::memory_order_release);
+      next->fire();
+    } else if (remaining > 1) {
+      next->fire();
+      if (requeue(next, curTime, next->maxCatchUp)) {
+        return;
+      }
+    }
+  }
+  next->scheduler.store(nullptr, std::memory_order_release);
+  next->release();
+}
 
-    if (next->steady) {
-      next->nextAbsTime += next->period;
-    } else {
-      next->nextAbsTime = curTime + next->period;
+bool TimedTaskScheduler::requeue(
+    detail::TimedTaskImpl* next,
+    double curTime,
+    size_t maxCatchUp) {
+  if (!next->steady) {
+    next->nextAbsTime = curTime + next->period;
+  } else {
+    next->nextAbsTime += next->period;
+    if (next->nextAbsTime <= curTime && next->period > 0.0) {
+      // Count the periods that are already due, and drop those beyond what may be caught up.
+      double missed = std::floor((curTime - next->nextAbsTime) / next->period) + 1.0;
+      double maxMissed = static_cast<double>(maxCatchUp);
+      if (missed > maxMissed) {
+        next->nextAbsTime += (missed - maxMissed) * next->period;
+      }
     }
-    std::lock_guard<std::mutex> lk(queueMutex_);
-    tasks_.push(std::move(next));
   }
+  std::lock_guard<std::mutex> lk(queueMutex_);
+  // Checked under the lock so that a concurrent cancel() either sees the task in the queue, or we
+  // see its flag here.
+  if (next->flags.load(std::memory_order_acquire) & detail::kFFlagsCancelled) {
+    return false;
+  }
+  next->scheduler.store(this, std::memory_order_release);
+  tasks_->push(next);
+  return true;
 }
 
 constexpr double kSmallTimeBuffer = 10e-6;
@@ -61,6 +142,7 @@ void TimedTaskScheduler::timeQueueRunLoop() {
   constexpr double kConvertToUs = 1e6;
 
   uint32_t curEpoch = epoch_.current();
+  std::vector<detail::TimedTaskImpl*> expired;
 
   while (true) {
     {
@@ -72,22 +154,47 @@ void TimedTaskScheduler::timeQueueRunLoop() {
       if (!running_) {
         break;
       }
-      if (tasks_.empty()) {
+      if (tasks_->empty()) {
         lk.unlock();
-        curEpoch = epoch_.wait(curEpoch);
+        if (deadlineWaiter_) {
+          deadlineWaiter_->waitUntil(std::numeric_limits<double>::infinity());
+        } else {
+          curEpoch = epoch_.wait(curEpoch);
+        }
         continue;
       }
     }
     double curTime = getTime();
     double timeRemaining;
     std::unique_lock<std::mutex> lk(queueMutex_);
-    timeRemaining = tasks_.top()->nextAbsTime - curTime;
+    timeRemaining = tasks_->nextExpiry() - curTime;
     if (timeRemaining < kSmallTimeBuffer) {
-      auto next = tasks_.top();
-      tasks_.pop();
+      tasks_->popExpired(curTime + kSmallTimeBuffer, expired);
+      for (auto* next : expired) {
+        double lateness = curTime - next->nextAbsTime;
+        ++numFired_;
+        latenessSum_ += lateness;
+        latenessSumSq_ += lateness * lateness;
+        maxLateness_ = std::max(maxLateness_, lateness);
+        next->recordDispatch(lateness);
+      }
       lk.unlock();
 
-      kickOffTask(std::move(next), curTime);
+      for (auto* next : expired) {
+        kickOffTask(next, curTime);
+      }
+      expired.clear();
+    } else if (deadlineWaiter_ && !tasks_->nextExpiryWantsSpin()) {
+      // Sleep precisely until the next task is due.  Wakes for newly scheduled tasks are delivered
+      // to both waiters, so the epoch need not be tracked here.
+      double deadline = curTime + timeRemaining;
+      lk.unlock();
+      deadlineWaiter_->waitUntil(deadline);
+      curEpoch = epoch_.current();
+    } else if (!tasks_->nextExpiryIsExact()) {
+      // The next task can tolerate some lateness, so simply sleep until it is due.
+      lk.unlock();
+      curEpoch = epoch_.waitFor(curEpoch, static_cast<uint64_t>(timeRemaining * kConvertToUs));
     } else if (timeRemaining < kSpinBuffer) {
       continue;
     } else if (timeRemaining < kSpinYieldBuffer) {
@@ -102,17 +209,97 @@ void TimedTaskScheduler::timeQueueRunLoop() {
   }
 }
 
-void TimedTaskScheduler::addTimedTask(std::shared_ptr<detail::TimedTaskImpl> task) {
+void TimedTaskScheduler::addTimedTask(detail::TimedTaskImpl* task) {
+  // The reference held on behalf of the queue.
+  task->acquire();
+  if (latency_) {
+    task->schedulerLatency = latency_;
+  }
   double curTime = getTime();
   double timeRemaining;
   timeRemaining = task->nextAbsTime - curTime;
   if (timeRemaining < kSmallTimeBuffer) {
-    kickOffTask(std::move(task), curTime);
+    kickOffTask(task, curTime);
   } else {
     std::lock_guard<std::mutex> lk(queueMutex_);
-    tasks_.push(std::move(task));
+    // The scheduler thread only needs waking if it would otherwise sleep past this task.
+    bool wake = task->latestTime() < tasks_->nextExpiry();
+    task->scheduler.store(this, std::memory_order_release);
+    tasks_->push(task);
+    if (!wake) {
+      return;
+    }
   }
+  wake();
+}
+
+void TimedTaskScheduler::wake() {
   epoch_.bumpAndWake();
+  if (deadlineWaiter_) {
+    deadlineWaiter_->wake();
+  }
+}
+
+void TimedTaskScheduler::removeTimedTask(detail::TimedTaskImpl* task) {
+  {
+    std::lock_guard<std::mutex> lk(queueMutex_);
+    if (!tasks_->remove(task)) {
+      return;
+    }
+  }
+  task->scheduler.store(nullptr, std::memory_order_release);
+  task->release();
+}
+
+namespace {
+TimedTaskSchedulerStats makeStats(size_t count, double sum, double sumSq, double maxLateness) {
+  TimedTaskSchedulerStats stats;
+  stats.numFired = count;
+  if (count) {
+    double n = static_cast<double>(count);
+    stats.meanLateness = sum / n;
+    stats.jitter = std::sqrt(std::max(0.0, sumSq / n - stats.meanLateness * stats.meanLateness));
+    stats.maxLateness = maxLateness;
+  }
+  return stats;
+}
+} // namespace
+
+TimedTaskSchedulerStats TimedTaskScheduler::stats() const {
+  std::lock_guard<std::mutex> lk(queueMutex_);
+  return makeStats(numFired_, latenessSum_, latenessSumSq_, maxLateness_);
+}
+
+ShardedTimedTaskScheduler::ShardedTimedTaskScheduler(
+    size_t numShards,
+    ThreadPriority priority,
+    const TimedTaskSchedulerOptions& options) {
+  assert(numShards > 0);
+  shards_.reserve(numShards);
+  for (size_t i = 0; i < numShards; ++i) {
+    shards_.push_back(std::make_unique<TimedTaskScheduler>(priority, options));
+  }
+}
+
+void ShardedTimedTaskScheduler::setPriority(ThreadPriority priority) {
+  for (auto& shard : shards_) {
+    shard->setPriority(priority);
+  }
+}
+
+TimedTaskSchedulerStats ShardedTimedTaskScheduler::stats() const {
+  size_t count = 0;
+  double sum = 0.0;
+  double sumSq = 0.0;
+  double maxLateness = 0.0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lk(shard->queueMutex_);
+    count += shard->numFired_;
+    sum += shard->latenessSum_;
+    sumSq += shard->latenessSumSq_;
+    maxLateness = std::max(maxLateness, shard->maxLateness_);
+  }
+  return makeStats(count, sum, sumSq, maxLateness);
 }
 
 TimedTaskScheduler& globalTimedTaskScheduler() {
@@ -11,16 +11,22 @@
 
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <memory>
-#include <queue>
+#include <vector>
 
 #include <dispenso/detail/timed_task_impl.h>
 #include <dispenso/priority.h>
+#include <dispenso/thread_id.h>
 #include <dispenso/timing.h>
 
 namespace dispenso {
+namespace detail {
+class DeadlineWaiter;
+class TimedTaskQueue;
+} // namespace detail
 
 /**
  * For periodic tasks, this type will describe the behavior of how tasks are scheduled
@@ -32,6 +38,118 @@ enum class TimedTaskType {
           ///< scheduled for
 };
 
+/**
+ * For kSteady periodic tasks, what to do about periods that were missed, e.g. because the
+ * scheduler or the backing schedulable stalled.
+ **/
+enum class TimedTaskMissedRunPolicy {
+  kCatchUp ///< Run once for every missed period, back-to-back, until caught up
+  ,
+  kSkip ///< Drop the missed periods, and run next at the first period boundary in the future
+  ,
+  kCatchUpLimited ///< Run back-to-back for at most TimedTaskOptions::maxCatchUp missed periods,
+                  ///< dropping any others
+};
+
+/**
+ * Optional per-task scheduling parameters.
+ **/
+struct TimedTaskOptions {
+  /**
+   * How late, in seconds, the task may run past its scheduled time.  The scheduler uses this window
+   * to run tasks whose windows overlap in a single wakeup, reducing wakeups when many timers are due
+   * close together.  Only tasks with zero slack cause the scheduler to spin as their time
+   * approaches; others are waited for by sleeping.
+   **/
+  double slack = 0.0;
+  /**
+   * Whether the scheduler should spin as this task's time approaches when the scheduler uses
+   * TimedTaskWaitStrategy::kPrecise.  Spinning occupies a core but can shave the last few
+   * microseconds of wakeup latency, so reserve it for deadline-critical tasks.  Ignored for tasks
+   * with slack, and for schedulers using kSpin, which spin for all tasks without slack.
+   **/
+  bool spin = false;
+  /**
+   * Whether to record histograms of this task's firing latency, retrievable through
+   * TimedTask::dispatchLatency() and TimedTask::startLatency().
+   **/
+  bool recordLatency = false;
+  /**
+   * How a kSteady periodic task handles missed periods.  kNormal tasks are always scheduled a full
+   * period after they last ran, so never fall behind.  Missed periods that are dropped do not count
+   * against the task's number of runs.
+   **/
+  TimedTaskMissedRunPolicy missedRunPolicy = TimedTaskMissedRunPolicy::kCatchUp;
+  /**
+   * The number of missed periods to run when missedRunPolicy is kCatchUpLimited.
+   **/
+  size_t maxCatchUp = 1;
+  /**
+   * If true, a periodic run that comes due while the previous run is still executing is skipped,
+   * and the task is tried again one period later, so that a slow task cannot pile up runs in the
+   * backing schedulable.  Skipped runs do not count against the task's number of runs.
+   **/
+  bool noOverlap = false;
+};
+
+/**
+ * The container a TimedTaskScheduler uses to hold pending tasks.
+ **/
+enum class TimedTaskQueueType {
+  kHeap ///< A binary heap.  Insertion is O(log n), and tasks fire as close as possible to their
+        ///< scheduled time.
+  ,
+  kTimingWheel ///< A hierarchical timing wheel.  Insertion and cancellation are O(1), and all tasks
+               ///< due within the same tick are fired as a batch, but tasks may fire up to one
+               ///< tick late.  Suited to very large numbers of pending, mostly cancelled, timeouts.
+};
+
+/**
+ * How a TimedTaskScheduler's thread waits for the next task to come due.
+ **/
+enum class TimedTaskWaitStrategy {
+  kSpin ///< Sleep until shortly before the deadline, then yield and finally busy-spin.  Accurate
+        ///< everywhere, but keeps a core busy as each task without slack comes due.
+  ,
+  kPrecise ///< Sleep until the deadline on a high-resolution timer, spinning only for tasks that
+           ///< request it via TimedTaskOptions::spin.  Tasks typically fire within tens of
+           ///< microseconds.  Uses timerfd on Linux; elsewhere this behaves as kSpin.
+};
+
+/**
+ * Options to configure a TimedTaskScheduler.
+ **/
+struct TimedTaskSchedulerOptions {
+  /**
+   * The container used to hold pending tasks.
+   **/
+  TimedTaskQueueType queueType = TimedTaskQueueType::kHeap;
+  /**
+   * The tick length in seconds when queueType is kTimingWheel.  Ignored for kHeap.
+   **/
+  double wheelResolution = 1e-3;
+  /**
+   * How the scheduler thread waits for tasks to come due.
+   **/
+  TimedTaskWaitStrategy waitStrategy = TimedTaskWaitStrategy::kSpin;
+  /**
+   * Whether to record histograms of firing latency over all tasks, retrievable through
+   * TimedTaskScheduler::dispatchLatency() and TimedTaskScheduler::startLatency().
+   **/
+  bool recordLatency = false;
+};
+
+/**
+ * Summary statistics describing how late a TimedTaskScheduler has dispatched tasks relative to
+ * their scheduled times.
+ **/
+struct TimedTaskSchedulerStats {
+  size_t numFired = 0; ///< The number of task runs dispatched from the scheduler's queue.
+  double meanLateness = 0.0; ///< The mean time in seconds from scheduled time to dispatch.
+  double jitter = 0.0; ///< The standard deviation of lateness in seconds.
+  double maxLateness = 0.0; ///< The worst lateness observed, in seconds.
+};
+
 /**
  * A timed task type.  This encapsulates a function that will run at a time scheduled in the future,
  * and optionally periodically for a specified number of times.
@@ -40,22 +158,28 @@ enum class TimedTaskType {
 class TimedTask {
  public:
   TimedTask(const TimedTask&) = delete;
-  TimedTask(TimedTask&& other) : impl_(std::move(other.impl_)) {}
+  TimedTask(TimedTask&& other) : impl_(other.impl_) {
+    other.impl_ = nullptr;
+  }
 
   TimedTask& operator=(const TimedTask&) = delete;
   TimedTask& operator=(TimedTask&& other) {
-    impl_ = std::move(other.impl_);
+    if (&other != this) {
+      if (impl_) {
+        impl_->release();
+      }
+      impl_ = other.impl_;
+      other.impl_ = nullptr;
+    }
     return *this;
   }
 
   /**
    * Cancel the task.  No further runs to the underlying function will occur (though any calls in
-   * progress will complete).
+   * progress will complete).  The task is also unlinked from the scheduler's queue immediately, so
+   * that its function and captured state are released without waiting for it to come due.
    **/
-  void cancel() {
-    impl_->timesToRun.store(0, std::memory_order_release);
-    impl_->flags.fetch_or(detail::kFFlagsCancelled, std::memory_order_release);
-  }
+  void cancel();
 
   /**
    * Detach this task so that it cannot block in destruction, and destruction does not cancel
@@ -75,6 +199,29 @@ class TimedTask {
     return impl_->count.load(std::memory_order_acquire);
   }
 
+  /**
+   * Get the distribution of how late runs of this task were handed to the backing schedulable,
+   * relative to the times they were scheduled for.  Runs that were already due when scheduled are
+   * not included.
+   *
+   * @return A histogram snapshot, which is empty unless the task was scheduled with
+   * TimedTaskOptions::recordLatency.
+   **/
+  LatencyHistogram::Snapshot dispatchLatency() const {
+    return impl_->latency ? impl_->latency->dispatch.snapshot() : LatencyHistogram::Snapshot();
+  }
+
+  /**
+   * Get the distribution of how late runs of this task began executing, relative to the times they
+   * were scheduled for.  This includes time spent queued in the backing schedulable.
+   *
+   * @return A histogram snapshot, which is empty unless the task was scheduled with
+   * TimedTaskOptions::recordLatency.
+   **/
+  LatencyHistogram::Snapshot startLatency() const {
+    return impl_->latency ? impl_->latency->start.snapshot() : LatencyHistogram::Snapshot();
+  }
+
   /**
    * Destroy the timed task.  If detach() has not been called, this will cancel further calls to the
    * underlying scheduled function, and will wait if necessary until the function is no longer in
@@ -83,16 +230,19 @@ class TimedTask {
    *
    **/
   ~TimedTask() {
-    if (!impl_ || impl_->flags.load(std::memory_order_acquire) & detail::kFFlagsDetached) {
+    if (!impl_) {
       return;
     }
-    cancel();
-    while (impl_->inProgress.load(std::memory_order_acquire)) {
+    if (!(impl_->flags.load(std::memory_order_acquire) & detail::kFFlagsDetached)) {
+      cancel();
+      while (impl_->inProgress.load(std::memory_order_seq_cst)) {
+      }
+      // Now we can safely destroy the underlying function.  We do this here because we can't risk
+      // that func may call code in it's destructor that may no longer be relevant after this
+      // TimedTask destructor completes.
+      impl_->destroyFunc();
     }
-    // Now we can safely destroy the underlying function.  We do this here because we can't risk
-    // that func may call code in it's destructor that may no longer be relevant after this
-    // TimedTask destructor completes.
-    impl_->func = {};
+    impl_->release();
   }
 
  private:
@@ -103,16 +253,35 @@ class TimedTask {
       double nextRunAbs,
       double period = 0.0,
       size_t timesToRun = 1,
-      TimedTaskType type = TimedTaskType::kNormal)
-      : impl_(detail::make_shared<detail::TimedTaskImpl>(
+      TimedTaskType type = TimedTaskType::kNormal,
+      const TimedTaskOptions& options = {})
+      : impl_(detail::createTimedTaskImpl(
+            sched,
+            std::forward<F>(f),
             timesToRun,
             nextRunAbs,
             period,
-            std::forward<F>(f),
-            sched,
-            type == TimedTaskType::kSteady)) {}
+            type == TimedTaskType::kSteady)) {
+    impl_->slack = std::max(options.slack, 0.0);
+    impl_->spin = options.spin;
+    impl_->noOverlap = options.noOverlap;
+    switch (options.missedRunPolicy) {
+      case TimedTaskMissedRunPolicy::kSkip:
+        impl_->maxCatchUp = 0;
+        break;
+      case TimedTaskMissedRunPolicy::kCatchUpLimited:
+        impl_->maxCatchUp = options.maxCatchUp;
+        break;
+      case TimedTaskMissedRunPolicy::kCatchUp:
+      default:
+        break;
+    }
+    if (options.recordLatency) {
+      impl_->latency = std::make_unique<detail::TimedTaskLatency>();
+    }
+  }
 
-  std::shared_ptr<detail::TimedTaskImpl> impl_;
+  detail::TimedTaskImpl* impl_;
 
   friend class TimedTaskScheduler;
 }; // namespace dispenso
@@ -132,9 +301,11 @@ class TimedTaskScheduler {
    * @note Priorities above kNormal should be used sparingly, and only short-running tasks should be
    * run inline to avoid bad OS responsivity.  When using a ThreadPool Schedulable, tasks can be
    * long running.
+   * @param options Options controlling how pending tasks are held.
    **/
   DISPENSO_DLL_ACCESS explicit TimedTaskScheduler(
-      ThreadPriority priority = ThreadPriority::kNormal);
+      ThreadPriority priority = ThreadPriority::kNormal,
+      const TimedTaskSchedulerOptions& options = {});
   DISPENSO_DLL_ACCESS ~TimedTaskScheduler();
 
   /**
@@ -145,6 +316,37 @@ class TimedTaskScheduler {
     priority_ = priority;
   }
 
+  /**
+   * Get statistics on how late tasks have been dispatched by this scheduler.  Tasks that are
+   * already due when scheduled are run immediately and are not included.
+   *
+   * @return A snapshot of the statistics accumulated since the scheduler was created.
+   **/
+  DISPENSO_DLL_ACCESS TimedTaskSchedulerStats stats() const;
+
+  /**
+   * Get the distribution of how late all tasks were handed to their backing schedulables, relative
+   * to the times they were scheduled for.  Runs that were already due when scheduled are not
+   * included.
+   *
+   * @return A histogram snapshot, which is empty unless the scheduler was created with
+   * TimedTaskSchedulerOptions::recordLatency.
+   **/
+  LatencyHistogram::Snapshot dispatchLatency() const {
+    return latency_ ? latency_->dispatch.snapshot() : LatencyHistogram::Snapshot();
+  }
+
+  /**
+   * Get the distribution of how late all tasks began executing, relative to the times they were
+   * scheduled for.  This includes time spent queued in the backing schedulables.
+   *
+   * @return A histogram snapshot, which is empty unless the scheduler was created with
+   * TimedTaskSchedulerOptions::recordLatency.
+   **/
+  LatencyHistogram::Snapshot startLatency() const {
+    return latency_ ? latency_->start.snapshot() : LatencyHistogram::Snapshot();
+  }
+
   /**
    * Schedule a task
    *
@@ -158,6 +360,7 @@ class TimedTaskScheduler {
    * @param timesToRun The number of times to run the function.  After that number, the function
    *        will not be called again.
    * @param type The type of periodicity (if any).
+   * @param options Additional per-task parameters, such as slack.
    **/
   template <typename Schedulable, typename F>
   TimedTask schedule(
@@ -166,8 +369,9 @@ class TimedTaskScheduler {
       double nextRunAbs,
       double period = 0.0,
       size_t timesToRun = 1,
-      TimedTaskType type = TimedTaskType::kNormal) {
-    TimedTask task(sched, std::forward<F>(func), nextRunAbs, period, timesToRun, type);
+      TimedTaskType type = TimedTaskType::kNormal,
+      const TimedTaskOptions& options = {}) {
+    TimedTask task(sched, std::forward<F>(func), nextRunAbs, period, timesToRun, type, options);
     addTimedTask(task.impl_);
     return task;
   }
@@ -180,11 +384,22 @@ class TimedTaskScheduler {
    * @param func A bool() function to run when scheduled.  The function may return true to indicate
    *        it should continue to be scheduled, or false to cancel.
    * @param timeInFuture the amount of time from current at which to schedule the function
+   * @param options Additional per-task parameters, such as slack.
    **/
   template <typename Schedulable, typename Rep, typename Period, typename F>
-  TimedTask
-  schedule(Schedulable& sched, F&& func, const std::chrono::duration<Rep, Period>& timeInFuture) {
-    return schedule(sched, std::forward<F>(func), toNextRun(timeInFuture));
+  TimedTask schedule(
+      Schedulable& sched,
+      F&& func,
+      const std::chrono::duration<Rep, Period>& timeInFuture,
+      const TimedTaskOptions& options = {}) {
+    return schedule(
+        sched,
+        std::forward<F>(func),
+        toNextRun(timeInFuture),
+        0.0,
+        1,
+        TimedTaskType::kNormal,
+        options);
   }
 
   /**
@@ -196,13 +411,22 @@ class TimedTaskScheduler {
    *        it should continue to be scheduled, or false to cancel.
    * @param nextRunTime An absolute time to run the function.  If in the past, func will run
    *        immediately.
+   * @param options Additional per-task parameters, such as slack.
    **/
   template <typename Schedulable, typename Clock, typename Duration, typename F>
   TimedTask schedule(
       Schedulable& sched,
       F&& func,
-      const std::chrono::time_point<Clock, Duration>& nextRunTime) {
-    return schedule(sched, std::forward<F>(func), toNextRun(nextRunTime));
+      const std::chrono::time_point<Clock, Duration>& nextRunTime,
+      const TimedTaskOptions& options = {}) {
+    return schedule(
+        sched,
+        std::forward<F>(func),
+        toNextRun(nextRunTime),
+        0.0,
+        1,
+        TimedTaskType::kNormal,
+        options);
   }
 
   /**
@@ -217,6 +441,7 @@ class TimedTaskScheduler {
    * @param timesToRun The number of times to run the function.  After that number, the function
    *        will not be called again.
    * @param type The type of periodicity (if any).
+   * @param options Additional per-task parameters, such as slack.
    **/
   template <typename Schedulable, typename Rep, typename Period, typename F>
   TimedTask schedule(
@@ -225,9 +450,16 @@ class TimedTaskScheduler {
       const std::chrono::duration<Rep, Period>& timeInFuture,
       const std::chrono::duration<Rep, Period>& period,
       size_t timesToRun = std::numeric_limits<size_t>::max(),
-      TimedTaskType type = TimedTaskType::kNormal) {
+      TimedTaskType type = TimedTaskType::kNormal,
+      const TimedTaskOptions& options = {}) {
     return schedule(
-        sched, std::forward<F>(func), toNextRun(timeInFuture), toPeriod(period), timesToRun, type);
+        sched,
+        std::forward<F>(func),
+        toNextRun(timeInFuture),
+        toPeriod(period),
+        timesToRun,
+        type,
+        options);
   }
 
   /**
@@ -243,6 +475,7 @@ class TimedTaskScheduler {
    * @param timesToRun The number of times to run the function.  After that number, the function
    *        will not be called again.
    * @param type The type of periodicity (if any).
+   * @param options Additional per-task parameters, such as slack.
    **/
   template <
       typename Schedulable,
@@ -257,9 +490,16 @@ class TimedTaskScheduler {
       const std::chrono::time_point<Clock, Duration>& nextRunTime,
       const std::chrono::duration<Rep, Period>& period,
       size_t timesToRun = std::numeric_limits<size_t>::max(),
-      TimedTaskType type = TimedTaskType::kNormal) {
+      TimedTaskType type = TimedTaskType::kNormal,
+      const TimedTaskOptions& options = {}) {
     return schedule(
-        sched, std::forward<F>(func), toNextRun(nextRunTime), toPeriod(period), timesToRun, type);
+        sched,
+        std::forward<F>(func),
+        toNextRun(nextRunTime),
+        toPeriod(period),
+        timesToRun,
+        type,
+        options);
   }
 
  private:
@@ -278,31 +518,124 @@ class TimedTaskScheduler {
   static double toPeriod(const std::chrono::duration<Rep, Period>& period) {
     return std::chrono::duration<double>(period).count();
   }
-  DISPENSO_DLL_ACCESS void addTimedTask(std::shared_ptr<detail::TimedTaskImpl> task);
+  DISPENSO_DLL_ACCESS void addTimedTask(detail::TimedTaskImpl* task);
+  DISPENSO_DLL_ACCESS void removeTimedTask(detail::TimedTaskImpl* task);
   void timeQueueRunLoop();
 
-  void kickOffTask(std::shared_ptr<detail::TimedTaskImpl> next, double curTime);
+  void kickOffTask(detail::TimedTaskImpl* next, double curTime);
+  bool requeue(detail::TimedTaskImpl* next, double curTime, size_t maxCatchUp);
+  void wake();
 
-  struct Compare {
-    bool operator()(
-        const std::shared_ptr<detail::TimedTaskImpl>& a,
-        const std::shared_ptr<detail::TimedTaskImpl>& b) const {
-      return a->nextAbsTime > b->nextAbsTime;
-    }
-  };
-
-  // TODO(bbudge): Consider lock-free priority queue implementation.  I'd expect it to be minimally
-  // beneficial for this use case though... timed tasks should rarely be super-high contention.
-  std::mutex queueMutex_;
-  std::priority_queue<
-      std::shared_ptr<detail::TimedTaskImpl>,
-      std::vector<std::shared_ptr<detail::TimedTaskImpl>>,
-      Compare>
-      tasks_;
+  mutable std::mutex queueMutex_;
+  std::unique_ptr<detail::TimedTaskQueue> tasks_;
+  // Lateness accumulators, guarded by queueMutex_.
+  size_t numFired_{0};
+  double latenessSum_{0.0};
+  double latenessSumSq_{0.0};
+  double maxLateness_{0.0};
+  // Non-null when recording latency histograms.
+  std::shared_ptr<detail::TimedTaskLatency> latency_;
   bool running_{true};
   detail::EpochWaiter epoch_;
+  // Non-null when waiting with TimedTaskWaitStrategy::kPrecise.
+  std::unique_ptr<detail::DeadlineWaiter> deadlineWaiter_;
   std::thread thread_;
   ThreadPriority priority_;
+
+  friend class TimedTask;
+  friend class ShardedTimedTaskScheduler;
+};
+
+inline void TimedTask::cancel() {
+  impl_->timesToRun.store(0, std::memory_order_release);
+  impl_->flags.fetch_or(detail::kFFlagsCancelled, std::memory_order_seq_cst);
+  auto* scheduler = impl_->scheduler.load(std::memory_order_acquire);
+  if (scheduler) {
+    scheduler->removeTimedTask(impl_);
+  }
+}
+
+/**
+ * A set of independent TimedTaskSchedulers, or shards, each with its own queue and thread.  When
+ * many threads schedule timed tasks at high rates, a single scheduler's queue lock becomes
+ * contended and its one thread limits dispatch throughput.  Spreading tasks across shards avoids
+ * both.  By default, tasks are placed on a shard chosen by the calling thread, so that a given
+ * producer thread always uses the same shard; alternatively a shard can be chosen by key.
+ *
+ * Each shard fires its tasks independently, and keeps its own lateness statistics.
+ **/
+class ShardedTimedTaskScheduler {
+ public:
+  /**
+   * Create a ShardedTimedTaskScheduler.
+   *
+   * @param numShards The number of shards, each of which owns a thread.  Must be at least one.
+   * @param priority The priority of each shard's thread.
+   * @param options Options applied to every shard.
+   **/
+  DISPENSO_DLL_ACCESS explicit ShardedTimedTaskScheduler(
+      size_t numShards,
+      ThreadPriority priority = ThreadPriority::kNormal,
+      const TimedTaskSchedulerOptions& options = {});
+
+  /**
+   * Get the number of shards.
+   **/
+  size_t numShards() const {
+    return shards_.size();
+  }
+
+  /**
+   * Access a shard directly.
+   *
+   * @param index The index of the shard, in [0, numShards()).
+   **/
+  TimedTaskScheduler& shard(size_t index) {
+    return *shards_[index];
+  }
+
+  /**
+   * Access the shard associated with a key, e.g. a hash of the object a timer belongs to.
+   **/
+  TimedTaskScheduler& shardFor(size_t key) {
+    return *shards_[key % shards_.size()];
+  }
+
+  /**
+   * Access the shard used by the calling thread.
+   **/
+  TimedTaskScheduler& shardForCurrentThread() {
+    return shardFor(static_cast<size_t>(threadId()));
+  }
+
+  /**
+   * Set the priority of all shards' threads.
+   **/
+  DISPENSO_DLL_ACCESS void setPriority(ThreadPriority priority);
+
+  /**
+   * Schedule a task on the calling thread's shard.  Accepts any of the argument lists of
+   * TimedTaskScheduler::schedule.
+   **/
+  template <typename... Args>
+  TimedTask schedule(Args&&... args) {
+    return shardForCurrentThread().schedule(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Get statistics for a single shard.
+   **/
+  TimedTaskSchedulerStats stats(size_t index) const {
+    return shards_[index]->stats();
+  }
+
+  /**
+   * Get statistics combined over all shards.
+   **/
+  DISPENSO_DLL_ACCESS TimedTaskSchedulerStats stats() const;
+
+ private:
+  std::vector<std::unique_ptr<TimedTaskScheduler>> shards_;
 };
 
 /**
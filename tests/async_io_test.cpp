@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/async_io.h>
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <dispenso/parallel_for.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+class TempFile {
+ public:
+  TempFile() {
+    char name[] = "/tmp/dispenso_async_io_XXXXXX";
+    fd_ = ::mkstemp(name);
+    EXPECT_GE(fd_, 0);
+    ::unlink(name);
+  }
+  ~TempFile() {
+    ::close(fd_);
+  }
+  int fd() const {
+    return fd_;
+  }
+
+ private:
+  int fd_;
+};
+
+using ReadFunc = dispenso::Future<size_t> (*)(int, uint64_t, void*, size_t);
+using WriteFunc = dispenso::Future<size_t> (*)(int, uint64_t, const void*, size_t);
+
+void writeThenRead(ReadFunc readFn, WriteFunc writeFn) {
+  TempFile file;
+  std::vector<char> out(1 << 16);
+  std::iota(out.begin(), out.end(), static_cast<char>(0));
+
+  EXPECT_EQ(writeFn(file.fd(), 0, out.data(), out.size()).get(), out.size());
+
+  std::vector<char> in(out.size());
+  EXPECT_EQ(readFn(file.fd(), 0, in.data(), in.size()).get(), in.size());
+  EXPECT_EQ(in, out);
+
+  // Reads past the end of the file are short, just like pread.
+  EXPECT_EQ(readFn(file.fd(), out.size() - 10, in.data(), in.size()).get(), 10);
+  EXPECT_EQ(readFn(file.fd(), out.size() + 10, in.data(), in.size()).get(), 0);
+}
+} // namespace
+
+TEST(AsyncIo, WriteThenRead) {
+  writeThenRead(dispenso::io::readAsync, dispenso::io::writeAsync);
+}
+
+TEST(AsyncIo, WriteThenReadFallback) {
+  writeThenRead(dispenso::detail::readAsyncFallback, dispenso::detail::writeAsyncFallback);
+}
+
+TEST(AsyncIo, ManyConcurrentReads) {
+  TempFile file;
+  constexpr size_t kBlock = 512;
+  constexpr size_t kNumBlocks = 1024;
+  std::vector<uint32_t> out(kBlock * kNumBlocks / sizeof(uint32_t));
+  std::iota(out.begin(), out.end(), 0u);
+  ASSERT_EQ(
+      dispenso::io::writeAsync(file.fd(), 0, out.data(), out.size() * sizeof(uint32_t)).get(),
+      out.size() * sizeof(uint32_t));
+
+  std::vector<uint32_t> in(out.size());
+  std::vector<dispenso::Future<size_t>> reads(kNumBlocks);
+  // Issue reads from pool threads, as is typical of the intended use.
+  dispenso::parallel_for(0, kNumBlocks, [&](size_t i) {
+    reads[i] = dispenso::io::readAsync(
+        file.fd(), i * kBlock, reinterpret_cast<char*>(in.data()) + i * kBlock, kBlock);
+  });
+  for (auto& r : reads) {
+    EXPECT_EQ(r.get(), kBlock);
+  }
+  EXPECT_EQ(in, out);
+}
+
+TEST(AsyncIo, Then) {
+  TempFile file;
+  std::string msg = "hello dispenso";
+  std::string in(msg.size(), '\0');
+  auto done = dispenso::io::writeAsync(file.fd(), 0, msg.data(), msg.size())
+                  .then([&](dispenso::Future<size_t>&& w) {
+                    return dispenso::io::readAsync(file.fd(), 0, &in[0], w.get()).get();
+                  });
+  EXPECT_EQ(done.get(), msg.size());
+  EXPECT_EQ(in, msg);
+}
+
+#if defined(__cpp_exceptions)
+TEST(AsyncIo, BadFd) {
+  char buf[16];
+  EXPECT_THROW(dispenso::io::readAsync(-1, 0, buf, sizeof(buf)).get(), std::system_error);
+  EXPECT_THROW(
+      dispenso::detail::readAsyncFallback(-1, 0, buf, sizeof(buf)).get(), std::system_error);
+}
+#endif // __cpp_exceptions
+
+#endif // !_WIN32
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/backing_store.h>
+
+#include <algorithm>
+
+#include <dispenso/pool_allocator.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+dispenso::BackingStoreOptions makeOptions(bool hugePages, bool numaLocal) {
+  dispenso::BackingStoreOptions options;
+  options.hugePages = hugePages;
+  options.numaLocal = numaLocal;
+  return options;
+}
+} // namespace
+
+TEST(BackingStore, AllocFree) {
+  for (bool hugePages : {false, true}) {
+    for (bool numaLocal : {false, true}) {
+      auto options = makeOptions(hugePages, numaLocal);
+      for (size_t bytes : {size_t{100}, size_t{1} << 16, (size_t{3} << 20) + 5}) {
+        for (size_t alignment : {size_t{64}, size_t{4096}, size_t{1} << 16}) {
+          char* p = reinterpret_cast<char*>(dispenso::backingStoreAlloc(bytes, alignment, options));
+          ASSERT_NE(p, nullptr);
+          EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignment, 0);
+#if defined(__linux__)
+          if (hugePages) {
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % dispenso::kHugePageSize, 0);
+          }
+#endif // __linux__
+          std::fill_n(p, bytes, 'x');
+          EXPECT_EQ(p[bytes - 1], 'x');
+          dispenso::backingStoreFree(p, bytes, options);
+        }
+      }
+    }
+  }
+}
+
+TEST(BackingStore, PoolAllocator) {
+  dispenso::PoolAllocator allocator(
+      256, dispenso::kHugePageSize, makeOptions(true, true), /*threadCacheChunks=*/8);
+  std::vector<char*> chunks(20000);
+  for (char*& c : chunks) {
+    c = allocator.alloc();
+    std::fill_n(c, 256, 'a');
+  }
+  EXPECT_EQ(allocator.totalChunkCapacity(), 3 * dispenso::kHugePageSize / 256);
+  for (char* c : chunks) {
+    EXPECT_EQ(c[255], 'a');
+    allocator.dealloc(c);
+  }
+}
+
+TEST(BackingStore, CurrentNumaNode) {
+  // Nodes are small integers; this mostly checks that the query does not fail.
+  EXPECT_LT(dispenso::currentNumaNode(), 1u << 16);
+}
@@ -107,3 +107,46 @@ TEST(ConcurrentObjectArena, ObjectsConstuction) {
     EXPECT_EQ(moveArena.getBuffer(i), bufferPtrs[i]);
   }
 }
+
+TEST(ConcurrentObjectArena, ParallelGrowAcrossManyBuffers) {
+  constexpr uint32_t numTasks = 16;
+  constexpr uint32_t numLoops = 50;
+  constexpr uint32_t bufSize = 4;
+
+  // Deltas spanning several buffers at once exercise concurrent installation of buffers and
+  // directory segments.
+  dispenso::ConcurrentObjectArena<uint32_t, uint32_t> arena(bufSize);
+
+  dispenso::TaskSet taskSet(dispenso::globalThreadPool());
+  for (uint32_t ti = 0; ti < numTasks; ++ti) {
+    taskSet.schedule([ti, &arena]() {
+      for (uint32_t i = 0; i < numLoops; ++i) {
+        const uint32_t delta = 1 + (ti * 7 + i * 13) % 37;
+        const uint32_t p = arena.grow_by(delta);
+        for (uint32_t j = 0; j < delta; ++j) {
+          arena[p + j] = p;
+        }
+      }
+    });
+  }
+  taskSet.wait();
+
+  EXPECT_EQ(arena.capacity(), arena.numBuffers() * bufSize);
+  EXPECT_GT(arena.capacity(), arena.size());
+  uint32_t totalSize = 0;
+  for (uint32_t i = 0; i < arena.numBuffers(); ++i) {
+    EXPECT_NE(arena.getBuffer(i), nullptr);
+    totalSize += arena.getBufferSize(i);
+  }
+  EXPECT_EQ(totalSize, arena.size());
+
+  // Each group records its own start index, so a group's elements must be contiguous.
+  uint32_t i = 0;
+  while (i < arena.size()) {
+    const uint32_t start = arena[i];
+    ASSERT_EQ(start, i);
+    while (i < arena.size() && arena[i] == start) {
+      ++i;
+    }
+  }
+}
@@ -1465,3 +1465,163 @@ TYPED_TEST(ConcurrentVectorTest, OtherConstructorsTest) {
     EXPECT_EQ(cv, v++);
   }
 }
+
+template <typename CVec>
+void forEachSpanCorrect(int num, CVec& vec) {
+  for (int i = 0; i < num; ++i) {
+    vec.push_back(i);
+  }
+
+  int next = 0;
+  vec.forEachSpan([&next](int* b, int* e) {
+    EXPECT_LT(b, e);
+    for (int* p = b; p != e; ++p) {
+      EXPECT_EQ(*p, next++);
+    }
+  });
+  EXPECT_EQ(next, num);
+
+  const auto& cvec = vec;
+  size_t start = vec.size() / 3;
+  size_t end = vec.size() - vec.size() / 5;
+  next = static_cast<int>(start);
+  cvec.forEachSpan(start, end, [&next](const int* b, const int* e) {
+    for (const int* p = b; p != e; ++p) {
+      EXPECT_EQ(*p, next++);
+    }
+  });
+  EXPECT_EQ(next, static_cast<int>(end));
+}
+
+TYPED_TEST(ConcurrentVectorTest, ForEachSpanSmall) {
+  RUN_VARIED_TEST(20, forEachSpanCorrect, int);
+}
+
+TYPED_TEST(ConcurrentVectorTest, ForEachSpanLarge) {
+  RUN_VARIED_TEST(1 << 13, forEachSpanCorrect, int);
+}
+
+TYPED_TEST(ConcurrentVectorTest, ParallelForSpans) {
+  constexpr int kNum = 100000;
+  dispenso::ConcurrentVector<int, TypeParam> vec;
+  vec.grow_by_generator(kNum, [i = 0]() mutable { return i++; });
+
+  dispenso::parallel_for(vec, [](int* b, int* e) {
+    for (int* p = b; p != e; ++p) {
+      *p *= 2;
+    }
+  });
+
+  const auto& cvec = vec;
+  std::atomic<int64_t> sum(0);
+  dispenso::ParForOptions options;
+  options.defaultChunking = dispenso::ParForChunking::kAuto;
+  dispenso::parallel_for(
+      cvec,
+      [&sum](const int* b, const int* e) {
+        int64_t local = 0;
+        for (const int* p = b; p != e; ++p) {
+          local += *p;
+        }
+        sum.fetch_add(local, std::memory_order_relaxed);
+      },
+      options);
+  EXPECT_EQ(sum.load(), int64_t{kNum} * (kNum - 1));
+}
+
+TYPED_TEST(ConcurrentVectorTest, AppenderSerial) {
+  using Vec = dispenso::ConcurrentVector<std::unique_ptr<int>, TypeParam>;
+  Vec vec;
+  {
+    typename Vec::Appender appender(vec, 7);
+    for (int i = 0; i < 1000; ++i) {
+      EXPECT_EQ(*appender.emplace_back(std::make_unique<int>(i)), i);
+    }
+    // Nothing else grew the vector, so the unused tail of the last block is handed back.
+    auto padded = appender.flush();
+    EXPECT_EQ(padded.first, padded.second);
+    EXPECT_EQ(vec.size(), 1000);
+    appender.push_back(std::make_unique<int>(1000));
+  }
+  ASSERT_EQ(vec.size(), 1001);
+  for (int i = 0; i <= 1000; ++i) {
+    EXPECT_EQ(*vec[i], i);
+  }
+}
+
+TYPED_TEST(ConcurrentVectorTest, AppenderPadsInterleavedBlocks) {
+  using Vec = dispenso::ConcurrentVector<std::unique_ptr<int>, TypeParam>;
+  Vec vec;
+  typename Vec::Appender a(vec, 16);
+  typename Vec::Appender b(vec, 16);
+  a.push_back(std::make_unique<int>(0));
+  b.push_back(std::make_unique<int>(1));
+  // b's block follows a's, so a's tail can't be handed back and is padded instead.
+  auto padded = a.flush();
+  EXPECT_EQ(padded.first, 1);
+  EXPECT_EQ(padded.second, 16);
+  padded = b.flush();
+  EXPECT_EQ(padded.first, padded.second);
+  ASSERT_EQ(vec.size(), 17);
+  EXPECT_EQ(*vec[0], 0);
+  for (size_t i = 1; i < 16; ++i) {
+    EXPECT_FALSE(vec[i]);
+  }
+  EXPECT_EQ(*vec[16], 1);
+}
+
+namespace {
+struct NoDefault {
+  explicit NoDefault(int v) : value(v) {}
+  int value;
+};
+} // namespace
+
+TYPED_TEST(ConcurrentVectorTest, AppenderPaddingValue) {
+  using Vec = dispenso::ConcurrentVector<NoDefault, TypeParam>;
+  Vec vec;
+  typename Vec::Appender a(vec, 8, NoDefault(-1));
+  typename Vec::Appender b(vec, 8, NoDefault(-1));
+  a.emplace_back(0);
+  a.emplace_back(1);
+  b.emplace_back(2);
+  auto padded = a.flush();
+  EXPECT_EQ(padded.first, 2);
+  EXPECT_EQ(padded.second, 8);
+  b.flush();
+  ASSERT_EQ(vec.size(), 9);
+  EXPECT_EQ(vec[0].value, 0);
+  EXPECT_EQ(vec[1].value, 1);
+  for (size_t i = padded.first; i < padded.second; ++i) {
+    EXPECT_EQ(vec[i].value, -1);
+  }
+  EXPECT_EQ(vec[8].value, 2);
+}
+
+TYPED_TEST(ConcurrentVectorTest, AppenderParallel) {
+  using Vec = dispenso::ConcurrentVector<int, TypeParam>;
+  constexpr int kNum = 100000;
+  Vec vec;
+  {
+    std::deque<typename Vec::Appender> appenders;
+    dispenso::parallel_for(
+        appenders,
+        [&vec]() { return typename Vec::Appender(vec, 32); },
+        0,
+        kNum,
+        [](typename Vec::Appender& appender, int i) { appender.push_back(i + 1); });
+  }
+
+  std::vector<int> values;
+  for (int v : vec) {
+    // Zeros are padding left by blocks that were not filled.
+    if (v) {
+      values.push_back(v);
+    }
+  }
+  std::sort(values.begin(), values.end());
+  ASSERT_EQ(values.size(), kNum);
+  for (int i = 0; i < kNum; ++i) {
+    EXPECT_EQ(values[i], i + 1);
+  }
+}
@@ -8,6 +8,7 @@
 #include <dispenso/concurrent_vector.h>
 
 #include <algorithm>
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/completion_event.h>
+#include <dispenso/future_array.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+TEST(FutureArray, Basic) {
+  auto results = dispenso::asyncBatch(1000, [](size_t i) { return static_cast<int>(i * i); });
+  ASSERT_EQ(results.size(), 1000);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results.get(i), static_cast<int>(i * i));
+  }
+}
+
+TEST(FutureArray, WaitAll) {
+  std::atomic<size_t> count(0);
+  auto results = dispenso::asyncBatch(
+      dispenso::globalThreadPool(),
+      777,
+      [&count](size_t) { count.fetch_add(1, std::memory_order_relaxed); },
+      5);
+  results.wait();
+  EXPECT_EQ(count.load(), 777);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_TRUE(results.is_ready(i));
+  }
+}
+
+TEST(FutureArray, NonTrivialResults) {
+  auto results =
+      dispenso::asyncBatch(100, [](size_t i) { return std::string(i, static_cast<char>('a')); });
+  results.wait();
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results.get(i).size(), i);
+  }
+}
+
+TEST(FutureArray, Empty) {
+  auto results = dispenso::asyncBatch(0, [](size_t i) { return i; });
+  EXPECT_TRUE(results.valid());
+  EXPECT_EQ(results.size(), 0);
+  results.wait();
+
+  dispenso::FutureArray<int> invalid;
+  EXPECT_FALSE(invalid.valid());
+  EXPECT_EQ(invalid.size(), 0);
+}
+
+TEST(FutureArray, ZeroThreadPoolRunsInline) {
+  dispenso::ThreadPool pool(0);
+  auto results = dispenso::asyncBatch(pool, 64, [](size_t i) { return i + 1; });
+  // There are no pool threads, so any element not yet run must be run by the waiting thread.
+  EXPECT_EQ(results.get(63), 64);
+  results.wait();
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results.get(i), i + 1);
+  }
+}
+
+TEST(FutureArray, WaitForRunningElement) {
+  dispenso::ThreadPool pool(1);
+  dispenso::CompletionEvent event;
+  auto results = dispenso::asyncBatch(
+      pool,
+      1,
+      [&event](size_t) {
+        event.wait();
+        return 5;
+      },
+      1);
+  // The element may or may not have been picked up by the pool thread yet; either way it cannot
+  // complete until the event fires.  If it has not started, wait_for must not run it inline.
+  EXPECT_EQ(results.wait_for(0, 1ms), std::future_status::timeout);
+  event.notify();
+  EXPECT_EQ(results.get(0), 5);
+  EXPECT_EQ(results.wait_for(0, 1ms), std::future_status::ready);
+}
+
+TEST(FutureArray, CopiesShareResults) {
+  dispenso::FutureArray<size_t> copy;
+  {
+    auto results = dispenso::asyncBatch(50, [](size_t i) { return 2 * i; });
+    copy = results;
+  }
+  for (size_t i = 0; i < copy.size(); ++i) {
+    EXPECT_EQ(copy.get(i), 2 * i);
+  }
+}
+
+TEST(FutureArray, DestroyBeforeComplete) {
+  std::atomic<size_t> count(0);
+  {
+    dispenso::ThreadPool pool(2);
+    {
+      auto results = dispenso::asyncBatch(pool, 500, [&count](size_t i) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        return std::to_string(i);
+      });
+    }
+  }
+  // Pool destruction waits for all queued work; every element must have been run exactly once.
+  EXPECT_EQ(count.load(), 500);
+}
+
+TEST(FutureArray, NestedInPool) {
+  auto outer = dispenso::asyncBatch(8, [](size_t i) {
+    auto inner = dispenso::asyncBatch(100, [i](size_t j) { return i * j; });
+    size_t sum = 0;
+    for (size_t j = 0; j < inner.size(); ++j) {
+      sum += inner.get(j);
+    }
+    return sum;
+  });
+  for (size_t i = 0; i < outer.size(); ++i) {
+    EXPECT_EQ(outer.get(i), i * 4950);
+  }
+}
+
+#if defined(__cpp_exceptions)
+TEST(FutureArray, Exceptions) {
+  auto results = dispenso::asyncBatch(10, [](size_t i) {
+    if (i == 3) {
+      throw std::runtime_error("three");
+    }
+    return i;
+  });
+  results.wait();
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (i == 3) {
+      EXPECT_THROW(results.get(i), std::runtime_error);
+    } else {
+      EXPECT_EQ(results.get(i), i);
+    }
+  }
+}
+#endif // __cpp_exceptions
@@ -1181,3 +1181,136 @@ TEST(Future, MoveThenRefCountThreadPool) {
   }
   EXPECT_EQ(sp.use_count(), 1);
 }
+
+TEST(Future, CancelNotStarted) {
+  std::shared_ptr<int> sp = std::make_shared<int>(5);
+  std::atomic<bool> ran(false);
+  dispenso::CompletionEvent blocker;
+  {
+    dispenso::ThreadPool pool(1);
+    // Occupy the single pool thread so that the future cannot start.
+    pool.schedule([&blocker]() { blocker.wait(); }, dispenso::ForceQueuingTag());
+
+    dispenso::Future<int> future(
+        [sp, &ran]() {
+          ran.store(true, std::memory_order_release);
+          return *sp;
+        },
+        pool,
+        std::launch::async,
+        dispenso::kNotDeferred);
+    EXPECT_EQ(sp.use_count(), 2);
+
+    EXPECT_TRUE(future.cancel());
+    EXPECT_TRUE(future.is_ready());
+    EXPECT_TRUE(future.is_canceled());
+    // The functor (and its captures) should be released upon cancellation.
+    EXPECT_EQ(sp.use_count(), 1);
+    // Already canceled.
+    EXPECT_FALSE(future.cancel());
+    future.wait();
+
+    blocker.notify();
+  }
+  EXPECT_FALSE(ran.load(std::memory_order_acquire));
+}
+
+TEST(Future, CancelAfterCompletion) {
+  auto ready = dispenso::make_ready_future(5);
+  EXPECT_FALSE(ready.cancel());
+  EXPECT_FALSE(ready.is_canceled());
+  EXPECT_EQ(ready.get(), 5);
+
+  auto done = dispenso::async([]() { return 6; });
+  EXPECT_EQ(done.get(), 6);
+  EXPECT_FALSE(done.cancel());
+  EXPECT_FALSE(done.is_canceled());
+  EXPECT_EQ(done.get(), 6);
+}
+
+TEST(Future, CancelPropagatesToThen) {
+  std::atomic<int> ran(0);
+  dispenso::CompletionEvent blocker;
+  {
+    dispenso::ThreadPool pool(1);
+    pool.schedule([&blocker]() { blocker.wait(); }, dispenso::ForceQueuingTag());
+
+    dispenso::Future<int> future(
+        [&ran]() {
+          ran.fetch_add(1, std::memory_order_acq_rel);
+          return 1;
+        },
+        pool,
+        std::launch::async,
+        dispenso::kNotDeferred);
+    auto child = future.then(
+        [&ran](auto&& parent) {
+          ran.fetch_add(1, std::memory_order_acq_rel);
+          return parent.get() + 1;
+        },
+        pool);
+    auto grandChild = child.then(
+        [&ran](auto&&) { ran.fetch_add(1, std::memory_order_acq_rel); }, pool);
+
+    EXPECT_TRUE(future.cancel());
+    EXPECT_TRUE(child.is_canceled());
+    EXPECT_TRUE(grandChild.is_canceled());
+
+    // A continuation attached after cancellation is canceled as well.
+    auto late = future.then([&ran](auto&&) { ran.fetch_add(1, std::memory_order_acq_rel); }, pool);
+    EXPECT_TRUE(late.is_canceled());
+
+    blocker.notify();
+  }
+  EXPECT_EQ(ran.load(std::memory_order_acquire), 0);
+}
+
+TEST(Future, CancelTaskSetWait) {
+  dispenso::CompletionEvent blocker;
+  dispenso::ThreadPool pool(1);
+  pool.schedule([&blocker]() { blocker.wait(); }, dispenso::ForceQueuingTag());
+
+  dispenso::TaskSet tasks(pool);
+  dispenso::Future<int> future([]() { return 1; }, tasks, std::launch::async);
+  EXPECT_TRUE(future.cancel());
+  blocker.notify();
+  // Cancellation must count as completion for the TaskSet.
+  tasks.wait();
+  EXPECT_TRUE(future.is_canceled());
+}
+
+TEST(Future, WhenAllWithCanceled) {
+  dispenso::CompletionEvent blocker;
+  dispenso::ThreadPool pool(1);
+  pool.schedule([&blocker]() { blocker.wait(); }, dispenso::ForceQueuingTag());
+
+  dispenso::Future<int> canceled([]() { return 1; }, pool, std::launch::async);
+  auto ready = dispenso::make_ready_future(2);
+  EXPECT_TRUE(canceled.cancel());
+
+  auto all = dispenso::when_all(canceled, ready);
+  auto& tuple = all.get();
+  EXPECT_TRUE(std::get<0>(tuple).is_canceled());
+  EXPECT_EQ(std::get<1>(tuple).get(), 2);
+  blocker.notify();
+}
+
+#if defined(__cpp_exceptions)
+TEST(Future, CanceledGetThrows) {
+  dispenso::CompletionEvent blocker;
+  dispenso::ThreadPool pool(1);
+  pool.schedule([&blocker]() { blocker.wait(); }, dispenso::ForceQueuingTag());
+
+  dispenso::Future<void> future([]() {}, pool, std::launch::async);
+  EXPECT_TRUE(future.cancel());
+  bool handledException = false;
+  try {
+    future.get();
+  } catch (const std::future_error& e) {
+    EXPECT_EQ(e.code(), std::make_error_code(std::future_errc::broken_promise));
+    handledException = true;
+  }
+  EXPECT_TRUE(handledException);
+  blocker.notify();
+}
+#endif //__cpp_exceptions
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/completion_event.h>
+#include <dispenso/future_timeout.h>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+TEST(FutureTimeout, ReadyBeforeTimeout) {
+  auto future = dispenso::make_ready_future(77);
+  auto result = dispenso::withTimeout(future, 10s);
+  // The value is already available, so this must not wait for the timer.
+  EXPECT_EQ(result.wait_for(5s), std::future_status::ready);
+  EXPECT_EQ(result.get().status(), std::future_status::ready);
+  EXPECT_FALSE(result.get().timedOut());
+  EXPECT_EQ(result.get().get(), 77);
+}
+
+TEST(FutureTimeout, ValueArrivesFirst) {
+  dispenso::CompletionEvent event;
+  dispenso::Future<int> future(
+      [&event]() {
+        event.wait();
+        return 5;
+      },
+      dispenso::kNewThreadInvoker,
+      std::launch::async,
+      dispenso::kNotDeferred);
+
+  auto result = dispenso::withTimeout(future, 10s);
+  EXPECT_FALSE(result.is_ready());
+  event.notify();
+  EXPECT_EQ(result.wait_for(5s), std::future_status::ready);
+  EXPECT_FALSE(result.get().timedOut());
+  EXPECT_EQ(result.get().get(), 5);
+}
+
+TEST(FutureTimeout, TimeoutArrivesFirst) {
+  dispenso::CompletionEvent event;
+  dispenso::Future<int> future(
+      [&event]() {
+        event.wait();
+        return 5;
+      },
+      dispenso::kNewThreadInvoker,
+      std::launch::async,
+      dispenso::kNotDeferred);
+
+  auto result = dispenso::withTimeout(future, 5ms);
+  EXPECT_TRUE(result.get().timedOut());
+  EXPECT_EQ(result.get().status(), std::future_status::timeout);
+  EXPECT_FALSE(future.is_ready());
+
+  event.notify();
+  EXPECT_EQ(result.get().get(), 5);
+}
+
+TEST(FutureTimeout, TimeoutWithThen) {
+  dispenso::CompletionEvent event;
+  dispenso::Future<void> future(
+      [&event]() { event.wait(); },
+      dispenso::kNewThreadInvoker,
+      std::launch::async,
+      dispenso::kNotDeferred);
+
+  std::atomic<int> timedOut(0);
+  auto done = dispenso::withTimeout(future, 5ms).then(
+      [&timedOut](dispenso::Future<dispenso::TimeoutResult<void>>&& r) {
+        timedOut.store(r.get().timedOut(), std::memory_order_release);
+      },
+      dispenso::kImmediateInvoker);
+
+  // Nothing blocks waiting on the timeout; the continuation is triggered by the timer.
+  while (!done.is_ready()) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(timedOut.load(std::memory_order_acquire), 1);
+
+  event.notify();
+  future.get();
+}
+
+TEST(FutureTimeout, DeadlineInPast) {
+  dispenso::CompletionEvent event;
+  dispenso::Future<int> future(
+      [&event]() {
+        event.wait();
+        return 5;
+      },
+      dispenso::kNewThreadInvoker,
+      std::launch::async,
+      dispenso::kNotDeferred);
+
+  auto result = dispenso::withDeadline(future, std::chrono::steady_clock::now() - 1s);
+  EXPECT_TRUE(result.is_ready());
+  EXPECT_TRUE(result.get().timedOut());
+  event.notify();
+  // The functor references event, so it must finish before event goes out of scope.
+  EXPECT_EQ(future.get(), 5);
+}
+
+TEST(FutureTimeout, ManyRaces) {
+  constexpr int kNumFutures = 200;
+  std::vector<dispenso::Future<dispenso::TimeoutResult<int>>> results;
+  for (int i = 0; i < kNumFutures; ++i) {
+    dispenso::Future<int> future([i]() { return i; }, dispenso::globalThreadPool());
+    results.push_back(dispenso::withTimeout(future, std::chrono::microseconds(i % 4)));
+  }
+  for (int i = 0; i < kNumFutures; ++i) {
+    auto& r = results[i].get();
+    // Whichever side won, the underlying future's value must be consistent.
+    EXPECT_EQ(r.get(), i);
+  }
+}
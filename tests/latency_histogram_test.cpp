@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <thread>
+#include <vector>
+
+#include <dispenso/latency_histogram.h>
+
+#include <gtest/gtest.h>
+
+TEST(LatencyHistogram, Empty) {
+  dispenso::LatencyHistogram hist;
+  auto snap = hist.snapshot();
+  EXPECT_EQ(snap.count(), 0);
+  EXPECT_EQ(snap.mean(), 0.0);
+  EXPECT_EQ(snap.max(), 0.0);
+  EXPECT_EQ(snap.percentile(50.0), 0.0);
+}
+
+TEST(LatencyHistogram, PercentilesWithinPrecision) {
+  dispenso::LatencyHistogram hist;
+  // 1us through 10ms.
+  for (int i = 1; i <= 10000; ++i) {
+    hist.record(i * 1e-6);
+  }
+  auto snap = hist.snapshot();
+  EXPECT_EQ(snap.count(), 10000);
+  EXPECT_NEAR(snap.mean(), 5000.5e-6, 1e-9);
+  EXPECT_NEAR(snap.max(), 10e-3, 1e-9);
+  for (double p : {1.0, 10.0, 50.0, 90.0, 99.0, 99.9}) {
+    double expected = p * 100e-6;
+    EXPECT_NEAR(snap.percentile(p), expected, expected / 16) << p;
+  }
+  EXPECT_NEAR(snap.percentile(100.0), 10e-3, 10e-3 / 16);
+}
+
+TEST(LatencyHistogram, SmallAndClampedValues) {
+  dispenso::LatencyHistogram hist;
+  hist.record(-1.0);
+  hist.record(3e-9);
+  hist.record(1e6);
+  auto snap = hist.snapshot();
+  EXPECT_EQ(snap.count(), 3);
+  EXPECT_EQ(snap.percentile(0.0), 0.0);
+  EXPECT_NEAR(snap.percentile(50.0), 3e-9, 1e-12);
+  // Values too large to represent are clamped to about 18 minutes.
+  EXPECT_GT(snap.max(), 1000.0);
+  EXPECT_LT(snap.max(), 1200.0);
+
+  hist.reset();
+  EXPECT_EQ(hist.snapshot().count(), 0);
+}
+
+TEST(LatencyHistogram, ConcurrentRecord) {
+  constexpr int kThreads = 4;
+  constexpr int kPerThread = 100000;
+  dispenso::LatencyHistogram hist;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&hist, t]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        hist.record((t + 1) * 1e-3);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto snap = hist.snapshot();
+  EXPECT_EQ(snap.count(), kThreads * kPerThread);
+  EXPECT_NEAR(snap.max(), kThreads * 1e-3, 1e-9);
+  EXPECT_NEAR(snap.percentile(25.0), 1e-3, 1e-3 / 16);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <dispenso/object_pool.h>
+#include <dispenso/task_set.h>
+
+namespace {
+// A stand-in for an expensive object such as a scratch buffer, which counts its constructions and
+// destructions.
+struct Scratch {
+  Scratch(std::atomic<int>& constructed, std::atomic<int>& destroyed)
+      : constructed_(&constructed), destroyed_(&destroyed) {
+    ++*constructed_;
+  }
+  Scratch(Scratch&& other)
+      : data(std::move(other.data)),
+        constructed_(other.constructed_),
+        destroyed_(other.destroyed_) {
+    other.destroyed_ = nullptr;
+  }
+  ~Scratch() {
+    if (destroyed_) {
+      ++*destroyed_;
+    }
+  }
+
+  std::vector<int> data;
+  std::atomic<int>* constructed_;
+  std::atomic<int>* destroyed_;
+};
+} // namespace
+
+TEST(ObjectPool, ReusesObjects) {
+  dispenso::ObjectPool<std::vector<int>> pool;
+  std::vector<int>* first;
+  {
+    auto obj = pool.acquire();
+    first = &obj.get();
+    obj->push_back(1);
+  }
+  auto obj = pool.acquire();
+  EXPECT_EQ(first, &*obj);
+  EXPECT_EQ(obj->size(), 1);
+  EXPECT_EQ(pool.size(), 1);
+}
+
+TEST(ObjectPool, GrowsOnDemand) {
+  std::atomic<int> constructed(0);
+  std::atomic<int> destroyed(0);
+  {
+    dispenso::ObjectPool<Scratch> pool([&]() { return Scratch(constructed, destroyed); });
+    std::vector<dispenso::PooledObject<Scratch>> held;
+    for (int i = 0; i < 100; ++i) {
+      held.push_back(pool.acquire());
+    }
+    EXPECT_EQ(constructed.load(), 100);
+    EXPECT_EQ(pool.size(), 100);
+    held.clear();
+    for (int i = 0; i < 100; ++i) {
+      held.push_back(pool.acquire());
+    }
+    EXPECT_EQ(constructed.load(), 100);
+    EXPECT_EQ(destroyed.load(), 0);
+  }
+  EXPECT_EQ(destroyed.load(), 100);
+}
+
+TEST(ObjectPool, ResetOnRelease) {
+  dispenso::ObjectPool<std::vector<int>> pool(
+      []() { return std::vector<int>(); }, [](std::vector<int>& v) { v.clear(); });
+  {
+    auto obj = pool.acquire();
+    obj->resize(1000);
+  }
+  auto obj = pool.acquire();
+  EXPECT_TRUE(obj->empty());
+  EXPECT_GE(obj->capacity(), 1000);
+}
+
+TEST(ObjectPool, Reserve) {
+  dispenso::ObjectPool<std::vector<int>> pool;
+  pool.reserve(8);
+  EXPECT_EQ(pool.size(), 8);
+  std::vector<dispenso::PooledObject<std::vector<int>>> held;
+  for (int i = 0; i < 8; ++i) {
+    held.push_back(pool.acquire());
+  }
+  EXPECT_EQ(pool.size(), 8);
+}
+
+TEST(ObjectPool, MoveHandle) {
+  dispenso::ObjectPool<int> pool([]() { return 7; });
+  auto a = pool.acquire();
+  auto b = pool.acquire();
+  int* pa = &*a;
+  b = std::move(a);
+  EXPECT_EQ(pa, &*b);
+  auto c = pool.acquire();
+  EXPECT_EQ(*c, 7);
+  EXPECT_EQ(pool.size(), 2);
+}
+
+TEST(ObjectPool, ReleaseOnOtherThread) {
+  constexpr int kCapacity = 4;
+  dispenso::ObjectPool<int> pool([]() { return 0; }, nullptr, kCapacity);
+  std::vector<dispenso::PooledObject<int>> held;
+  for (int i = 0; i < 64; ++i) {
+    held.push_back(pool.acquire());
+  }
+  // Released objects spill from the other thread's free list to the shared list, from which this
+  // thread can then reuse them.
+  std::thread([&held]() { held.clear(); }).join();
+  for (int i = 0; i < 60; ++i) {
+    held.push_back(pool.acquire());
+  }
+  EXPECT_EQ(pool.size(), 64);
+}
+
+TEST(ObjectPool, ManyPoolsPerThread) {
+  std::vector<std::unique_ptr<dispenso::ObjectPool<int>>> pools;
+  for (int i = 0; i < 10; ++i) {
+    pools.push_back(std::make_unique<dispenso::ObjectPool<int>>([i]() { return i; }));
+  }
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 10; ++i) {
+      auto obj = pools[i]->acquire();
+      EXPECT_EQ(*obj, i);
+    }
+  }
+  for (auto& pool : pools) {
+    EXPECT_EQ(pool->size(), 1);
+  }
+}
+
+TEST(ObjectPool, ParallelAcquireRelease) {
+  constexpr int kTasks = 10000;
+  std::atomic<int> constructed(0);
+  std::atomic<int> destroyed(0);
+  std::atomic<int> total(0);
+  {
+    dispenso::ObjectPool<Scratch> pool(
+        [&]() { return Scratch(constructed, destroyed); },
+        [&total](Scratch& s) {
+          total += static_cast<int>(s.data.size());
+          s.data.clear();
+        },
+        8);
+    dispenso::ThreadPool threadPool(4);
+    dispenso::TaskSet tasks(threadPool);
+    for (int i = 0; i < kTasks; ++i) {
+      tasks.schedule([&pool]() {
+        auto a = pool.acquire();
+        auto b = pool.acquire();
+        EXPECT_TRUE(a->data.empty());
+        EXPECT_TRUE(b->data.empty());
+        a->data.push_back(1);
+      });
+    }
+    tasks.wait();
+    EXPECT_EQ(static_cast<int>(pool.size()), constructed.load());
+  }
+  EXPECT_EQ(total.load(), kTasks);
+  EXPECT_EQ(destroyed.load(), constructed.load());
+}
@@ -8,6 +8,7 @@
 #include <dispenso/once_function.h>
 
 #include <deque>
+#include <memory>
 
 #include <gtest/gtest.h>
 
@@ -157,6 +158,127 @@ TEST(OnceFunction, EnsureDestructionExtraLarge) {
   ensureDestructor<kExtraLarge>();
 }
 
+namespace {
+struct Counted {
+  Counted(int* l, int* r) : live(l), runs(r) {
+    ++*live;
+  }
+  Counted(const Counted& other) : live(other.live), runs(other.runs) {
+    ++*live;
+  }
+  Counted(Counted&& other) noexcept : live(other.live), runs(other.runs) {
+    ++*live;
+  }
+  ~Counted() {
+    --*live;
+  }
+  void operator()() {
+    ++*runs;
+  }
+  int* live;
+  int* runs;
+};
+
+struct ThrowingMove : Counted {
+  using Counted::Counted;
+  ThrowingMove(ThrowingMove&& other) noexcept(false) : Counted(other) {}
+};
+} // namespace
+
+template <typename F>
+void testMovedRepeatedly() {
+  int live = 0;
+  int runs = 0;
+  {
+    OnceFunction f(F(&live, &runs));
+    EXPECT_EQ(live, 1);
+    OnceFunction g(std::move(f));
+    OnceFunction h;
+    for (int i = 0; i < 5; ++i) {
+      h = std::move(g);
+      g = std::move(h);
+    }
+    EXPECT_EQ(live, 1);
+    g();
+  }
+  EXPECT_EQ(runs, 1);
+  EXPECT_EQ(live, 0);
+}
+
+TEST(OnceFunction, MovedRepeatedly) {
+  testMovedRepeatedly<Counted>();
+}
+
+TEST(OnceFunction, MovedRepeatedlyThrowingMove) {
+  testMovedRepeatedly<ThrowingMove>();
+}
+
+namespace {
+// Exactly fills the inline storage.
+struct InlineSum {
+  void operator()() {
+    int64_t sum = 0;
+    for (int64_t v : values) {
+      sum += v;
+    }
+    *result = sum;
+  }
+  int64_t* result;
+  int64_t values[5];
+};
+
+struct TooBig {
+  void operator()() {}
+  char data[56];
+};
+
+struct alignas(2 * alignof(std::max_align_t)) OverAligned {
+  void operator()() {}
+  char data[8];
+};
+} // namespace
+
+TEST(OnceFunction, FitsInline) {
+  int a = 0;
+  int b = 0;
+  int c = 0;
+  auto capturesPointers = [pa = &a, pb = &b, pc = &c]() { *pa = *pb + *pc; };
+  static_assert(
+      dispenso::detail::OnceCallableFitsInline<decltype(capturesPointers)>::value,
+      "A lambda capturing a few pointers should be held inline");
+  static_assert(sizeof(InlineSum) == 48, "InlineSum should exactly fill the inline storage");
+  static_assert(dispenso::detail::OnceCallableFitsInline<InlineSum>::value, "Should fit inline");
+  static_assert(!dispenso::detail::OnceCallableFitsInline<TooBig>::value, "Too large for inline");
+  static_assert(
+      !dispenso::detail::OnceCallableFitsInline<OverAligned>::value, "Too aligned for inline");
+  static_assert(
+      !dispenso::detail::OnceCallableFitsInline<Counted>::value,
+      "Not trivially copyable, so should not be held inline");
+}
+
+TEST(OnceFunction, MovedRepeatedlyInline) {
+  int64_t result = 0;
+  OnceFunction f(InlineSum{&result, {1, 2, 3, 4, 5}});
+  OnceFunction g(std::move(f));
+  OnceFunction h;
+  for (int i = 0; i < 5; ++i) {
+    h = std::move(g);
+    g = std::move(h);
+  }
+  OnceFunction last(std::move(g));
+  last();
+  EXPECT_EQ(result, 15);
+}
+
+TEST(OnceFunction, MoveOnlyCapture) {
+  auto value = std::make_unique<int>(3);
+  int result = 0;
+  OnceFunction f([value = std::move(value), &result]() { result = *value; });
+  OnceFunction g(std::move(f));
+  g();
+  EXPECT_EQ(result, 3);
+}
+
 template <size_t alignment>
 struct EnsureAlign {
   void operator()() {
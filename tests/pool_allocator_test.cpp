@@ -8,6 +8,10 @@
 #include <dispenso/pool_allocator.h>
 
 #include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
 
 #include <gtest/gtest.h>
 
@@ -151,3 +155,112 @@ TEST(PoolAllocator, Arena) {
     EXPECT_TRUE(std::all_of(c, c + 64, [](char v) { return v == 0x11; }));
   }
 }
+
+TEST(PoolAllocator, ThreadCacheThreaded) {
+  constexpr size_t kNumThreads = 8;
+
+  size_t slabs = 0;
+  auto allocFunc = [&slabs](size_t len) {
+    ++slabs;
+    return ::malloc(len);
+  };
+
+  dispenso::PoolAllocator allocator(64, 1024, allocFunc, ::free, 4);
+
+  std::deque<std::thread> threads;
+
+  for (size_t i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&allocator, tid = i]() {
+      constexpr size_t kNumBufs = 11;
+      char* bufs[kNumBufs];
+
+      for (size_t i = 0; i < 1000; ++i) {
+        for (size_t j = 0; j < kNumBufs; ++j) {
+          bufs[j] = allocator.alloc();
+          std::fill_n(bufs[j], 64, static_cast<char>(tid));
+        }
+        for (size_t j = 0; j < kNumBufs; ++j) {
+          EXPECT_TRUE(
+              std::all_of(bufs[j], bufs[j] + 64, [tid](char v) { return v == char(tid); }));
+          allocator.dealloc(bufs[j]);
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // Chunks cached by one thread are handed back in batches, so the pool stays bounded by what the
+  // threads hold at once plus what they cache.
+  EXPECT_EQ(allocator.totalChunkCapacity(), slabs * 16);
+  EXPECT_LE(allocator.totalChunkCapacity(), kNumThreads * (11 + 2 * 4) + 16);
+}
+
+TEST(PoolAllocator, ThreadCacheArena) {
+  dispenso::PoolAllocator allocator(64, 256, ::malloc, ::free, 3);
+
+  std::vector<char*> vec(200);
+  for (char*& c : vec) {
+    c = allocator.alloc();
+  }
+  for (size_t i = 0; i < vec.size(); i += 2) {
+    allocator.dealloc(vec[i]);
+  }
+  size_t capacity = allocator.totalChunkCapacity();
+
+  // After clear, every chunk, including those cached by this thread, is available again, without
+  // growing the pool.
+  allocator.clear();
+  std::set<char*> unique;
+  for (size_t i = 0; i < capacity; ++i) {
+    char* c = allocator.alloc();
+    std::fill_n(c, 64, 0x33);
+    EXPECT_TRUE(unique.insert(c).second);
+  }
+  EXPECT_EQ(allocator.totalChunkCapacity(), capacity);
+}
+
+TEST(PoolAllocator, StlContainers) {
+  size_t slabs = 0;
+  auto allocFunc = [&slabs](size_t len) {
+    ++slabs;
+    return ::malloc(len);
+  };
+  dispenso::PoolAllocator allocator(64, 64 * 128, allocFunc, ::free);
+
+  using ListAlloc = dispenso::PoolStlAllocator<int>;
+  std::list<int, ListAlloc> list{ListAlloc(allocator)};
+  for (int i = 0; i < 100; ++i) {
+    list.push_back(i);
+  }
+
+  using MapAlloc = dispenso::PoolStlAllocator<std::pair<const int, int>>;
+  std::map<int, int, std::less<int>, MapAlloc> map{MapAlloc(allocator)};
+  for (int i = 0; i < 100; ++i) {
+    map.emplace(i, 2 * i);
+  }
+
+  // The nodes of both containers came from the pool.
+  EXPECT_EQ(slabs, 2);
+  EXPECT_EQ(list.get_allocator(), map.get_allocator());
+
+  int expected = 0;
+  for (int v : list) {
+    EXPECT_EQ(v, expected++);
+  }
+  for (auto& kv : map) {
+    EXPECT_EQ(kv.second, 2 * kv.first);
+  }
+
+  // Hash table bucket arrays outgrow the chunks, and fall back on the heap.
+  using UMapAlloc = dispenso::PoolStlAllocator<std::pair<const int, int>>;
+  std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, UMapAlloc> umap(
+      0, std::hash<int>(), std::equal_to<int>(), UMapAlloc(allocator));
+  for (int i = 0; i < 1000; ++i) {
+    umap.emplace(i, i);
+  }
+  EXPECT_EQ(umap.size(), 1000);
+  EXPECT_EQ(umap.at(500), 500);
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/reactor.h>
+
+#if defined(__linux__)
+
+#include <unistd.h>
+
+#include <dispenso/completion_event.h>
+#include <dispenso/task_set.h>
+#include <dispenso/thread_pool.h>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+struct Pipe {
+  Pipe() {
+    EXPECT_EQ(::pipe(fds), 0);
+  }
+  ~Pipe() {
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+  void write(char c) {
+    EXPECT_EQ(::write(fds[1], &c, 1), 1);
+  }
+  char read() {
+    char c = 0;
+    EXPECT_EQ(::read(fds[0], &c, 1), 1);
+    return c;
+  }
+  int fds[2];
+};
+} // namespace
+
+TEST(Reactor, ManualPoll) {
+  dispenso::Reactor reactor;
+  ASSERT_TRUE(reactor.valid());
+  Pipe p;
+  char got = 0;
+  ASSERT_TRUE(reactor.add(p.fds[0], EPOLLIN, [&](uint32_t events) {
+    EXPECT_TRUE(events & EPOLLIN);
+    got = p.read();
+  }));
+  EXPECT_EQ(reactor.poll(0), 0);
+  p.write('x');
+  EXPECT_EQ(reactor.poll(1000000), 1);
+  EXPECT_EQ(got, 'x');
+  // The registration is rearmed after the callback.
+  p.write('y');
+  EXPECT_EQ(reactor.poll(1000000), 1);
+  EXPECT_EQ(got, 'y');
+
+  EXPECT_TRUE(reactor.remove(p.fds[0]));
+  EXPECT_FALSE(reactor.remove(p.fds[0]));
+  p.write('z');
+  EXPECT_EQ(reactor.poll(0), 0);
+  EXPECT_EQ(got, 'y');
+}
+
+TEST(Reactor, DuplicateAdd) {
+  dispenso::Reactor reactor;
+  Pipe p;
+  EXPECT_TRUE(reactor.add(p.fds[0], EPOLLIN, [](uint32_t) {}));
+  EXPECT_FALSE(reactor.add(p.fds[0], EPOLLIN, [](uint32_t) {}));
+  EXPECT_FALSE(reactor.modify(p.fds[1], EPOLLOUT));
+  EXPECT_TRUE(reactor.modify(p.fds[0], EPOLLIN | EPOLLRDHUP));
+}
+
+TEST(Reactor, WakeReleasesPoller) {
+  dispenso::Reactor reactor;
+  reactor.wake();
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(reactor.poll(10000000), 0);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(Reactor, CallbacksRunOnPoolThreads) {
+  dispenso::Reactor reactor;
+  dispenso::ThreadPool pool(2);
+  pool.setSignalingWake(true, 1ms);
+  pool.setReactor(&reactor);
+
+  Pipe p;
+  dispenso::CompletionEvent event;
+  std::thread::id callbackThread;
+  ASSERT_TRUE(reactor.add(p.fds[0], EPOLLIN, [&](uint32_t) {
+    p.read();
+    callbackThread = std::this_thread::get_id();
+    event.notify();
+  }));
+  p.write('a');
+  ASSERT_TRUE(event.waitFor(10s));
+  EXPECT_NE(callbackThread, std::this_thread::get_id());
+  reactor.remove(p.fds[0]);
+
+  pool.setReactor(nullptr);
+}
+
+TEST(Reactor, PoolStillRunsWork) {
+  dispenso::Reactor reactor;
+  dispenso::ThreadPool pool(4);
+  pool.setReactor(&reactor);
+  for (bool signaling : {true, false}) {
+    pool.setSignalingWake(signaling, 200us);
+    std::atomic<int> count(0);
+    dispenso::TaskSet tasks(pool);
+    for (int i = 0; i < 1000; ++i) {
+      tasks.schedule([&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+    }
+    tasks.wait();
+    EXPECT_EQ(count.load(), 1000);
+  }
+  pool.setReactor(nullptr);
+}
+
+TEST(Reactor, CallbackNeverConcurrentWithItself) {
+  dispenso::Reactor reactor;
+  dispenso::ThreadPool pool(4);
+  pool.setSignalingWake(true, 1ms);
+  pool.setReactor(&reactor);
+
+  Pipe p;
+  std::atomic<int> inCallback(0);
+  std::atomic<int> maxConcurrent(0);
+  std::atomic<int> reads(0);
+  constexpr int kWrites = 200;
+  ASSERT_TRUE(reactor.add(p.fds[0], EPOLLIN, [&](uint32_t) {
+    int cur = inCallback.fetch_add(1) + 1;
+    int prev = maxConcurrent.load();
+    while (cur > prev && !maxConcurrent.compare_exchange_weak(prev, cur)) {
+    }
+    // Leave data in the pipe for a while so that the descriptor remains ready.
+    std::this_thread::sleep_for(50us);
+    p.read();
+    reads.fetch_add(1);
+    inCallback.fetch_sub(1);
+  }));
+  for (int i = 0; i < kWrites; ++i) {
+    p.write('b');
+  }
+  auto deadline = std::chrono::steady_clock::now() + 20s;
+  while (reads.load() < kWrites && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(reads.load(), kWrites);
+  EXPECT_EQ(maxConcurrent.load(), 1);
+  reactor.remove(p.fds[0]);
+  pool.setReactor(nullptr);
+}
+
+#endif // __linux__
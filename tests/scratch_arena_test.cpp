@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/scratch_arena.h>
+
+#include <mutex>
+#include <set>
+
+#include <dispenso/task_set.h>
+
+#include <gtest/gtest.h>
+
+using dispenso::ScratchArena;
+
+TEST(ScratchArena, BumpAllocation) {
+  ScratchArena arena;
+  EXPECT_EQ(arena.bytesReserved(), 0);
+
+  char* prev = nullptr;
+  for (size_t i = 0; i < 10000; ++i) {
+    size_t alignment = size_t{1} << (i % 7);
+    char* p = reinterpret_cast<char*>(arena.allocate(i % 100 + 1, alignment));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignment, 0);
+    EXPECT_NE(p, prev);
+    std::fill_n(p, i % 100 + 1, 'x');
+    prev = p;
+  }
+  size_t reserved = arena.bytesReserved();
+  EXPECT_GE(reserved, size_t{ScratchArena::kBlockSize});
+
+  // Large and highly aligned requests are allocated individually.
+  auto* big = arena.allocateArray<double>(ScratchArena::kBlockSize);
+  big[ScratchArena::kBlockSize - 1] = 1.0;
+  EXPECT_GT(arena.bytesReserved(), reserved + ScratchArena::kBlockSize * sizeof(double) - 1);
+  void* aligned = arena.allocate(16, 4096);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 4096, 0);
+
+  auto* pair = arena.create<std::pair<int, double>>(3, 4.0);
+  EXPECT_EQ(pair->first, 3);
+  EXPECT_EQ(pair->second, 4.0);
+
+  arena.release();
+  EXPECT_EQ(arena.bytesReserved(), 0);
+  EXPECT_NE(arena.allocate(0), nullptr);
+}
+
+TEST(ScratchArena, Scope) {
+  EXPECT_EQ(dispenso::scratchArena(), nullptr);
+  {
+    dispenso::ScratchArenaScope outer;
+    EXPECT_EQ(dispenso::scratchArena(), &outer.arena());
+    {
+      dispenso::ScratchArenaScope inner;
+      EXPECT_EQ(dispenso::scratchArena(), &inner.arena());
+      inner.arena().allocate(100);
+    }
+    EXPECT_EQ(dispenso::scratchArena(), &outer.arena());
+  }
+  EXPECT_EQ(dispenso::scratchArena(), nullptr);
+}
+
+template <typename TaskSetType>
+void testTaskSetArenas(bool useTryWait) {
+  dispenso::ThreadPool pool(4);
+  TaskSetType tasks(pool);
+
+  std::mutex mtx;
+  std::set<ScratchArena*> arenas;
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 1000; ++i) {
+      tasks.schedule([&mtx, &arenas, i]() {
+        ScratchArena* arena = dispenso::scratchArena();
+        ASSERT_NE(arena, nullptr);
+        int* values = arena->allocateArray<int>(16);
+        for (int j = 0; j < 16; ++j) {
+          values[j] = i + j;
+        }
+        for (int j = 0; j < 16; ++j) {
+          EXPECT_EQ(values[j], i + j);
+        }
+        std::lock_guard<std::mutex> lk(mtx);
+        arenas.insert(arena);
+      });
+    }
+    if (useTryWait) {
+      while (!tasks.tryWait(1)) {
+      }
+    } else {
+      tasks.wait();
+    }
+
+    // Each thread that ran tasks has its own arena, and all of them are released once the set is
+    // seen to be complete.
+    EXPECT_GE(arenas.size(), 1);
+    EXPECT_LE(arenas.size(), 5);
+    for (ScratchArena* arena : arenas) {
+      EXPECT_EQ(arena->bytesReserved(), 0);
+    }
+  }
+}
+
+TEST(ScratchArena, TaskSet) {
+  testTaskSetArenas<dispenso::TaskSet>(false);
+}
+
+TEST(ScratchArena, ConcurrentTaskSet) {
+  testTaskSetArenas<dispenso::ConcurrentTaskSet>(false);
+}
+
+TEST(ScratchArena, TaskSetTryWait) {
+  testTaskSetArenas<dispenso::TaskSet>(true);
+}
+
+TEST(ScratchArena, ConcurrentTaskSetTryWait) {
+  testTaskSetArenas<dispenso::ConcurrentTaskSet>(true);
+}
+
+TEST(ScratchArena, ScopeWithinTask) {
+  dispenso::ThreadPool pool(2);
+  dispenso::TaskSet tasks(pool);
+  for (int i = 0; i < 100; ++i) {
+    tasks.schedule([]() {
+      ScratchArena* setArena = dispenso::scratchArena();
+      {
+        dispenso::ScratchArenaScope scope;
+        EXPECT_EQ(dispenso::scratchArena(), &scope.arena());
+        scope.arena().allocate(64);
+      }
+      EXPECT_EQ(dispenso::scratchArena(), setArena);
+    });
+  }
+  tasks.wait();
+}
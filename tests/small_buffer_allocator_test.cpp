@@ -7,7 +7,14 @@
 
 #include <dispenso/small_buffer_allocator.h>
 
+#if defined(DISPENSO_SMALL_BUFFER_NUMA_LOCAL)
+#include <dispenso/detail/small_buffer_allocator_impl.h>
+#endif // DISPENSO_SMALL_BUFFER_NUMA_LOCAL
+
 #include <deque>
+#include <list>
+#include <map>
+#include <string>
 
 #include <dispenso/tsan_annotations.h>
 #include <gtest/gtest.h>
@@ -15,6 +22,7 @@
 constexpr size_t kSmall = 32;
 constexpr size_t kMedium = 128;
 constexpr size_t kLarge = 256;
+constexpr size_t kHuge = 4096;
 
 constexpr size_t kSimpleNumBuffers = 1 << 15;
 constexpr size_t kThreadedNumBuffers = 1 << 12;
@@ -52,6 +60,7 @@ TEST(SmallBufferAllocator, Empty) {
     testEmpty<kSmall>();
     testEmpty<kMedium>();
     testEmpty<kLarge>();
+    testEmpty<kHuge>();
   }
 }
 
@@ -80,6 +89,7 @@ TEST(SmallBufferAllocator, Simple) {
   testSimple<kSmall>();
   testSimple<kMedium>();
   testSimple<kLarge>();
+  testSimple<kHuge>();
 }
 
 template <size_t kSize>
@@ -146,6 +156,10 @@ TEST(SmallBufferAllocator, ThreadsSimpleLarge) {
   testThreads<kLarge>();
 }
 
+TEST(SmallBufferAllocator, ThreadsSimpleHuge) {
+  testThreads<kHuge>();
+}
+
 template <size_t kSize>
 void testThreadsHandoff() {
   constexpr int kThreads = 8;
@@ -215,3 +229,139 @@ TEST(SmallBufferAllocator, ThreadsHandoffMedium) {
 TEST(SmallBufferAllocator, ThreadsHandoffLarge) {
   testThreadsHandoff<kLarge>();
 }
+
+TEST(SmallBufferAllocator, ThreadsHandoffHuge) {
+  testThreadsHandoff<kHuge>();
+}
+
+TEST(SmallBufferAllocator, TrimReleasesFreeSlabs) {
+  constexpr size_t kSize = 64;
+  constexpr size_t kNumBuffers = 1 << 17;
+  size_t before = approxBytesAllocatedSmallBuffer<kSize>();
+
+  std::vector<char*> buffers(kNumBuffers);
+  for (char*& b : buffers) {
+    b = allocSmallBuffer<kSize>();
+  }
+  size_t peak = approxBytesAllocatedSmallBuffer<kSize>();
+  ASSERT_GE(peak, before + kNumBuffers * kSize);
+
+  // Nothing can be released while every buffer is in use.
+  dispenso::trimSmallBufferAllocators();
+  EXPECT_GE(approxBytesAllocatedSmallBuffer<kSize>(), kNumBuffers * kSize);
+
+  // Keep one buffer alive; its slab must survive, but the rest of the burst can be released.
+  for (size_t i = 1; i < kNumBuffers; ++i) {
+    deallocSmallBuffer<kSize>(buffers[i]);
+  }
+  size_t released = dispenso::trimSmallBufferAllocators();
+  size_t after = approxBytesAllocatedSmallBuffer<kSize>();
+  EXPECT_GT(released, 0);
+  EXPECT_LT(after, peak);
+  EXPECT_LE(after, before + peak / 8);
+  EXPECT_GT(after, 0);
+
+  // The allocator remains usable.
+  for (size_t i = 1; i < kNumBuffers; ++i) {
+    buffers[i] = allocSmallBuffer<kSize>();
+    EXPECT_NE(buffers[i], buffers[0]);
+  }
+  for (char* b : buffers) {
+    deallocSmallBuffer<kSize>(b);
+  }
+}
+
+#if defined(DISPENSO_SMALL_BUFFER_NUMA_LOCAL)
+// Buffers freed on another node land in that node's central store.  Simulate that by placing half
+// of a burst directly in another store, and check that trim neither drops them nor keeps their
+// slabs alive.
+TEST(SmallBufferAllocator, TrimAcrossStores) {
+  constexpr size_t kSize = 64;
+  constexpr size_t kNumBuffers = 1 << 17;
+  auto& local = dispenso::detail::getSmallBufferGlobals<kSize>(dispenso::detail::smallBufferStore());
+  auto& foreign = dispenso::detail::getSmallBufferGlobals<kSize>(
+      (dispenso::detail::smallBufferStore() + 1) % dispenso::detail::kSmallBufferStores);
+  ASSERT_NE(&local, &foreign);
+  size_t before = approxBytesAllocatedSmallBuffer<kSize>();
+
+  std::vector<char*> buffers(kNumBuffers);
+  for (char*& b : buffers) {
+    b = allocSmallBuffer<kSize>();
+  }
+  size_t peak = approxBytesAllocatedSmallBuffer<kSize>();
+  foreign.centralStore.enqueue_bulk(buffers.data(), kNumBuffers / 2);
+  for (size_t i = kNumBuffers / 2; i < kNumBuffers; ++i) {
+    deallocSmallBuffer<kSize>(buffers[i]);
+  }
+
+  EXPECT_GT(dispenso::trimSmallBufferAllocators(), 0);
+  size_t after = approxBytesAllocatedSmallBuffer<kSize>();
+  EXPECT_LE(after, before + peak / 8);
+  EXPECT_EQ(dispenso::smallBufferStats<kSize>().bytesCentral, after);
+}
+#endif // DISPENSO_SMALL_BUFFER_NUMA_LOCAL
+
+TEST(SmallBufferAllocator, StlContainers) {
+  std::map<int, int, std::less<int>, dispenso::SmallBufferStlAllocator<std::pair<const int, int>>>
+      map;
+  for (int i = 0; i < 1000; ++i) {
+    map.emplace(i, 2 * i);
+  }
+  for (auto& kv : map) {
+    EXPECT_EQ(kv.second, 2 * kv.first);
+  }
+
+  // Large requests fall back on the heap, and rebinding yields an equal allocator.
+  std::vector<double, dispenso::SmallBufferStlAllocator<double>> vec;
+  for (int i = 0; i < 10000; ++i) {
+    vec.push_back(i);
+  }
+  EXPECT_EQ(vec[9999], 9999.0);
+  EXPECT_TRUE(dispenso::SmallBufferStlAllocator<char>(vec.get_allocator()) == map.get_allocator());
+
+  std::list<std::string, dispenso::SmallBufferStlAllocator<std::string>> list;
+  for (int i = 0; i < 1000; ++i) {
+    list.push_back(std::to_string(i));
+  }
+  EXPECT_EQ(list.back(), "999");
+}
+
+TEST(SmallBufferAllocator, Stats) {
+  constexpr size_t kSize = 128;
+  constexpr size_t kNumBuffers = 10000;
+  dispenso::SmallBufferStats before = dispenso::smallBufferStats<kSize>();
+  EXPECT_EQ(before.blockSize, kSize);
+
+  std::vector<char*> buffers(kNumBuffers);
+  for (char*& b : buffers) {
+    b = allocSmallBuffer<kSize>();
+  }
+#if !defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  dispenso::SmallBufferStats during = dispenso::smallBufferStats<kSize>();
+  EXPECT_EQ(during.liveAllocations, before.liveAllocations + kNumBuffers);
+  EXPECT_GE(during.bytesReserved, kNumBuffers * kSize);
+  EXPECT_GE(during.peakBytesReserved, during.bytesReserved);
+  EXPECT_GT(during.refills, before.refills);
+  EXPECT_EQ(
+      during.bytesReserved,
+      during.liveAllocations * kSize + during.bytesCentral + during.bytesThreadCached);
+#endif // !DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+
+  for (char* b : buffers) {
+    deallocSmallBuffer<kSize>(b);
+  }
+  dispenso::SmallBufferStats after = dispenso::smallBufferStats<kSize>();
+  EXPECT_EQ(after.liveAllocations, before.liveAllocations);
+#if !defined(DISPENSO_NO_SMALL_BUFFER_ALLOCATOR)
+  EXPECT_GT(after.spills, during.spills);
+  dispenso::trimSmallBufferAllocators();
+  after = dispenso::smallBufferStats<kSize>();
+  EXPECT_LE(after.bytesReserved, during.bytesReserved);
+  EXPECT_GE(after.peakBytesReserved, during.bytesReserved);
+#endif // !DISPENSO_NO_SMALL_BUFFER_ALLOCATOR
+
+  auto all = dispenso::smallBufferStats();
+  ASSERT_EQ(all.size(), 11);
+  EXPECT_EQ(all.front().blockSize, 4);
+  EXPECT_EQ(all.back().blockSize, dispenso::kMaxSmallBufferSize);
+}
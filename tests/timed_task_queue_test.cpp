@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dispenso/detail/timed_task_queue.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <dispenso/schedulable.h>
+
+#include <gtest/gtest.h>
+
+using dispenso::detail::TimedTaskHeap;
+using dispenso::detail::TimedTaskPtr;
+using dispenso::detail::TimingWheel;
+
+namespace {
+constexpr double kResolution = 1e-3;
+constexpr double kStart = 100.0;
+
+TimedTaskPtr makeTask(double nextAbsTime, double slack = 0.0) {
+  auto* task = dispenso::detail::createTimedTaskImpl(
+      dispenso::kImmediateInvoker, []() { return true; }, 1, nextAbsTime, 0.0, false);
+  task->slack = slack;
+  return task;
+}
+
+void releaseAll(std::vector<TimedTaskPtr>& tasks) {
+  for (auto* task : tasks) {
+    task->release();
+  }
+  tasks.clear();
+}
+} // namespace
+
+TEST(TimedTaskHeap, PopsInOrder) {
+  TimedTaskHeap heap;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> dist(0.0, 100.0);
+  constexpr size_t kNumTasks = 1000;
+  for (size_t i = 0; i < kNumTasks; ++i) {
+    heap.push(makeTask(dist(rng)));
+  }
+  EXPECT_EQ(heap.size(), kNumTasks);
+
+  std::vector<TimedTaskPtr> expired;
+  heap.popExpired(50.0, expired);
+  for (size_t i = 0; i < expired.size(); ++i) {
+    EXPECT_LE(expired[i]->nextAbsTime, 50.0);
+    if (i) {
+      EXPECT_LE(expired[i - 1]->nextAbsTime, expired[i]->nextAbsTime);
+    }
+  }
+  EXPECT_GT(heap.nextExpiry(), 50.0);
+  EXPECT_EQ(heap.size() + expired.size(), kNumTasks);
+  releaseAll(expired);
+  heap.drain(expired);
+  EXPECT_TRUE(heap.empty());
+  releaseAll(expired);
+}
+
+TEST(TimedTaskHeap, RemoveArbitrary) {
+  TimedTaskHeap heap;
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> dist(0.0, 100.0);
+  constexpr size_t kNumTasks = 2000;
+  std::vector<TimedTaskPtr> tasks;
+  for (size_t i = 0; i < kNumTasks; ++i) {
+    tasks.push_back(makeTask(dist(rng)));
+    heap.push(tasks.back());
+  }
+  // Remove every other task, in random order.
+  std::vector<TimedTaskPtr> removed;
+  for (size_t i = 0; i < kNumTasks; i += 2) {
+    removed.push_back(tasks[i]);
+  }
+  std::shuffle(removed.begin(), removed.end(), rng);
+  for (auto* task : removed) {
+    EXPECT_TRUE(heap.remove(task));
+    EXPECT_FALSE(heap.remove(task));
+  }
+  EXPECT_EQ(heap.size(), kNumTasks / 2);
+
+  std::vector<TimedTaskPtr> expired;
+  heap.popExpired(std::numeric_limits<double>::infinity(), expired);
+  ASSERT_EQ(expired.size(), kNumTasks / 2);
+  for (size_t i = 0; i < expired.size(); ++i) {
+    EXPECT_EQ(std::find(removed.begin(), removed.end(), expired[i]), removed.end());
+    if (i) {
+      EXPECT_LE(expired[i - 1]->nextAbsTime, expired[i]->nextAbsTime);
+    }
+  }
+  EXPECT_FALSE(heap.remove(expired.front()));
+  releaseAll(expired);
+  releaseAll(removed);
+}
+
+TEST(TimingWheel, Empty) {
+  TimingWheel wheel(kResolution, kStart);
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(wheel.nextExpiry(), std::numeric_limits<double>::infinity());
+  std::vector<TimedTaskPtr> expired;
+  wheel.popExpired(kStart + 1000.0, expired);
+  EXPECT_TRUE(expired.empty());
+}
+
+TEST(TimingWheel, ExpiresOnTimeAcrossLevels) {
+  TimingWheel wheel(kResolution, kStart);
+  std::mt19937 rng(7);
+  // Span several levels: up to ~1.5 hours at millisecond resolution.
+  std::uniform_real_distribution<double> dist(0.0, 5000.0);
+  constexpr size_t kNumTasks = 20000;
+  for (size_t i = 0; i < kNumTasks; ++i) {
+    wheel.push(makeTask(kStart + dist(rng)));
+  }
+  EXPECT_EQ(wheel.size(), kNumTasks);
+
+  size_t numExpired = 0;
+  double prevTime = kStart;
+  std::vector<TimedTaskPtr> expired;
+  while (!wheel.empty()) {
+    double next = wheel.nextExpiry();
+    ASSERT_GT(next, prevTime);
+    // Poll partway through the tick, as a real clock would.
+    double now = next + 0.5 * kResolution;
+    wheel.popExpired(now, expired);
+    for (auto* task : expired) {
+      EXPECT_LE(task->nextAbsTime, now);
+      EXPECT_GT(task->nextAbsTime + kResolution, prevTime);
+      EXPECT_EQ(task->queueSlot, -1);
+    }
+    numExpired += expired.size();
+    releaseAll(expired);
+    prevTime = now;
+  }
+  EXPECT_EQ(numExpired, kNumTasks);
+}
+
+TEST(TimingWheel, BatchExpiryPerTick) {
+  TimingWheel wheel(kResolution, kStart);
+  for (size_t i = 0; i < 100; ++i) {
+    wheel.push(makeTask(kStart + 0.0101 + 1e-6 * static_cast<double>(i % 10)));
+  }
+  std::vector<TimedTaskPtr> expired;
+  wheel.popExpired(kStart + 0.0105, expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.popExpired(kStart + 0.0115, expired);
+  EXPECT_EQ(expired.size(), 100);
+  EXPECT_TRUE(wheel.empty());
+  releaseAll(expired);
+}
+
+TEST(TimingWheel, Remove) {
+  TimingWheel wheel(kResolution, kStart);
+  std::vector<TimedTaskPtr> tasks;
+  for (size_t i = 0; i < 1000; ++i) {
+    tasks.push_back(makeTask(kStart + 0.001 * static_cast<double>(i % 300)));
+    tasks.back()->acquire();
+    wheel.push(tasks.back());
+  }
+  for (size_t i = 0; i < tasks.size(); i += 2) {
+    EXPECT_TRUE(wheel.remove(tasks[i]));
+    EXPECT_FALSE(wheel.remove(tasks[i]));
+    tasks[i]->release();
+  }
+  EXPECT_EQ(wheel.size(), 500);
+
+  std::vector<TimedTaskPtr> expired;
+  wheel.popExpired(kStart + 10.0, expired);
+  ASSERT_EQ(expired.size(), 500);
+  std::sort(expired.begin(), expired.end(), [&tasks](TimedTaskPtr a, TimedTaskPtr b) {
+    return std::find(tasks.begin(), tasks.end(), a) < std::find(tasks.begin(), tasks.end(), b);
+  });
+  for (size_t i = 0; i < expired.size(); ++i) {
+    EXPECT_EQ(expired[i], tasks[2 * i + 1]);
+  }
+  releaseAll(expired);
+  releaseAll(tasks);
+}
+
+TEST(TimingWheel, OverdueTasksAreDueImmediately) {
+  TimingWheel wheel(kResolution, kStart);
+  std::vector<TimedTaskPtr> expired;
+  wheel.popExpired(kStart + 1.0, expired);
+  wheel.push(makeTask(kStart + 0.5));
+  EXPECT_LE(wheel.nextExpiry(), kStart + 1.0);
+  wheel.popExpired(kStart + 1.0, expired);
+  EXPECT_EQ(expired.size(), 1);
+  releaseAll(expired);
+}
+
+TEST(TimingWheel, FarFutureAndDrain) {
+  TimingWheel wheel(kResolution, kStart);
+  auto* task = makeTask(std::numeric_limits<double>::max());
+  task->acquire();
+  wheel.push(task);
+  wheel.push(makeTask(kStart + 1e9));
+  std::vector<TimedTaskPtr> expired;
+  wheel.popExpired(kStart + 1e6, expired);
+  EXPECT_TRUE(expired.empty());
+  EXPECT_TRUE(std::isfinite(wheel.nextExpiry()));
+
+  wheel.drain(expired);
+  EXPECT_EQ(expired.size(), 2);
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_FALSE(wheel.remove(task));
+  releaseAll(expired);
+  task->release();
+}
+
+TEST(TimingWheel, OverlappingSlackWindowsCoalesce) {
+  TimingWheel wheel(kResolution, kStart);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> dist(0.010, 0.014);
+  for (size_t i = 0; i < 100; ++i) {
+    wheel.push(makeTask(kStart + dist(rng), 0.010));
+  }
+  std::vector<TimedTaskPtr> expired;
+  double next = wheel.nextExpiry();
+  EXPECT_GE(next, kStart + 0.014);
+  EXPECT_LE(next, kStart + 0.021);
+  wheel.popExpired(next + 0.5 * kResolution, expired);
+  EXPECT_EQ(expired.size(), 100);
+  for (auto* task : expired) {
+    EXPECT_LE(task->nextAbsTime, next);
+    EXPECT_GE(task->latestTime() + kResolution, next);
+  }
+  releaseAll(expired);
+}
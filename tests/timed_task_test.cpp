@@ -729,3 +729,376 @@ TEST(TimedTaskTest, FunctionDestructionPostTaskDestruct) {
   // Goal: passed function destructor should never execute out here... if it does it will
   // incorrectly reference value that went out of scope
 }
+
+dispenso::TimedTaskScheduler& wheelScheduler() {
+  dispenso::TimedTaskSchedulerOptions options;
+  options.queueType = dispenso::TimedTaskQueueType::kTimingWheel;
+  options.wheelResolution = 1e-3;
+  static dispenso::TimedTaskScheduler sched(dispenso::ThreadPriority::kNormal, options);
+  return sched;
+}
+
+TEST(TimedTaskTest, TimingWheelRunOnce) {
+  constexpr double kWaitLen = 0.04;
+  constexpr double kResolution = 1e-3;
+
+  double start;
+  double calledTime;
+  dispenso::CompletionEvent fin;
+
+  {
+    start = dispenso::getTime();
+    dispenso::TimedTask task = wheelScheduler().schedule(
+        dispenso::kImmediateInvoker,
+        [&calledTime, &fin]() {
+          calledTime = dispenso::getTime();
+          fin.notify();
+          return true;
+        },
+        start + kWaitLen);
+
+    fin.wait();
+  }
+
+  EXPECT_GE(calledTime - start, kWaitLen - 20e-6);
+  EXPECT_LT(calledTime - start, kWaitLen + kResolution + 5 * kp95Epsilon);
+}
+
+TEST(TimedTaskTest, TimingWheelRunPeriodic) {
+  constexpr double kPeriod = 0.002;
+  std::atomic<size_t> count(0);
+  dispenso::CompletionEvent fin;
+  auto task = wheelScheduler().schedule(
+      dispenso::kImmediateInvoker,
+      [&count, &fin]() {
+        if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == k100Times) {
+          fin.notify();
+        }
+        return true;
+      },
+      dispenso::getTime() + kPeriod,
+      kPeriod,
+      k100Times,
+      dispenso::TimedTaskType::kSteady);
+  fin.wait();
+  EXPECT_EQ(task.calls(), k100Times);
+}
+
+TEST(TimedTaskTest, TimingWheelCancelReleasesFunction) {
+  auto token = std::make_shared<int>(5);
+  for (size_t i = 0; i < 1000; ++i) {
+    auto task = wheelScheduler().schedule(
+        dispenso::kImmediateInvoker,
+        [token]() { return true; },
+        dispenso::getTime() + 3600.0 + static_cast<double>(i));
+    task.detach();
+    task.cancel();
+  }
+  // Cancellation unlinks the tasks from the wheel, so nothing but us refers to the token.
+  EXPECT_EQ(token.use_count(), 1);
+}
+
+TEST(TimedTaskTest, CancelReleasesFunction) {
+  auto token = std::make_shared<int>(5);
+  for (size_t i = 0; i < 1000; ++i) {
+    auto task = testScheduler().schedule(
+        dispenso::kImmediateInvoker,
+        [token]() { return true; },
+        dispenso::getTime() + 3600.0 + static_cast<double>(i));
+    task.detach();
+    task.cancel();
+  }
+  // Cancellation unlinks the tasks from the heap, so nothing but us refers to the token.
+  EXPECT_EQ(token.use_count(), 1);
+}
+
+TEST(TimedTaskTest, SlackCoalescesFirings) {
+  constexpr double kWaitLen = 0.02;
+  constexpr double kSlack = 0.01;
+
+  double calledTimes[2];
+  std::atomic<int> remaining(2);
+  dispenso::CompletionEvent fin;
+  dispenso::TimedTaskOptions options;
+  options.slack = kSlack;
+
+  double start = dispenso::getTime();
+  std::vector<dispenso::TimedTask> tasks;
+  for (int i = 0; i < 2; ++i) {
+    tasks.push_back(testScheduler().schedule(
+        dispenso::kImmediateInvoker,
+        [i, &calledTimes, &remaining, &fin]() {
+          calledTimes[i] = dispenso::getTime();
+          if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            fin.notify();
+          }
+          return true;
+        },
+        start + kWaitLen + 0.002 * i,
+        0.0,
+        1,
+        dispenso::TimedTaskType::kNormal,
+        options));
+  }
+  fin.wait();
+
+  for (double t : calledTimes) {
+    EXPECT_GE(t - start, kWaitLen - 20e-6);
+    EXPECT_LT(t - start, kWaitLen + kSlack + errAdjust(kp95Epsilon));
+  }
+  // Both windows overlap, so both tasks should be fired by the same wakeup.
+  EXPECT_LT(std::abs(calledTimes[1] - calledTimes[0]), 0.5e-3);
+}
+
+TEST(TimedTaskTest, SlackChronoOverload) {
+  dispenso::CompletionEvent fin;
+  dispenso::TimedTaskOptions options;
+  options.slack = 0.005;
+  double start = dispenso::getTime();
+  double calledTime;
+  auto task = testScheduler().schedule(
+      dispenso::kImmediateInvoker,
+      [&calledTime, &fin]() {
+        calledTime = dispenso::getTime();
+        fin.notify();
+        return true;
+      },
+      10ms,
+      options);
+  fin.wait();
+  EXPECT_GE(calledTime - start, 0.01 - 20e-6);
+  EXPECT_LT(calledTime - start, 0.015 + errAdjust(kp95Epsilon));
+}
+
+TEST(TimedTaskTest, ShardedSchedulerRunsOnAllShards) {
+  constexpr size_t kShards = 3;
+  constexpr size_t kTasksPerShard = 20;
+  dispenso::ShardedTimedTaskScheduler sched(kShards);
+  EXPECT_EQ(sched.numShards(), kShards);
+
+  std::atomic<size_t> count(0);
+  dispenso::CompletionEvent fin;
+  std::vector<dispenso::TimedTask> tasks;
+  double start = dispenso::getTime();
+  for (size_t i = 0; i < kShards * kTasksPerShard; ++i) {
+    tasks.push_back(sched.shardFor(i).schedule(
+        dispenso::kImmediateInvoker,
+        [&count, &fin]() {
+          if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == kShards * kTasksPerShard) {
+            fin.notify();
+          }
+          return true;
+        },
+        start + 0.02 + 0.0001 * static_cast<double>(i)));
+  }
+  fin.wait();
+
+  for (size_t i = 0; i < kShards; ++i) {
+    EXPECT_EQ(sched.stats(i).numFired, kTasksPerShard);
+    EXPECT_GE(sched.stats(i).maxLateness, 0.0);
+  }
+  auto stats = sched.stats();
+  EXPECT_EQ(stats.numFired, kShards * kTasksPerShard);
+  EXPECT_GE(stats.jitter, 0.0);
+  EXPECT_LE(stats.meanLateness, stats.maxLateness);
+}
+
+TEST(TimedTaskTest, ShardedSchedulerCurrentThreadShard) {
+  dispenso::ShardedTimedTaskScheduler sched(4);
+  EXPECT_EQ(&sched.shardForCurrentThread(), &sched.shardForCurrentThread());
+
+  dispenso::CompletionEvent fin;
+  auto task = sched.schedule(
+      dispenso::kImmediateInvoker,
+      [&fin]() {
+        fin.notify();
+        return true;
+      },
+      2ms);
+  fin.wait();
+  EXPECT_EQ(task.calls(), 1);
+  EXPECT_EQ(sched.shardForCurrentThread().stats().numFired, 1);
+}
+
+static dispenso::TimedTaskScheduler& preciseScheduler() {
+  dispenso::TimedTaskSchedulerOptions options;
+  options.waitStrategy = dispenso::TimedTaskWaitStrategy::kPrecise;
+  static dispenso::TimedTaskScheduler sched(dispenso::ThreadPriority::kNormal, options);
+  return sched;
+}
+
+TEST(TimedTaskTest, PreciseWaitRunOnce) {
+  constexpr double kWaitLen = 0.02;
+  for (bool spin : {false, true}) {
+    dispenso::TimedTaskOptions taskOptions;
+    taskOptions.spin = spin;
+    double calledTime;
+    dispenso::CompletionEvent fin;
+    double start = dispenso::getTime();
+    auto task = preciseScheduler().schedule(
+        dispenso::kImmediateInvoker,
+        [&calledTime, &fin]() {
+          calledTime = dispenso::getTime();
+          fin.notify();
+          return true;
+        },
+        start + kWaitLen,
+        0.0,
+        1,
+        dispenso::TimedTaskType::kNormal,
+        taskOptions);
+    fin.wait();
+
+    EXPECT_GE(calledTime - start, kWaitLen - 20e-6);
+    EXPECT_LT(calledTime - start, kWaitLen + 5 * errAdjust(kp95Epsilon));
+  }
+}
+
+TEST(TimedTaskTest, PreciseWaitWakesForEarlierTask) {
+  // The scheduler thread is waiting for the far task when the near one is scheduled.
+  auto farTask = preciseScheduler().schedule(
+      dispenso::kImmediateInvoker, []() { return true; }, dispenso::getTime() + 3600.0);
+  std::this_thread::sleep_for(5ms);
+
+  constexpr double kWaitLen = 0.01;
+  double calledTime;
+  dispenso::CompletionEvent fin;
+  double start = dispenso::getTime();
+  auto task = preciseScheduler().schedule(
+      dispenso::kImmediateInvoker,
+      [&calledTime, &fin]() {
+        calledTime = dispenso::getTime();
+        fin.notify();
+        return true;
+      },
+      start + kWaitLen);
+  fin.wait();
+
+  EXPECT_GE(calledTime - start, kWaitLen - 20e-6);
+  EXPECT_LT(calledTime - start, kWaitLen + 5 * errAdjust(kp95Epsilon));
+  EXPECT_EQ(farTask.calls(), 0);
+}
+
+TEST(TimedTaskTest, RecordLatency) {
+  constexpr size_t kRuns = 20;
+  dispenso::TimedTaskSchedulerOptions options;
+  options.recordLatency = true;
+  dispenso::TimedTaskScheduler sched(dispenso::ThreadPriority::kNormal, options);
+  dispenso::TimedTaskOptions taskOptions;
+  taskOptions.recordLatency = true;
+
+  dispenso::CompletionEvent fin;
+  std::atomic<size_t> count(0);
+  auto task = sched.schedule(
+      dispenso::kImmediateInvoker,
+      [&count, &fin]() {
+        if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == kRuns) {
+          fin.notify();
+        }
+        return true;
+      },
+      dispenso::getTime() + 0.001,
+      0.001,
+      kRuns,
+      dispenso::TimedTaskType::kSteady,
+      taskOptions);
+  fin.wait();
+
+  for (auto snap : {task.dispatchLatency(), sched.dispatchLatency()}) {
+    EXPECT_EQ(snap.count(), kRuns);
+    EXPECT_LE(snap.percentile(50.0), snap.percentile(99.0));
+    EXPECT_LE(snap.percentile(99.0), snap.max());
+  }
+  // Starting can only happen after dispatch.
+  EXPECT_EQ(task.startLatency().count(), kRuns);
+  EXPECT_GE(task.startLatency().max(), task.dispatchLatency().max() * 0.9);
+  EXPECT_EQ(sched.startLatency().count(), kRuns);
+
+  // Histograms are empty unless requested.
+  auto other = sched.schedule(
+      dispenso::kImmediateInvoker, []() { return true; }, dispenso::getTime() + 3600.0);
+  EXPECT_EQ(other.dispatchLatency().count(), 0);
+  EXPECT_EQ(testScheduler().dispatchLatency().count(), 0);
+}
+
+// Runs a steady periodic task whose first run stalls the scheduler thread for 5.5 periods, and
+// returns how many runs happened back-to-back once the stall ended.
+static size_t runsAfterStall(const dispenso::TimedTaskOptions& options) {
+  constexpr double kPeriod = 0.04;
+  constexpr size_t kRuns = 8;
+  dispenso::TimedTaskScheduler sched;
+  std::vector<double> times;
+  dispenso::CompletionEvent fin;
+  auto task = sched.schedule(
+      dispenso::kImmediateInvoker,
+      [&times, &fin]() {
+        if (times.empty()) {
+          std::this_thread::sleep_for(220ms);
+        }
+        times.push_back(dispenso::getTime());
+        if (times.size() == kRuns) {
+          fin.notify();
+        }
+        return true;
+      },
+      dispenso::getTime() + kPeriod,
+      kPeriod,
+      kRuns,
+      dispenso::TimedTaskType::kSteady,
+      options);
+  fin.wait();
+  size_t burst = 0;
+  while (burst + 1 < times.size() && times[burst + 1] - times[0] < kPeriod / 4) {
+    ++burst;
+  }
+  return burst;
+}
+
+TEST(TimedTaskTest, MissedRunPolicies) {
+  dispenso::TimedTaskOptions options;
+  // Runs due in periods 2 through 6 all run once the stall ends in period 6.5.
+  EXPECT_EQ(runsAfterStall(options), 5);
+
+  // The run due in period 2 was already dispatched when the stall began, but the rest are dropped.
+  options.missedRunPolicy = dispenso::TimedTaskMissedRunPolicy::kSkip;
+  EXPECT_EQ(runsAfterStall(options), 1);
+
+  // The run due in period 2, plus two more.
+  options.missedRunPolicy = dispenso::TimedTaskMissedRunPolicy::kCatchUpLimited;
+  options.maxCatchUp = 2;
+  EXPECT_EQ(runsAfterStall(options), 3);
+}
+
+TEST(TimedTaskTest, NoOverlap) {
+  constexpr size_t kRuns = 4;
+  dispenso::ThreadPool pool(4);
+  dispenso::TimedTaskOptions options;
+  options.noOverlap = true;
+
+  std::atomic<int> running(0);
+  std::atomic<int> maxRunning(0);
+  std::atomic<size_t> count(0);
+  dispenso::CompletionEvent fin;
+  auto task = testScheduler().schedule(
+      pool,
+      [&]() {
+        int cur = running.fetch_add(1, std::memory_order_acq_rel) + 1;
+        int prev = maxRunning.load(std::memory_order_relaxed);
+        while (cur > prev && !maxRunning.compare_exchange_weak(prev, cur)) {
+        }
+        std::this_thread::sleep_for(12ms);
+        running.fetch_sub(1, std::memory_order_acq_rel);
+        if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == kRuns) {
+          fin.notify();
+        }
+        return true;
+      },
+      dispenso::getTime() + 0.002,
+      0.002,
+      kRuns,
+      dispenso::TimedTaskType::kSteady,
+      options);
+  fin.wait();
+  EXPECT_EQ(maxRunning.load(), 1);
+  EXPECT_EQ(count.load(), kRuns);
+}